@@ -28,7 +28,10 @@
             root
             hammer-phys
             ff_calc
+            cxxopts
+            mpi
             python3
+            python3Packages.numpy
           ];
         };
       });
@@ -0,0 +1,226 @@
+// Author: Yipeng Sun
+// License: GPLv2
+// Description: Heap allocation counters per stage of the event loop, and a
+//              pool allocator that recycles fixed-size blocks.
+// Last Change: Sun Oct 18, 2026 at 09:03 AM +0200
+//
+// NOTE: The replacements of the global operator new and delete that feed the
+//       counters are in 'src/alloc_stats.cpp', which only executables that
+//       report allocations link (e.g. rdx-run1-sample.w); elsewhere, e.g. in
+//       librdx-reweight.so, this header only adds the stages and pools, and
+//       leaves the host's allocator alone. Counting is off until
+//       'alloc_stats::enabled' is set; then every allocation, including those
+//       made inside ROOT and HAMMER, is attributed to the current stage.
+//       The stage, counters, hook and block pools are per thread, so that
+//       reweighters on other threads don't race on them; only the calling
+//       thread's counters are reported. HAMMER itself is not known to be
+//       thread safe, so only one reweighter may run at a time anyway (see
+//       'inc/rdx_reweight.h').
+
+#ifndef _RDX_ALLOC_STATS_H_
+#define _RDX_ALLOC_STATS_H_
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+
+namespace alloc_stats {
+
+enum Stage {
+  Other = 0,
+  Init,          // HAMMER setup
+  Input,         // reading truth events
+  Kinematics,    // q2, mm2, el
+  Process,       // building and adding the HAMMER process
+  ProcessEvent,  // HAMMER processEvent
+  GetWeight,     // HAMMER getWeight
+  Output,        // filling and writing the output trees
+  NumOfStages
+};
+
+const std::vector<std::string> stage_names{
+    "other",        "init",      "input",  "kinematics", "HAMMER process",
+    "processEvent", "getWeight", "output"};
+
+// NOTE: Plain arrays only, so that it can be copied through shared memory
+struct Counters {
+  int64_t allocs[NumOfStages]  = {};
+  int64_t bytes[NumOfStages]   = {};
+  double  seconds[NumOfStages] = {};
+
+  Counters& operator+=(const Counters& rhs) {
+    for (auto s = 0; s < NumOfStages; s++) {
+      allocs[s] += rhs.allocs[s];
+      bytes[s] += rhs.bytes[s];
+      seconds[s] += rhs.seconds[s];
+    }
+    return *this;
+  }
+
+  void print(int64_t entries, std::ostream& os = std::cout) const {
+    auto per_entry = [&](double x) { return entries > 0 ? x / entries : 0.; };
+
+    os << "Heap allocations per stage, " << entries << " entries:" << std::endl;
+    os << std::left << std::setw(16) << "stage" << std::right << std::setw(14)
+       << "allocations" << std::setw(12) << "per entry" << std::setw(12)
+       << "MiB" << std::setw(12) << "time [s]" << std::setw(14)
+       << "us per entry" << std::endl;
+
+    for (auto s = 0; s < NumOfStages; s++)
+      os << std::left << std::setw(16) << stage_names[s] << std::right
+         << std::setw(14) << allocs[s] << std::setw(12)
+         << per_entry(allocs[s]) << std::setw(12) << bytes[s] / 1048576.
+         << std::setw(12) << seconds[s] << std::setw(14)
+         << 1e6 * per_entry(seconds[s]) << std::endl;
+  }
+};
+
+// NOTE: Set before any other thread starts
+inline bool enabled = false;
+
+inline thread_local Stage    current = Other;
+inline thread_local Counters counters{};
+
+// Notified when a stage starts and ends, e.g. to read hardware counters
+class StageHook {
+ public:
+  virtual ~StageHook() = default;
+  virtual void enter(Stage stage) = 0;
+  virtual void leave(Stage stage) = 0;
+};
+
+inline thread_local StageHook* hook = nullptr;
+
+// Attribute allocations and time to 'stage' until the end of the scope.
+// NOTE: Scopes shouldn't be nested, otherwise the time (and hardware counts)
+//       of the inner one is counted twice.
+class Scope {
+ public:
+  Scope(Stage stage) : _stage(stage) {
+    if (enabled) {
+      _prev   = current;
+      current = stage;
+      _start  = std::chrono::steady_clock::now();
+    }
+    if (hook) hook->enter(stage);
+  }
+
+  ~Scope() {
+    if (hook) hook->leave(_stage);
+    if (enabled) {
+      std::chrono::duration<double> elapsed =
+          std::chrono::steady_clock::now() - _start;
+      counters.seconds[_stage] += elapsed.count();
+      current = _prev;
+    }
+  }
+
+  Scope(const Scope&) = delete;
+  Scope& operator=(const Scope&) = delete;
+
+ private:
+  Stage                                 _stage;
+  Stage                                 _prev = Other;
+  std::chrono::steady_clock::time_point _start;
+};
+
+inline void* counted_alloc(std::size_t n) {
+  if (enabled) {
+    counters.allocs[current]++;
+    counters.bytes[current] += n;
+  }
+  return std::malloc(n ? n : 1);
+}
+
+/////////////////
+// Block pools //
+/////////////////
+
+// Hands out blocks of 'Size' bytes from chunks that are never returned to the
+// heap; freed blocks go to a free list and are reused first.
+// NOTE: Each thread has its own pool. As chunks are never freed, a block may
+//       be given back to the pool of another thread than the one it came from,
+//       e.g. when a reweighter is destroyed elsewhere.
+template <std::size_t Size, std::size_t Align>
+class BlockPool {
+  union Block {
+    Block* next;
+    alignas(Align) unsigned char data[Size];
+  };
+
+ public:
+  static BlockPool& get() {
+    static thread_local BlockPool pool{};
+    return pool;
+  }
+
+  void* take() {
+    if (!_free) refill();
+    auto block = _free;
+    _free      = block->next;
+    return block;
+  }
+
+  void give(void* ptr) {
+    auto block  = static_cast<Block*>(ptr);
+    block->next = _free;
+    _free       = block;
+  }
+
+ private:
+  static constexpr std::size_t chunk_blocks = 4096;
+
+  Block* _free = nullptr;
+
+  void refill() {
+    auto chunk =
+        static_cast<Block*>(::operator new(chunk_blocks * sizeof(Block)));
+    for (auto i = chunk_blocks; i-- > 0;) give(chunk + i);
+  }
+};
+
+// Allocator for node-based containers (e.g. 'std::unordered_map'): single
+// objects come from a 'BlockPool', arrays (e.g. hash buckets) from the heap.
+template <class T>
+class PoolAllocator {
+ public:
+  using value_type = T;
+
+  PoolAllocator() = default;
+  template <class U>
+  PoolAllocator(const PoolAllocator<U>&) {}
+
+  T* allocate(std::size_t n) {
+    if (n != 1) return static_cast<T*>(::operator new(n * sizeof(T)));
+    return static_cast<T*>(pool().take());
+  }
+
+  void deallocate(T* ptr, std::size_t n) {
+    if (n != 1)
+      ::operator delete(ptr);
+    else
+      pool().give(ptr);
+  }
+
+ private:
+  static auto& pool() { return BlockPool<sizeof(T), alignof(T)>::get(); }
+};
+
+template <class T, class U>
+bool operator==(const PoolAllocator<T>&, const PoolAllocator<U>&) {
+  return true;
+}
+
+template <class T, class U>
+bool operator!=(const PoolAllocator<T>&, const PoolAllocator<U>&) {
+  return false;
+}
+
+}  // namespace alloc_stats
+
+#endif
@@ -0,0 +1,179 @@
+// Author: Yipeng Sun
+// License: GPLv2
+// Description: Open a list of ROOT files one after another, while the next one
+//              is being opened and read into the page cache in the background.
+// Last Change: Sun Oct 18, 2026 at 10:02 AM +0200
+//
+// Remote files (e.g. root://) go through TFile::AsyncOpen. For local files
+// AsyncOpen only records the request, so a background thread reads the head of
+// the file (header and first baskets) and its tail (key list and streamer
+// info, which ROOT writes last) instead, so that opening it and reading the
+// first clusters hit the page cache.
+
+#ifndef _RDX_FILE_PREFETCH_H_
+#define _RDX_FILE_PREFETCH_H_
+
+#include <TFile.h>
+#include <TFileOpenHandle.h>
+
+#include <fcntl.h>
+#include <glob.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace prefetch {
+
+inline bool is_remote(const std::string& path) {
+  return path.find("://") != std::string::npos &&
+         path.compare(0, 7, "file://") != 0;
+}
+
+// Expand shell-style globs; paths without matches are kept as-is, so that
+// remote URLs and missing files are reported when they are opened.
+inline std::vector<std::string> expand(const std::vector<std::string>& args) {
+  std::vector<std::string> paths{};
+
+  for (const auto& arg : args) {
+    glob_t matches{};
+    if (!is_remote(arg) && glob(arg.c_str(), 0, nullptr, &matches) == 0)
+      for (auto i = 0ul; i < matches.gl_pathc; i++)
+        paths.push_back(matches.gl_pathv[i]);
+    else
+      paths.push_back(arg);
+    globfree(&matches);
+  }
+
+  return paths;
+}
+
+// Plain text file with one path (or glob) per line
+inline std::vector<std::string> read_list(const std::string& list) {
+  std::ifstream            input(list);
+  std::vector<std::string> args{};
+  std::string              line;
+
+  if (!input) throw std::runtime_error("Can't read file list " + list);
+  while (std::getline(input, line))
+    if (!line.empty() && line[0] != '#') args.push_back(line);
+
+  return expand(args);
+}
+
+// Read the first and last 'bytes' of a local file, discarding the data
+inline void warm_page_cache(const std::string& path, size_t bytes) {
+  auto fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) return;
+
+  struct stat st {};
+  fstat(fd, &st);
+  size_t size = st.st_size;
+
+  std::vector<char> buf(1 << 20);
+  auto              read_range = [&](size_t first, size_t last) {
+    for (auto pos = first; pos < last; pos += buf.size())
+      if (pread(fd, buf.data(), std::min(buf.size(), last - pos), pos) <= 0)
+        break;
+  };
+
+  auto head = std::min(bytes, size);
+  read_range(0, head);
+  read_range(std::max(head, size - std::min(bytes, size)), size);
+
+  close(fd);
+}
+
+class FilePrefetcher {
+ public:
+  // 'warm_bytes' is read from both ends of the next local file; no prefetching
+  // at all if 'enabled' is false.
+  FilePrefetcher(const std::vector<std::string>& paths, bool enabled,
+                 size_t warm_bytes)
+      : _paths(paths), _enabled(enabled), _warm_bytes(warm_bytes) {}
+
+  // NOTE: 'TFile::Open' of a handle also deletes it, so handles that were
+  //       never used are finished the same way, and their files closed
+  ~FilePrefetcher() {
+    if (_warmer.joinable()) _warmer.join();
+    for (auto& handle : _handles) delete TFile::Open(handle.second);
+  }
+
+  FilePrefetcher(const FilePrefetcher&) = delete;
+  FilePrefetcher& operator=(const FilePrefetcher&) = delete;
+
+  size_t                          size() const { return _paths.size(); }
+  const std::vector<std::string>& paths() const { return _paths; }
+
+  // Open file 'i' (owned by the caller) and start prefetching file 'i + 1'
+  TFile* open(size_t i) {
+    auto start = std::chrono::steady_clock::now();
+
+    // A warmer still running means the file isn't fully cached yet; waiting
+    // for it is no slower than reading the same data through ROOT
+    if (_warmer.joinable()) _warmer.join();
+
+    TFile* file   = nullptr;
+    auto   handle = _handles.find(i);
+    if (handle != _handles.end()) {
+      file = TFile::Open(handle->second);
+      _handles.erase(handle);
+      _num_prefetched++;
+    } else
+      file = TFile::Open(_paths[i].c_str(), "read");
+
+    if (!file || file->IsZombie()) {
+      delete file;
+      throw std::runtime_error("Can't open " + _paths[i]);
+    }
+
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    _open_seconds += elapsed.count();
+    _num_opened++;
+
+    if (_enabled && i + 1 < _paths.size()) start_prefetch(i + 1);
+    return file;
+  }
+
+  // Time spent in 'open', i.e. waiting on storage between files
+  double open_seconds() const { return _open_seconds; }
+  int    num_opened() const { return _num_opened; }
+  int    num_prefetched() const { return _num_prefetched; }
+
+ private:
+  std::vector<std::string>           _paths;
+  bool                               _enabled;
+  size_t                             _warm_bytes;
+  std::map<size_t, TFileOpenHandle*> _handles;
+  std::thread                        _warmer;
+
+  double _open_seconds   = 0;
+  int    _num_opened     = 0;
+  int    _num_prefetched = 0;
+
+  void start_prefetch(size_t i) {
+    const auto& path = _paths[i];
+
+    if (!_handles.count(i)) {
+      auto handle = TFile::AsyncOpen(path.c_str(), "read");
+      if (handle) _handles[i] = handle;
+    }
+
+    if (!is_remote(path)) {
+      auto local = path.compare(0, 7, "file://") == 0 ? path.substr(7) : path;
+      _warmer    = std::thread(warm_page_cache, local, _warm_bytes);
+    }
+  }
+};
+
+}  // namespace prefetch
+
+#endif
@@ -0,0 +1,256 @@
+// Author: Yipeng Sun
+// License: GPLv2
+// Description: Live progress of the reweighter, published periodically in the
+//              Prometheus text format.
+// Last Change: Sun Oct 18, 2026 at 07:03 AM +0200
+//
+// The event loop is the only writer of 'metrics::live', so every update is a
+// relaxed load and store of an atomic (plain moves on x86-64, no lock prefix).
+// A background thread takes a snapshot every few seconds, and atomically
+// replaces the metrics file with it (write + rename), e.g. for the textfile
+// collector of the Prometheus node exporter. It can also print a progress line.
+//
+// NOTE: With forked workers, stage times are only those of the writer; the
+//       workers' own times are merged into the report at the end of the run.
+//       Workers are forked with the publisher paused (see 'pause'), and must
+//       not touch 'live' or the publisher: only the parent's copies are ever
+//       published.
+
+#ifndef _RDX_METRICS_H_
+#define _RDX_METRICS_H_
+
+#include <TFile.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "alloc_stats.h"
+
+namespace metrics {
+
+// Single writer only
+template <class T>
+void add(std::atomic<T>& x, T v) {
+  x.store(x.load(std::memory_order_relaxed) + v, std::memory_order_relaxed);
+}
+
+template <class T>
+T get(const std::atomic<T>& x) {
+  return x.load(std::memory_order_relaxed);
+}
+
+class Live : public alloc_stats::StageHook {
+ public:
+  static constexpr int max_queues = 64;
+
+  std::atomic<int64_t> entries{0};   // input entries done
+  std::atomic<int64_t> expected{0};  // input entries of the whole run
+  std::atomic<int64_t> weights{0};   // entries with a weight
+  std::atomic<double>  sum_w{0}, sum_w2{0};
+  std::atomic<double>  min_w{std::numeric_limits<double>::infinity()};
+  std::atomic<double>  max_w{-std::numeric_limits<double>::infinity()};
+  std::atomic<double>  last_progress{0};  // seconds since the epoch
+  std::atomic<int64_t> bytes_read{0}, bytes_written{0};
+
+  std::atomic<double>  stage_seconds[alloc_stats::NumOfStages] = {};
+  std::atomic<int>     num_queues{0};
+  std::atomic<int64_t> queue_depth[max_queues] = {};
+
+  // Called for the previous hook, e.g. the hardware counters
+  alloc_stats::StageHook* next = nullptr;
+
+  void entry_done() {
+    auto n = get(entries) + 1;
+    entries.store(n, std::memory_order_relaxed);
+
+    // Coarse updates, as reading the clock and ROOT counters isn't free
+    if (n % 256 == 0) {
+      last_progress.store(now(), std::memory_order_relaxed);
+      bytes_read.store(TFile::GetFileBytesRead(), std::memory_order_relaxed);
+      bytes_written.store(TFile::GetFileBytesWritten(),
+                          std::memory_order_relaxed);
+    }
+  }
+
+  void weight(double w) {
+    add(weights, int64_t{1});
+    add(sum_w, w);
+    add(sum_w2, w * w);
+    if (w < get(min_w)) min_w.store(w, std::memory_order_relaxed);
+    if (w > get(max_w)) max_w.store(w, std::memory_order_relaxed);
+  }
+
+  void set_queue(int q, int64_t depth) {
+    if (q >= max_queues) return;
+    if (q >= get(num_queues))
+      num_queues.store(q + 1, std::memory_order_relaxed);
+    queue_depth[q].store(depth, std::memory_order_relaxed);
+  }
+
+  void enter(alloc_stats::Stage stage) override {
+    _start = std::chrono::steady_clock::now();
+    if (next) next->enter(stage);
+  }
+
+  void leave(alloc_stats::Stage stage) override {
+    if (next) next->leave(stage);
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - _start;
+    add(stage_seconds[stage], elapsed.count());
+  }
+
+  static double now() {
+    std::chrono::duration<double> since_epoch =
+        std::chrono::system_clock::now().time_since_epoch();
+    return since_epoch.count();
+  }
+
+ private:
+  std::chrono::steady_clock::time_point _start;
+};
+
+inline Live live{};
+
+// Rewrites 'path' (if not empty) and/or prints a progress line every
+// 'interval' seconds, and once more when stopped
+class Publisher {
+ public:
+  Publisher(std::string path, double interval, bool progress)
+      : _path(std::move(path)), _interval(interval), _progress(progress) {
+    _start = _last_time = Live::now();
+    _thread            = std::thread([this] { run(); });
+  }
+
+  ~Publisher() { stop(); }
+
+  void stop() {
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      if (_stopped) return;
+      _stopped = true;
+    }
+    _wake.notify_one();
+    _thread.join();
+  }
+
+  Publisher(const Publisher&) = delete;
+  Publisher& operator=(const Publisher&) = delete;
+
+  // No update runs while the returned lock is held, e.g. around 'fork', so
+  // that the thread can't be holding the allocator or stream locks when the
+  // process is copied
+  std::unique_lock<std::mutex> pause() {
+    return std::unique_lock<std::mutex>(_mutex);
+  }
+
+ private:
+  std::string _path;
+  double      _interval;
+  bool        _progress;
+
+  double  _start, _last_time;
+  int64_t _last_entries = 0;
+
+  std::thread             _thread;
+  std::mutex              _mutex;
+  std::condition_variable _wake;
+  bool                    _stopped = false;
+
+  void run() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (!_stopped) {
+      _wake.wait_for(lock, std::chrono::duration<double>(_interval),
+                     [this] { return _stopped; });
+      publish();
+    }
+  }
+
+  void publish() {
+    auto t       = Live::now();
+    auto entries = get(live.entries);
+    auto rate    = (entries - _last_entries) / std::max(t - _last_time, 1e-9);
+    auto left    = std::max(get(live.expected) - entries, int64_t{0});
+    auto eta     = rate > 0 ? left / rate : -1.;
+
+    _last_time    = t;
+    _last_entries = entries;
+
+    auto n = get(live.weights);
+    auto w = get(live.sum_w), w2 = get(live.sum_w2);
+
+    if (_progress)
+      std::cerr << "Progress: " << entries << " / " << get(live.expected)
+                << " entries, " << rate << " entries/s, ETA " << eta
+                << " s, mean w_ff " << (n > 0 ? w / n : 0.) << std::endl;
+    if (_path.empty()) return;
+
+    auto          tmp = _path + ".tmp";
+    std::ofstream out(tmp);
+
+    auto metric = [&](const char* name, const char* type, const char* help,
+                      double value) {
+      out << "# HELP rdx_reweight_" << name << " " << help << "\n"
+          << "# TYPE rdx_reweight_" << name << " " << type << "\n"
+          << "rdx_reweight_" << name << " " << value << "\n";
+    };
+
+    out.precision(15);
+    metric("entries_total", "counter", "Input entries processed.", entries);
+    metric("entries_expected", "gauge", "Input entries of the whole run.",
+           get(live.expected));
+    metric("entries_per_second", "gauge",
+           "Entries per second since the last update.", rate);
+    metric("eta_seconds", "gauge", "Expected time left, -1 if unknown.", eta);
+    metric("uptime_seconds", "gauge", "Time since the start.", t - _start);
+    metric("last_progress_timestamp_seconds", "gauge",
+           "Time of the last progress of the event loop.",
+           get(live.last_progress));
+    metric("read_bytes_total", "counter", "Bytes read by ROOT.",
+           get(live.bytes_read));
+    metric("written_bytes_total", "counter", "Bytes written by ROOT.",
+           get(live.bytes_written));
+    metric("weights_total", "counter", "Entries with a FF weight.", n);
+    metric("weight_sum", "gauge", "Sum of the FF weights.", w);
+    metric("weight_sum_squares", "gauge", "Sum of the squared FF weights.", w2);
+    metric("weight_mean", "gauge", "Mean FF weight.", n > 0 ? w / n : 0.);
+    metric("weight_min", "gauge", "Smallest FF weight.",
+           n > 0 ? get(live.min_w) : 0.);
+    metric("weight_max", "gauge", "Largest FF weight.",
+           n > 0 ? get(live.max_w) : 0.);
+    metric("effective_entries", "gauge",
+           "Effective sample size of the FF weights.",
+           w2 > 0 ? w * w / w2 : 0.);
+
+    out << "# HELP rdx_reweight_stage_seconds_total Time per event loop "
+           "stage.\n"
+        << "# TYPE rdx_reweight_stage_seconds_total counter\n";
+    for (auto s = 0; s < alloc_stats::NumOfStages; s++)
+      out << "rdx_reweight_stage_seconds_total{stage=\""
+          << alloc_stats::stage_names[s] << "\"} " << get(live.stage_seconds[s])
+          << "\n";
+
+    out << "# HELP rdx_reweight_queue_depth Records waiting in the ring of "
+           "each worker.\n"
+        << "# TYPE rdx_reweight_queue_depth gauge\n";
+    for (auto q = 0; q < get(live.num_queues); q++)
+      out << "rdx_reweight_queue_depth{worker=\"" << q << "\"} "
+          << get(live.queue_depth[q]) << "\n";
+
+    out.close();
+    std::rename(tmp.c_str(), _path.c_str());
+  }
+};
+
+}  // namespace metrics
+
+#endif
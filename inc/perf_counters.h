@@ -0,0 +1,261 @@
+// Author: Yipeng Sun
+// License: GPLv2
+// Description: Hardware performance counters (via Linux perf_event_open) per
+//              stage of the event loop.
+// Last Change: Sat Oct 17, 2026 at 11:24 PM +0200
+//
+// All counters are in one group, so they are scheduled together and share the
+// same enabled/running times; if the PMU multiplexes the group, counts are
+// scaled by enabled / running. Only user space of the calling thread is
+// counted, so time spent in the kernel (e.g. page faults and reads during I/O)
+// doesn't show up here.
+
+#ifndef _RDX_PERF_COUNTERS_H_
+#define _RDX_PERF_COUNTERS_H_
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "alloc_stats.h"
+
+namespace perf {
+
+enum Event {
+  Cycles = 0,
+  Instructions,
+  L1dMisses,  // L1 data cache read misses
+  LlcMisses,  // last level cache misses
+  BranchMisses,
+  NumOfEvents
+};
+
+const std::vector<std::string> event_names{
+    "cycles", "instructions", "L1d misses", "LLC misses", "branch misses"};
+
+inline perf_event_attr event_attr(Event evt) {
+  perf_event_attr attr{};
+  attr.size           = sizeof(attr);
+  attr.type           = PERF_TYPE_HARDWARE;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv     = 1;
+  attr.read_format    = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED |
+                     PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+  switch (evt) {
+    case Cycles:
+      attr.config = PERF_COUNT_HW_CPU_CYCLES;
+      break;
+    case Instructions:
+      attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+      break;
+    case L1dMisses:
+      attr.type   = PERF_TYPE_HW_CACHE;
+      attr.config = PERF_COUNT_HW_CACHE_L1D |
+                    (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                    (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+      break;
+    case LlcMisses:
+      attr.config = PERF_COUNT_HW_CACHE_MISSES;
+      break;
+    default:
+      attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+  }
+
+  return attr;
+}
+
+// Raw counts, with the enabled / running times needed to undo multiplexing.
+struct Reading {
+  uint64_t enabled             = 0;
+  uint64_t running             = 0;
+  uint64_t counts[NumOfEvents] = {};
+};
+
+// Group of all counters that could be opened; events the CPU (or hypervisor)
+// doesn't support are left out instead of failing the whole group.
+class Group {
+ public:
+  Group() = default;
+  ~Group() { close(); }
+
+  Group(const Group&) = delete;
+  Group& operator=(const Group&) = delete;
+
+  // Returns false, with the reason in 'error()', if not even the cycle counter
+  // is available.
+  bool open() {
+    close();
+
+    for (auto e = 0; e < NumOfEvents; e++) {
+      auto attr     = event_attr(static_cast<Event>(e));
+      attr.disabled = _leader < 0;  // the group starts with its leader
+
+      auto fd = syscall(SYS_perf_event_open, &attr, 0, -1, _leader, 0);
+      if (fd < 0) {
+        if (e == Cycles) {
+          _error = std::string("perf_event_open: ") + strerror(errno);
+          if (errno == EACCES || errno == EPERM)
+            _error += " (check /proc/sys/kernel/perf_event_paranoid)";
+          else if (errno == ENOENT || errno == EOPNOTSUPP)
+            _error += " (no hardware PMU, e.g. in a VM or container)";
+          return false;
+        }
+        continue;
+      }
+
+      if (_leader < 0) _leader = fd;
+      _fds[e]   = fd;
+      _order[e] = _num_open++;
+    }
+
+    ioctl(_leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(_leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    return true;
+  }
+
+  void close() {
+    for (auto& fd : _fds) {
+      if (fd >= 0) ::close(fd);
+      fd = -1;
+    }
+    _leader   = -1;
+    _num_open = 0;
+  }
+
+  bool               is_open() const { return _leader >= 0; }
+  bool               has(Event evt) const { return _fds[evt] >= 0; }
+  const std::string& error() const { return _error; }
+
+  bool read(Reading& reading) const {
+    uint64_t buf[3 + NumOfEvents];
+    auto     size = (3 + _num_open) * sizeof(uint64_t);
+    if (::read(_leader, buf, size) != static_cast<ssize_t>(size)) return false;
+
+    reading.enabled = buf[1];
+    reading.running = buf[2];
+    for (auto e = 0; e < NumOfEvents; e++)
+      reading.counts[e] = has(static_cast<Event>(e)) ? buf[3 + _order[e]] : 0;
+    return true;
+  }
+
+ private:
+  int         _leader             = -1;
+  int         _num_open           = 0;
+  int         _fds[NumOfEvents]   = {-1, -1, -1, -1, -1};
+  int         _order[NumOfEvents] = {};
+  std::string _error;
+};
+
+// Counts per stage, summed over all scopes of that stage.
+// NOTE: Plain arrays only, so that it can be copied through shared memory
+struct Totals {
+  bool     available[NumOfEvents]                        = {};
+  uint64_t enabled[alloc_stats::NumOfStages]              = {};
+  uint64_t running[alloc_stats::NumOfStages]              = {};
+  uint64_t counts[alloc_stats::NumOfStages][NumOfEvents] = {};
+
+  Totals& operator+=(const Totals& rhs) {
+    for (auto e = 0; e < NumOfEvents; e++) available[e] |= rhs.available[e];
+    for (auto s = 0; s < alloc_stats::NumOfStages; s++) {
+      enabled[s] += rhs.enabled[s];
+      running[s] += rhs.running[s];
+      for (auto e = 0; e < NumOfEvents; e++) counts[s][e] += rhs.counts[s][e];
+    }
+    return *this;
+  }
+
+  double scaled(int stage, Event evt) const {
+    if (running[stage] == 0) return 0;
+    return static_cast<double>(counts[stage][evt]) * enabled[stage] /
+           running[stage];
+  }
+
+  void print(int64_t entries, std::ostream& os = std::cout) const {
+    auto na        = std::string("n/a");
+    auto per_entry = [&](int s, Event evt) {
+      return entries > 0 ? scaled(s, evt) / entries : 0.;
+    };
+
+    os << "Hardware counters per entry and stage (user space only), "
+       << entries << " entries:" << std::endl;
+    os << std::left << std::setw(16) << "stage" << std::right;
+    for (auto e = 0; e < NumOfEvents; e++)
+      os << std::setw(15) << event_names[e];
+    os << std::setw(8) << "IPC" << std::endl;
+
+    os << std::fixed << std::setprecision(1);
+    for (auto s = 0; s < alloc_stats::NumOfStages; s++) {
+      if (enabled[s] == 0) continue;
+
+      os << std::left << std::setw(16) << alloc_stats::stage_names[s]
+         << std::right;
+      for (auto e = 0; e < NumOfEvents; e++) {
+        if (available[e])
+          os << std::setw(15) << per_entry(s, static_cast<Event>(e));
+        else
+          os << std::setw(15) << na;
+      }
+
+      auto cycles = scaled(s, Cycles);
+      os << std::setw(8) << std::setprecision(2)
+         << (cycles > 0 ? scaled(s, Instructions) / cycles : 0.)
+         << std::setprecision(1);
+      if (running[s] < enabled[s])
+        os << "  (multiplexed, " << 100. * running[s] / enabled[s] << "%)";
+      os << std::endl;
+    }
+    os << std::defaultfloat << std::setprecision(6);
+  }
+};
+
+// Reads the counter group at the start and end of every stage scope.
+class StageCounters : public alloc_stats::StageHook {
+ public:
+  // Reopen the counters of the calling process and clear the totals, e.g. in a
+  // forked child, which would otherwise read its parent's counters.
+  bool open() {
+    totals = Totals{};
+    if (!_group.open()) return false;
+
+    for (auto e = 0; e < NumOfEvents; e++)
+      totals.available[e] = _group.has(static_cast<Event>(e));
+    return true;
+  }
+
+  bool               is_open() const { return _group.is_open(); }
+  const std::string& error() const { return _group.error(); }
+
+  void enter(alloc_stats::Stage) override { _group.read(_start); }
+
+  void leave(alloc_stats::Stage stage) override {
+    Reading now;
+    if (!_group.read(now)) return;
+
+    totals.enabled[stage] += now.enabled - _start.enabled;
+    totals.running[stage] += now.running - _start.running;
+    for (auto e = 0; e < NumOfEvents; e++)
+      totals.counts[stage][e] += now.counts[e] - _start.counts[e];
+  }
+
+  Totals totals{};
+
+ private:
+  Group   _group;
+  Reading _start;
+};
+
+inline StageCounters counters{};
+
+}  // namespace perf
+
+#endif
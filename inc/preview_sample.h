@@ -0,0 +1,173 @@
+// Author: Yipeng Sun
+// License: GPLv2
+// Description: Stratified subsampling of a tree by clusters, and estimates of
+//              totals over the whole tree with statistical errors.
+// Last Change: Sun Oct 18, 2026 at 01:52 AM +0200
+//
+// The tree is split into strata of consecutive whole clusters with about the
+// same number of entries. In each stratum, one cluster is drawn with a
+// probability proportional to its size, and a simple random sample of entries
+// is taken from it, so that only one cluster of baskets is read per stratum.
+// Every entry of a stratum has the same probability to be sampled, so the
+// usual stratified estimators are unbiased. Their errors treat the sample of
+// each stratum as drawn from the whole stratum, which holds as long as
+// entries within a cluster are not correlated (true for MC).
+
+#ifndef _RDX_PREVIEW_SAMPLE_H_
+#define _RDX_PREVIEW_SAMPLE_H_
+
+#include <TTree.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <random>
+#include <vector>
+
+namespace preview {
+
+// Entries [first, last) of consecutive clusters, and the sampled ones, which
+// are sorted and all in the same cluster
+struct Stratum {
+  Long64_t              first, last;
+  std::vector<Long64_t> entries;
+
+  Long64_t size() const { return last - first; }
+  double   expansion() const { return double(size()) / entries.size(); }
+};
+
+// First entry of each cluster, followed by the number of entries
+inline std::vector<Long64_t> cluster_bounds(TTree* tree) {
+  auto entries = tree->GetEntries();
+  auto cluster = tree->GetClusterIterator(0);
+
+  std::vector<Long64_t> bounds{};
+  Long64_t              start;
+  while ((start = cluster()) < entries) bounds.push_back(start);
+  bounds.push_back(entries);
+
+  return bounds;
+}
+
+// Same, for inputs without clusters, e.g. truth caches
+inline std::vector<Long64_t> uniform_bounds(Long64_t entries, Long64_t size) {
+  std::vector<Long64_t> bounds{};
+  for (Long64_t start = 0; start < entries; start += size)
+    bounds.push_back(start);
+  bounds.push_back(entries);
+
+  return bounds;
+}
+
+// About 'num_samples' entries in about 'num_strata' strata, allocated in
+// proportion to the stratum sizes, with at least 2 per stratum (if the
+// cluster is large enough) so that each stratum has a variance
+inline std::vector<Stratum> plan(const std::vector<Long64_t>& bounds,
+                                 Long64_t num_samples, int num_strata,
+                                 std::mt19937_64& rng) {
+  auto entries = bounds.back();
+  auto target  = std::max(1ll, entries / std::max(num_strata, 1));
+
+  std::vector<Stratum> result{};
+  size_t               first_cluster = 0;
+  for (size_t c = 1; c < bounds.size(); c++) {
+    if (bounds[c] - bounds[first_cluster] < target && c + 1 < bounds.size())
+      continue;
+
+    Stratum s{bounds[first_cluster], bounds[c], {}};
+    auto    n = std::max(2ll, std::llround(double(num_samples) * s.size() /
+                                            std::max(entries, 1ll)));
+
+    // Cluster containing a random entry of the stratum
+    using Uniform = std::uniform_int_distribution<Long64_t>;
+    auto entry    = Uniform(s.first, s.last - 1)(rng);
+    auto it       = std::upper_bound(bounds.begin() + first_cluster,
+                                bounds.begin() + c + 1, entry);
+    auto lo = *(it - 1), hi = *it;
+
+    // Partial Fisher-Yates shuffle of the cluster entries
+    std::vector<Long64_t> cluster(hi - lo);
+    for (Long64_t i = 0; i < hi - lo; i++) cluster[i] = lo + i;
+    n = std::min<Long64_t>(n, cluster.size());
+    for (Long64_t i = 0; i < n; i++)
+      std::swap(cluster[i], cluster[Uniform(i, cluster.size() - 1)(rng)]);
+    s.entries.assign(cluster.begin(), cluster.begin() + n);
+    std::sort(s.entries.begin(), s.entries.end());
+
+    result.push_back(s);
+    first_cluster = c;
+  }
+
+  return result;
+}
+
+// Stratified estimates of the totals of 'N' per-entry quantities over the
+// whole tree, and their covariance.
+// NOTE: Strata are added one after the other; 'add' fills the last one.
+template <int N>
+class Totals {
+ public:
+  using Values = std::array<double, N>;
+
+  void add_stratum(const Stratum& s) {
+    _strata.push_back({s.size(), 0, {}, {}});
+  }
+
+  void add(const Values& y) {
+    auto& s = _strata.back();
+    s.n++;
+    for (auto a = 0; a < N; a++) {
+      s.sum[a] += y[a];
+      for (auto b = 0; b < N; b++) s.sum_prod[a * N + b] += y[a] * y[b];
+    }
+  }
+
+  Values total() const {
+    Values result{};
+    for (const auto& s : _strata)
+      if (s.n > 0)
+        for (auto a = 0; a < N; a++) result[a] += s.size * s.sum[a] / s.n;
+    return result;
+  }
+
+  // Covariance of the totals, with the finite population correction
+  std::array<double, N * N> cov() const {
+    std::array<double, N * N> result{};
+    for (const auto& s : _strata) {
+      if (s.n < 2) continue;
+      double f     = double(s.n) / s.size;
+      double scale = double(s.size) * s.size * (1 - f) / s.n / (s.n - 1);
+      for (auto a = 0; a < N; a++)
+        for (auto b = 0; b < N; b++)
+          result[a * N + b] +=
+              scale * (s.sum_prod[a * N + b] - s.sum[a] * s.sum[b] / s.n);
+    }
+    return result;
+  }
+
+  double error(int a) const {
+    return std::sqrt(std::max(cov()[a * N + a], 0.));
+  }
+
+  // Error of a function of the totals with gradient 'grad' (delta method)
+  double error(const Values& grad) const {
+    auto   c   = cov();
+    double var = 0;
+    for (auto a = 0; a < N; a++)
+      for (auto b = 0; b < N; b++) var += grad[a] * c[a * N + b] * grad[b];
+    return std::sqrt(std::max(var, 0.));
+  }
+
+ private:
+  struct Sums {
+    Long64_t                  size, n;
+    Values                    sum;
+    std::array<double, N * N> sum_prod;
+  };
+
+  std::vector<Sums> _strata;
+};
+
+}  // namespace preview
+
+#endif
@@ -0,0 +1,163 @@
+// Author: Yipeng Sun
+// License: GPLv2
+// Description: FF weight as a lazily computed RDataFrame column, with one
+//              HAMMER instance per processing slot.
+// Last Change: Sun Oct 18, 2026 at 07:21 AM +0200
+//
+// Usage:
+//
+//   rdf_weight::HammerWeight w{};
+//   auto df = ROOT::RDataFrame("mc_dst_tau_aux", "samples/rdst-run1.root")
+//                 .Filter("mu_true_pe > 5000")
+//                 .DefineSlot("w_ff", w, rdf_weight::HammerWeight::columns())
+//                 .Filter("w_ff >= 0");
+//
+// so that HAMMER only runs on entries that pass the filters upstream, and the
+// weights are never written to disk. Copies of the functor (RDataFrame keeps
+// its own) share the same HAMMER instances.
+//
+// NOTE: Instances are only touched by the thread of their slot, but they may
+//       still share state inside HAMMER, and no patch removing it is applied
+//       to the HAMMER in 'nix/hammer-phys' yet. So the functor refuses more
+//       than one slot, or implicit MT, unless 'unverified_threads' is set,
+//       e.g. to run 'make hammer-stress'-style checks on a patched build.
+
+#ifndef _RDX_RDF_WEIGHT_H_
+#define _RDX_RDF_WEIGHT_H_
+
+#include <Hammer/Hammer.hh>
+#include <Hammer/Particle.hh>
+
+#include <Rtypes.h>
+#include <TROOT.h>
+
+#include <algorithm>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "rdx_hammer.h"
+#include "truth_cache.h"
+#include "truth_topology.h"
+
+namespace rdf_weight {
+
+// Same as 'w_ff_invalid' in 'reweighter.h'
+constexpr double invalid = -1.;
+
+struct Stats {
+  Long64_t entries     = 0;  // entries that reached the column
+  Long64_t hammer_runs = 0;
+  Long64_t topo_rej    = 0;  // failed the topology pre-check, HAMMER skipped
+  Long64_t weights     = 0;  // entries with a weight
+};
+
+// Number of slots of a RDataFrame created now
+inline unsigned num_slots() {
+  return std::max(1u, ROOT::GetThreadPoolSize());
+}
+
+// Used to repeat a column type once per truth particle
+template <std::size_t, class T>
+using Column = T;
+
+template <class Parts>
+class BasicHammerWeight;
+
+// NOTE: RDataFrame needs a callable with a fixed signature to infer the column
+//       types, so the 11 truth particles are spelled out as packs over 'P':
+//       all IDs first, then all energies, and so on (see 'columns')
+template <std::size_t... P>
+class BasicHammerWeight<std::index_sequence<P...>> {
+ public:
+  // 'slots' must be at least the number of slots of the RDataFrame
+  explicit BasicHammerWeight(unsigned          slots              = num_slots(),
+                             const WCSettings& frozen_wc          = {},
+                             double            topo_tol           = 1.,
+                             bool              unverified_threads = false)
+      : _slots(std::make_shared<std::vector<Slot>>(slots)),
+        _topo_tol(topo_tol) {
+    if ((slots > 1 || ROOT::IsImplicitMTEnabled()) && !unverified_threads)
+      throw std::runtime_error(
+          "HAMMER is not known to be thread safe; refusing to reweight with "
+          "implicit MT or more than one slot");
+
+    // NOTE: 'initRun' is done one instance after the other
+    for (auto& s : *_slots) {
+      s.ham = std::make_unique<Hammer::Hammer>();
+      setup_hammer(*s.ham, frozen_wc);
+    }
+  }
+
+  static std::vector<std::string> columns() {
+    std::vector<std::string> result{};
+    for (const auto& prefix : truth_part_prefixes)
+      result.push_back(prefix + "_id");
+    for (const auto& comp : {"pe", "px", "py", "pz"})
+      for (const auto& prefix : truth_part_prefixes)
+        result.push_back(prefix + "_true_" + comp);
+    return result;
+  }
+
+  double operator()(unsigned slot, Column<P, Int_t>... id,
+                    Column<P, Double_t>... pe, Column<P, Double_t>... px,
+                    Column<P, Double_t>... py,
+                    Column<P, Double_t>... pz) const {
+    TruthEvent evt{};
+    ((evt.id[P] = id, evt.pe[P] = pe, evt.px[P] = px, evt.py[P] = py,
+      evt.pz[P] = pz),
+     ...);
+
+    return (*_slots)[slot].weight(evt, _topo_tol);
+  }
+
+  // Summed over all slots; only meaningful once the event loop has run
+  Stats stats() const {
+    Stats result{};
+    for (const auto& s : *_slots) {
+      result.entries += s.stats.entries;
+      result.hammer_runs += s.stats.hammer_runs;
+      result.topo_rej += s.stats.topo_rej;
+      result.weights += s.stats.weights;
+    }
+    return result;
+  }
+
+ private:
+  // NOTE: Aligned so that the counters of different slots don't share a
+  //       cache line
+  struct alignas(64) Slot {
+    std::unique_ptr<Hammer::Hammer> ham;
+    std::vector<Hammer::Particle>   parts;  // reused across events
+    Stats                           stats;
+
+    double weight(const TruthEvent& evt, double topo_tol) {
+      stats.entries++;
+
+      auto b_id_fix = fix_b_id(evt);
+      if (truth_topology::check(evt, b_id_fix, topo_tol).veto) {
+        stats.topo_rej++;
+        return invalid;
+      }
+
+      stats.hammer_runs++;
+      if (!init_event(*ham, evt, b_id_fix, parts)) return invalid;
+
+      ham->processEvent();
+      stats.weights++;
+      return ham->getWeight("SemiTauonic");
+    }
+  };
+
+  std::shared_ptr<std::vector<Slot>> _slots;
+  double                             _topo_tol;
+};
+
+using HammerWeight =
+    BasicHammerWeight<std::make_index_sequence<NumOfTruthPart>>;
+
+}  // namespace rdf_weight
+
+#endif
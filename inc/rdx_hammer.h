@@ -0,0 +1,173 @@
+// Author: Yipeng Sun
+// License: GPLv2
+// Description: HAMMER setup and process of B0 -> D* Tau Nu, Tau -> Mu Nu Nu,
+//              shared by the reweighter and its tests.
+// Last Change: Sun Oct 18, 2026 at 08:24 AM +0200
+
+#ifndef _RDX_HAMMER_H_
+#define _RDX_HAMMER_H_
+
+#include <Hammer/Hammer.hh>
+#include <Hammer/Math/FourMomentum.hh>
+#include <Hammer/Particle.hh>
+#include <Hammer/Process.hh>
+
+#include <Rtypes.h>
+
+#include <complex>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "truth_cache.h"
+
+//////////////////////
+// HAMMER particles //
+//////////////////////
+
+inline auto particle(Double_t pe, Double_t px, Double_t py, Double_t pz,
+                     Int_t pid) {
+  auto four_mom = Hammer::FourMomentum(pe, px, py, pz);
+  auto part_id  = static_cast<Hammer::PdgId>(pid);
+
+  return Hammer::Particle(four_mom, part_id);
+}
+
+inline auto particle(const TruthEvent& evt, TruthPart p, Int_t pid) {
+  return particle(evt.pe[p], evt.px[p], evt.py[p], evt.pz[p], pid);
+}
+
+inline auto particle(const TruthEvent& evt, TruthPart p) {
+  return particle(evt, p, evt.id[p]);
+}
+
+///////////////////////////////
+// HAMMER process and scheme //
+///////////////////////////////
+
+// clang-format off
+inline void add_ham_part_Tau(Hammer::Process& proc,
+                             Hammer::Particle& B0,
+                             Hammer::Particle& Dst,
+                             Hammer::Particle& D0, Hammer::Particle& SlowPi,
+                             Hammer::Particle& K, Hammer::Particle& Pi,
+                             Hammer::Particle& Tau,
+                             Hammer::Particle& Anti_Nu_Tau,
+                             Hammer::Particle& Nu_Tau,
+                             Hammer::Particle& Mu,
+                             Hammer::Particle& Anti_Nu_Mu) {
+  // clang-format on
+  auto B0_idx          = proc.addParticle(B0);
+  auto Dst_idx         = proc.addParticle(Dst);
+  auto SlowPi_idx      = proc.addParticle(SlowPi);
+  auto D0_idx          = proc.addParticle(D0);
+  auto K_idx           = proc.addParticle(K);
+  auto Pi_idx          = proc.addParticle(Pi);
+  auto Mu_idx          = proc.addParticle(Mu);
+  auto Tau_idx         = proc.addParticle(Tau);
+  auto Anti_Nu_Mu_idx  = proc.addParticle(Anti_Nu_Mu);
+  auto Anti_Nu_Tau_idx = proc.addParticle(Anti_Nu_Tau);
+  auto Nu_Tau_idx      = proc.addParticle(Nu_Tau);
+
+  proc.addVertex(B0_idx, {Dst_idx, Tau_idx, Anti_Nu_Tau_idx});
+  proc.addVertex(Tau_idx, {Mu_idx, Nu_Tau_idx, Anti_Nu_Mu_idx});
+  proc.addVertex(Dst_idx, {D0_idx, SlowPi_idx});
+  proc.addVertex(D0_idx, {K_idx, Pi_idx});
+}
+
+// We need to fix the ID for B0's that oscillate to B~0
+// a.k.a Manually fix 'wrong-sign' IDs
+inline int fix_b_id(const TruthEvent& evt) {
+  if (evt.id[B0] * evt.id[Dst] > 0) return -evt.id[B0];
+  return evt.id[B0];
+}
+
+// 'parts' is only scratch space; passing the same vector for every event
+// avoids reallocating it
+inline Hammer::Process make_process(const TruthEvent& evt, int b_id_fix,
+                                    std::vector<Hammer::Particle>& parts) {
+  // Define MC truth particles for FF reweighting
+  parts.clear();
+  for (auto p = 0; p < NumOfTruthPart; p++)
+    parts.push_back(p == B0 ? particle(evt, B0, b_id_fix)
+                            : particle(evt, static_cast<TruthPart>(p)));
+
+  Hammer::Process proc;
+  add_ham_part_Tau(proc, parts[B0], parts[Dst], parts[D0], parts[SlowPi],
+                   parts[K], parts[Pi], parts[Tau], parts[AntiNuTau],
+                   parts[NuTau], parts[Mu], parts[AntiNuMu]);
+  return proc;
+}
+
+inline Hammer::Process make_process(const TruthEvent& evt, int b_id_fix) {
+  std::vector<Hammer::Particle> parts{};
+  return make_process(evt, b_id_fix, parts);
+}
+
+// Start a new HAMMER event with the process of a single truth candidate.
+// Returns false if HAMMER doesn't accept the process, otherwise the weight is
+// available after 'processEvent'.
+inline bool init_event(Hammer::Hammer& ham, const TruthEvent& evt,
+                       int b_id_fix, std::vector<Hammer::Particle>& parts) {
+  auto proc = make_process(evt, b_id_fix, parts);
+
+  ham.initEvent();
+  return ham.addProcess(proc) != 0;
+}
+
+// Wilson coefficients that are fixed for the whole run, per HAMMER WC process,
+// e.g. {"BtoCTauNu", {{"SM", 1.}}}
+using WCSettings =
+    std::map<std::string, std::map<std::string, std::complex<double>>>;
+
+// Decays, and FF schemes per hadronic transition
+const std::vector<std::string> hammer_decays{"BD*TauNu", "TauEllNuNu"};
+
+const std::map<std::string, std::string> hammer_ff_scheme{{"BD*", "CLN"}};
+const std::map<std::string, std::string> hammer_ff_input{{"BD*", "ISGW2"}};
+
+inline void setup_hammer(Hammer::Hammer&   ham,
+                         const WCSettings& frozen_wc = {}) {
+  ham.includeDecay(hammer_decays);
+  ham.addFFScheme("SemiTauonic", hammer_ff_scheme);
+  // ham.setOptions("BctoJpsiBGL: {dvec: [0., 0., 0.] }");
+  ham.setFFInputScheme(hammer_ff_input);
+
+  ham.setUnits("MeV");
+
+  ham.initRun();
+
+  // NOTE: HAMMER then contracts the WC dimension once, and per-event weights
+  //       are computed on the reduced tensors. The CLN scheme has no FF
+  //       variation dimension, so there is nothing to specialize for FFs.
+  for (const auto& proc : frozen_wc)
+    ham.specializeWCInWeights(proc.first, proc.second);
+}
+
+// NOTE: The Makefile sets this to the version in nix/hammer-phys
+#ifndef RDX_HAMMER_VERSION
+#define RDX_HAMMER_VERSION "unknown"
+#endif
+
+// Everything of 'setup_hammer' that changes the weights, e.g. to tell apart
+// weights stored by runs with different settings
+inline std::string hammer_scheme(const WCSettings& frozen_wc = {}) {
+  std::ostringstream out;
+  out.precision(17);
+
+  out << "HAMMER " << RDX_HAMMER_VERSION << "; ";
+  for (const auto& decay : hammer_decays) out << "decay " << decay << "; ";
+  for (const auto& ff : hammer_ff_scheme)
+    out << "SemiTauonic " << ff.first << " " << ff.second << "; ";
+  for (const auto& ff : hammer_ff_input)
+    out << "input " << ff.first << " " << ff.second << "; ";
+  out << "units MeV";
+  for (const auto& proc : frozen_wc)
+    for (const auto& wc : proc.second)
+      out << "; WC " << proc.first << " " << wc.first << " " << wc.second;
+
+  return out.str();
+}
+
+#endif
@@ -0,0 +1,69 @@
+// Author: Yipeng Sun
+// License: GPLv2
+// Description: C interface of the streaming reweighter in 'reweighter.h', as
+//              built into librdx-reweight.so.
+// Last Change: Sun Oct 18, 2026 at 09:12 AM +0200
+//
+// Truth columns are passed as arrays of pointers, one per truth particle, in
+// the order of 'truth_part_prefixes':
+//   b, dst, d0, k, pi, spi, mu, tau, anu_tau, nu_tau, anu_mu
+// each pointing to 'size' values. Momenta are in MeV.
+//
+// NOTE: HAMMER is not known to be thread safe, so reweighters, even separate
+//       ones, must only be used by one thread at a time. While one thread is
+//       in 'rdx_reweighter_new' or 'rdx_reweighter_push', the same calls from
+//       other threads fail (see 'rdx_reweighter_error') instead of running
+//       HAMMER concurrently.
+
+#ifndef _RDX_REWEIGHT_CAPI_H_
+#define _RDX_REWEIGHT_CAPI_H_
+
+#ifdef __cplusplus
+#include <cstddef>
+#include <cstdint>
+extern "C" {
+#else
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#endif
+
+typedef struct rdx_reweighter rdx_reweighter;
+
+typedef struct {
+  int64_t entries;
+  int64_t hammer_runs;
+  int64_t cache_hits;
+  int64_t presel_rej;
+  int64_t topo_rej;
+  int64_t weights;
+  double  sum_w;
+  double  sum_w2;
+  double  hammer_time;
+} rdx_reweight_stats;
+
+// Set up HAMMER; NULL on failure (see 'rdx_reweighter_error')
+rdx_reweighter* rdx_reweighter_new(double topo_tol);
+void            rdx_reweighter_free(rdx_reweighter* rw);
+
+// Reweight 'size' candidates. 'run' and 'evt' (both or neither), 'selected'
+// and all outputs but 'w_ff' may be NULL. Returns the number of weights, or -1
+// on failure.
+int64_t rdx_reweighter_push(rdx_reweighter* rw, size_t size,
+                            const uint32_t* run, const uint64_t* evt,
+                            const int32_t* const* id, const double* const* pe,
+                            const double* const* px, const double* const* py,
+                            const double* const* pz, const bool* selected,
+                            double* w_ff, double* q2, double* mm2, double* el);
+
+// Counters since the last call
+void rdx_reweighter_take_stats(rdx_reweighter* rw, rdx_reweight_stats* out);
+
+// Message of the last failure in this thread
+const char* rdx_reweighter_error(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
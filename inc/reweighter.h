@@ -0,0 +1,641 @@
+// Author: Yipeng Sun
+// License: GPLv2
+// Description: Streaming FF reweighting of B0 -> D* Tau Nu truth candidates,
+//              from memory, without any ROOT I/O.
+// Last Change: Sun Oct 18, 2026 at 06:41 AM +0200
+//
+// HAMMER is set up once, then batches of truth IDs and four-momenta are pushed
+// as arrays, and the weights (and the true q2, mm2 and El) come back in arrays
+// of the same length:
+//
+//   Reweighter          rw{};
+//   TruthBatch          in{n, run, evt};  // and e.g. in.pe[B0] = b_true_pe
+//   std::vector<double> w_ff(n);
+//   rw.push(in, {w_ff.data()});
+//
+// Truth decays that have been reweighted already (same run and event number,
+// and the same kinematics) are not passed to HAMMER again, also across
+// batches. With a weight store (see 'weight_store.h'), neither are decays
+// reweighted by earlier runs, e.g. of other productions.
+//
+// rdx-run1-sample.w is the ntuple and truth cache I/O around this;
+// librdx-reweight.so exposes it to C and Python (utils/rdx_reweight.py).
+//
+// NOTE: A Reweighter is not thread safe; use one per process (see the '-j'
+//       mode of the reweighter) or per RDataFrame slot (see 'rdf_weight.h').
+
+#ifndef _RDX_REWEIGHTER_H_
+#define _RDX_REWEIGHTER_H_
+
+#include <Hammer/Hammer.hh>
+#include <Hammer/Particle.hh>
+
+#include <Rtypes.h>
+#include <TLorentzVector.h>
+#include <TVector3.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <initializer_list>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "alloc_stats.h"
+#include "rdx_hammer.h"
+#include "truth_cache.h"
+#include "truth_topology.h"
+#include "weight_store.h"
+
+// Weight assigned to entries that HAMMER can't process, when every input entry
+// needs an output (e.g. in fast-clone mode)
+const Double_t w_ff_invalid = -1.;
+
+////////////////////////
+// True fit variables //
+////////////////////////
+
+inline TLorentzVector lorentz_vec(const TruthEvent& evt, TruthPart p) {
+  TLorentzVector mom;
+  mom.SetPxPyPzE(evt.px[p], evt.py[p], evt.pz[p], evt.pe[p]);
+  return mom;
+}
+
+// NOTE: Summed component-wise, in the same order as TLorentzVector would, so
+//       that no temporary four-vectors are built per event
+inline double calc_mm2_with_nu(const TruthEvent&                evt,
+                               std::initializer_list<TruthPart> nu) {
+  Double_t pe = 0, px = 0, py = 0, pz = 0;
+
+  for (auto p : nu) {
+    px += evt.px[p];
+    py += evt.py[p];
+    pz += evt.pz[p];
+    pe += evt.pe[p];
+  }
+
+  return (pe * pe - (px * px + py * py + pz * pz)) / 1E6;
+}
+
+// clang-format off
+inline void calc_true_fit_vars(Double_t& q2, Double_t& el,
+                               TVector3& b_lab_v,
+                               TLorentzVector& b_mom, TLorentzVector& dst_mom,
+                               TLorentzVector mu_mom) {
+  // clang-format on
+  q2 = (b_mom - dst_mom).M2() / 1E6;
+
+  // NOTE: The Mu momentum is copied so that we don't mess up with later
+  // calculation!
+  mu_mom.Boost(-b_lab_v);
+  el = mu_mom.E() / 1E3;
+}
+
+inline void calc_kinematics(const TruthEvent& evt, Double_t& q2, Double_t& mm2,
+                            Double_t& el) {
+  // Find B velocity in the lab frame
+  auto v_x = evt.px[B0] / evt.pe[B0];
+  auto v_y = evt.py[B0] / evt.pe[B0];
+  auto v_z = evt.pz[B0] / evt.pe[B0];
+
+  // velocity of B in the lab frame
+  auto b_lab_v = TVector3(v_x, v_y, v_z);
+
+  // Compute q2 and el
+  auto b_mom   = lorentz_vec(evt, B0);
+  auto dst_mom = lorentz_vec(evt, Dst);
+  calc_true_fit_vars(q2, el, b_lab_v, b_mom, dst_mom, lorentz_vec(evt, Mu));
+
+  // Compute mm2
+  mm2 = calc_mm2_with_nu(evt, {NuTau, AntiNuTau, AntiNuMu});
+}
+
+////////////////////////////////////
+// Truth-event weight dedup cache //
+////////////////////////////////////
+
+// The same truth decay shows up in multiple trees (e.g. mc_dst_tau_aux and
+// dst_iso), so HAMMER only needs to run once per (runNumber, eventNumber).
+// NOTE: With multiple candidates per entry, which all share the same
+//       (runNumber, eventNumber), 'truth' tells their truth decays apart (see
+//       'truth_hash'); it is 0 otherwise.
+struct EventKey {
+  UInt_t    run;
+  ULong64_t evt;
+  ULong64_t truth = 0;
+
+  bool operator==(const EventKey& rhs) const {
+    return run == rhs.run && evt == rhs.evt && truth == rhs.truth;
+  }
+};
+
+struct EventKeyHash {
+  size_t operator()(const EventKey& key) const {
+    return std::hash<ULong64_t>{}(key.evt ^ key.truth) ^
+           (std::hash<UInt_t>{}(key.run) + 0x9e3779b9 + (key.evt << 6));
+  }
+};
+
+// Same quantities as the check of cached results ('b_pe' and 'mu_pe')
+inline ULong64_t truth_hash(const TruthEvent& evt) {
+  ULong64_t b, mu;
+  std::memcpy(&b, &evt.pe[B0], sizeof(b));
+  std::memcpy(&mu, &evt.pe[Mu], sizeof(mu));
+  return b * 0x9e3779b97f4a7c15ull ^ (mu + (b << 6) + (b >> 2));
+}
+
+struct EventResult {
+  Double_t w_ff, q2, mm2, el;
+  bool     ok;  // HAMMER accepted the process
+  // Used to make sure that a key really refers to the same truth decay
+  Double_t b_pe, mu_pe;
+};
+
+struct ReweightStats {
+  Long64_t entries     = 0;
+  Long64_t hammer_runs = 0;
+  Long64_t cache_hits  = 0;
+  Long64_t collisions  = 0;  // same key, different truth kinematics
+  Long64_t presel_rej  = 0;  // failed the pre-selection, HAMMER skipped
+  Long64_t topo_rej    = 0;  // failed the topology pre-check, HAMMER skipped
+  double   hammer_time = 0;  // in processEvent and getWeight, in seconds
+  Long64_t weights     = 0;  // entries with a weight
+  double   sum_w       = 0;
+  double   sum_w2      = 0;
+  Long64_t store_looks = 0;  // weight store lookups
+  Long64_t store_hits  = 0;  // found in the weight store, HAMMER skipped
+  Long64_t store_new   = 0;  // added to the weight store
+
+  void add_weight(double w) {
+    weights++;
+    sum_w += w;
+    sum_w2 += w * w;
+  }
+
+  ReweightStats& operator+=(const ReweightStats& rhs) {
+    entries += rhs.entries;
+    hammer_runs += rhs.hammer_runs;
+    cache_hits += rhs.cache_hits;
+    collisions += rhs.collisions;
+    presel_rej += rhs.presel_rej;
+    topo_rej += rhs.topo_rej;
+    hammer_time += rhs.hammer_time;
+    weights += rhs.weights;
+    sum_w += rhs.sum_w;
+    sum_w2 += rhs.sum_w2;
+    store_looks += rhs.store_looks;
+    store_hits += rhs.store_hits;
+    store_new += rhs.store_new;
+    return *this;
+  }
+};
+
+// NOTE: Nodes come from a pool, so that a new truth decay doesn't cost a heap
+//       allocation of its own
+using CacheAllocator =
+    alloc_stats::PoolAllocator<std::pair<const EventKey, EventResult>>;
+using WeightCache = std::unordered_map<EventKey, EventResult, EventKeyHash,
+                                       std::equal_to<EventKey>, CacheAllocator>;
+
+///////////////////
+// Streaming API //
+///////////////////
+
+struct ReweighterOptions {
+  WCSettings  frozen_wc    = {};
+  double      topo_tol     = 1.;  // MeV, of the truth topology pre-check
+  std::string weight_store = "";  // path, none if empty
+};
+
+// Structure of arrays of 'size' candidates, e.g. the columns of a truth cache.
+// Without 'run' and 'evt', candidates are never deduplicated; without
+// 'selected', all of them pass the pre-selection.
+struct TruthBatch {
+  size_t          size = 0;
+  const uint32_t* run  = nullptr;
+  const uint64_t* evt  = nullptr;
+
+  const int32_t* id[NumOfTruthPart] = {};
+  const double*  pe[NumOfTruthPart] = {};
+  const double*  px[NumOfTruthPart] = {};
+  const double*  py[NumOfTruthPart] = {};
+  const double*  pz[NumOfTruthPart] = {};
+
+  const bool* selected = nullptr;
+
+  TruthEvent event(size_t i) const {
+    TruthEvent evt_i{};
+    evt_i.runNumber   = run ? run[i] : 0;
+    evt_i.eventNumber = evt ? evt[i] : 0;
+    for (auto p = 0; p < NumOfTruthPart; p++) {
+      evt_i.id[p] = id[p][i];
+      evt_i.pe[p] = pe[p][i];
+      evt_i.px[p] = px[p][i];
+      evt_i.py[p] = py[p][i];
+      evt_i.pz[p] = pz[p][i];
+    }
+    return evt_i;
+  }
+};
+
+// Arrays of at least 'size' entries of the pushed batch; all but 'w_ff' are
+// optional. Candidates HAMMER can't process get 'w_ff_invalid'.
+struct WeightBatch {
+  double* w_ff = nullptr;
+  double* q2   = nullptr;
+  double* mm2  = nullptr;
+  double* el   = nullptr;
+};
+
+class Reweighter {
+ public:
+  explicit Reweighter(const ReweighterOptions& opts = {})
+      : _topo_tol(opts.topo_tol) {
+    alloc_stats::Scope scope(alloc_stats::Init);
+    setup_hammer(_ham, opts.frozen_wc);
+
+    _scheme.add(hammer_scheme(opts.frozen_wc));
+    if (!opts.weight_store.empty())
+      _store.reset(new weight_store::Store(opts.weight_store));
+  }
+
+  Reweighter(const Reweighter&) = delete;
+  Reweighter& operator=(const Reweighter&) = delete;
+
+  // Reweight a single truth candidate, reusing the cache when possible.
+  // Returns the kinematics even if the candidate isn't reweighted
+  // ('ok == false'). Candidates that are not 'selected' are only reweighted if
+  // the same truth decay has been already.
+  EventResult process(const TruthEvent& evt, bool selected = true,
+                      bool dedup = true) {
+    auto looked_up = _next_lookup < _lookup_keys.size() ? _next_lookup++ : none;
+    _stats.entries++;
+
+    // Reuse the result if this truth event has been reweighted already
+    auto key    = EventKey{evt.runNumber, evt.eventNumber};
+    auto cached = dedup ? _cache.find(key) : _cache.end();
+    if (cached != _cache.end()) {
+      const auto& res = cached->second;
+
+      if (res.b_pe == evt.pe[B0] && res.mu_pe == evt.pe[Mu]) {
+        _stats.cache_hits++;
+        if (res.ok) _stats.add_weight(res.w_ff);
+        return res;
+      }
+
+      _stats.collisions++;
+    }
+    auto new_key = dedup && cached == _cache.end();
+
+    EventResult res{w_ff_invalid, 0, 0, 0, false, evt.pe[B0], evt.pe[Mu]};
+
+    auto b_id_fix = fix_b_id(evt);
+    {
+      alloc_stats::Scope scope(alloc_stats::Kinematics);
+      calc_kinematics(evt, res.q2, res.mm2, res.el);
+    }
+
+    // NOTE: Events outside of the pre-selection are not cached, as they may
+    //       pass it in another tree
+    if (!selected) {
+      _stats.presel_rej++;
+      return res;
+    }
+
+    // Skip decays HAMMER can't match before building any HAMMER object; other
+    // failures (e.g. a missing FSR photon) are only counted
+    auto topo = truth_topology::check(evt, b_id_fix, _topo_tol);
+    _topo.add(topo);
+    if (topo.veto) {
+      _stats.topo_rej++;
+      if (new_key) _cache[key] = res;
+      return res;
+    }
+
+    weight_store::Key   store_key{};
+    weight_store::Value stored{};
+    if (_store && find_stored(evt, b_id_fix, looked_up, store_key, stored)) {
+      res.w_ff = stored.w_ff;
+      res.ok   = stored.ok;
+      if (res.ok)
+        _stats.add_weight(res.w_ff);
+      else
+        _topo.add_hammer_rejection(topo);
+
+      if (new_key) _cache[key] = res;
+      return res;
+    }
+
+    // Compute FF weight ///////////////////////////////////////////////////////
+    bool accepted;
+    {
+      alloc_stats::Scope scope(alloc_stats::Process);
+      accepted = init_event(_ham, evt, b_id_fix, _parts);
+    }
+    _stats.hammer_runs++;
+
+    if (accepted) {
+      auto start = std::chrono::steady_clock::now();
+      {
+        alloc_stats::Scope scope(alloc_stats::ProcessEvent);
+        _ham.processEvent();
+      }
+      {
+        alloc_stats::Scope scope(alloc_stats::GetWeight);
+        res.w_ff = _ham.getWeight("SemiTauonic");
+      }
+      res.ok = true;
+      _stats.hammer_time += seconds_since(start);
+      _stats.add_weight(res.w_ff);
+      check_weight(res.w_ff, evt.eventNumber);
+    } else
+      _topo.add_hammer_rejection(topo);
+
+    if (_store) store(store_key, res);
+
+    // NOTE: A colliding key keeps the first truth decay in the cache
+    if (new_key) _cache[key] = res;
+
+    return res;
+  }
+
+  // Same, for all candidates of one ntuple entry, into 'res'.
+  // NOTE: If 'shared_event' is set, all candidates are added as processes of
+  //       a single HAMMER event, so that 'initEvent' and 'processEvent' run
+  //       once per entry instead of once per candidate.
+  void process(const std::vector<TruthEvent>& cands,
+               const std::vector<bool>& selected, bool shared_event,
+               std::vector<EventResult>& res) {
+    res.assign(cands.size(), EventResult{w_ff_invalid, 0, 0, 0, false, 0, 0});
+    _pending.clear();
+    auto event_started = false;
+
+    for (auto i = 0ul; i < cands.size(); i++) {
+      const auto& evt = cands[i];
+      auto&       r   = res[i];
+      _stats.entries++;
+
+      r.b_pe  = evt.pe[B0];
+      r.mu_pe = evt.pe[Mu];
+
+      // Reuse the result if this truth decay has been reweighted already
+      auto key    = EventKey{evt.runNumber, evt.eventNumber, truth_hash(evt)};
+      auto cached = _cache.find(key);
+      if (cached != _cache.end()) {
+        if (cached->second.b_pe == r.b_pe && cached->second.mu_pe == r.mu_pe) {
+          _stats.cache_hits++;
+          r = cached->second;
+          continue;
+        }
+        _stats.collisions++;
+      }
+
+      auto b_id_fix = fix_b_id(evt);
+      {
+        alloc_stats::Scope scope(alloc_stats::Kinematics);
+        calc_kinematics(evt, r.q2, r.mm2, r.el);
+      }
+
+      if (!selected[i]) {
+        _stats.presel_rej++;
+        continue;
+      }
+
+      auto topo = truth_topology::check(evt, b_id_fix, _topo_tol);
+      _topo.add(topo);
+      if (topo.veto) {
+        _stats.topo_rej++;
+        if (cached == _cache.end()) _cache[key] = r;
+        continue;
+      }
+
+      // NOTE: Candidates of the same entry often share the same truth decay,
+      //       which the cache doesn't know about yet in shared-event mode
+      if (shared_event) {
+        auto dup = std::find_if(_pending.begin(), _pending.end(), [&](auto& p) {
+          return p.key == key && res[p.cand].b_pe == r.b_pe &&
+                 res[p.cand].mu_pe == r.mu_pe;
+        });
+        if (dup != _pending.end()) {
+          _stats.cache_hits++;
+          _pending.push_back({i, dup->proc_id, false, key, topo, {}, false});
+          continue;
+        }
+      }
+
+      weight_store::Key   store_key{};
+      weight_store::Value stored{};
+      if (_store && find_stored(evt, b_id_fix, none, store_key, stored)) {
+        r.w_ff = stored.w_ff;
+        r.ok   = stored.ok;
+        if (!r.ok) _topo.add_hammer_rejection(topo);
+
+        if (cached == _cache.end()) _cache[key] = r;
+        continue;
+      }
+
+      // Compute FF weight /////////////////////////////////////////////////////
+      size_t proc_id;
+      {
+        alloc_stats::Scope scope(alloc_stats::Process);
+        auto               proc = make_process(evt, b_id_fix, _parts);
+
+        if (!shared_event || !event_started) {
+          _ham.initEvent();
+          event_started = true;
+        }
+        proc_id = _ham.addProcess(proc);
+      }
+      _stats.hammer_runs++;
+
+      if (shared_event) {
+        _pending.push_back(
+            {i, proc_id, cached == _cache.end(), key, topo, store_key, true});
+        continue;
+      }
+
+      if (proc_id != 0) {
+        auto start = std::chrono::steady_clock::now();
+        {
+          alloc_stats::Scope scope(alloc_stats::ProcessEvent);
+          _ham.processEvent();
+        }
+        {
+          alloc_stats::Scope scope(alloc_stats::GetWeight);
+          r.w_ff = _ham.getWeight("SemiTauonic");
+        }
+        r.ok = true;
+        _stats.hammer_time += seconds_since(start);
+      } else
+        _topo.add_hammer_rejection(topo);
+
+      if (_store) store(store_key, r);
+      if (cached == _cache.end()) _cache[key] = r;
+    }
+
+    if (!_pending.empty()) {
+      auto start = std::chrono::steady_clock::now();
+      {
+        alloc_stats::Scope scope(alloc_stats::ProcessEvent);
+        _ham.processEvent();
+      }
+
+      alloc_stats::Scope scope(alloc_stats::GetWeight);
+      for (const auto& p : _pending) {
+        auto& r = res[p.cand];
+        if (p.proc_id != 0) {
+          r.w_ff = _ham.getWeight("SemiTauonic", {p.proc_id});
+          r.ok   = true;
+        } else if (p.new_key)
+          _topo.add_hammer_rejection(p.topo);
+
+        if (_store && p.ran) store(p.store_key, r);
+        if (p.new_key) _cache[p.key] = r;
+      }
+      _stats.hammer_time += seconds_since(start);
+    }
+
+    for (auto i = 0ul; i < res.size(); i++)
+      if (res[i].ok) {
+        _stats.add_weight(res[i].w_ff);
+        check_weight(res[i].w_ff, cands[i].eventNumber);
+      }
+  }
+
+  // Reweight a batch of candidates in order; returns the number of weights
+  size_t push(const TruthBatch& in, const WeightBatch& out) {
+    size_t weights = 0;
+    auto   dedup   = in.run && in.evt;
+
+    _batch.clear();
+    for (size_t i = 0; i < in.size; i++) _batch.push_back(in.event(i));
+    lookup(_batch);
+
+    for (size_t i = 0; i < in.size; i++) {
+      auto res = process(_batch[i], !in.selected || in.selected[i], dedup);
+      if (res.ok) weights++;
+
+      out.w_ff[i] = res.ok ? res.w_ff : w_ff_invalid;
+      if (out.q2) out.q2[i] = res.q2;
+      if (out.mm2) out.mm2[i] = res.mm2;
+      if (out.el) out.el[i] = res.el;
+    }
+
+    return weights;
+  }
+
+  std::vector<double> push(const TruthBatch& in) {
+    std::vector<double> w_ff(in.size);
+    push(in, {w_ff.data()});
+    return w_ff;
+  }
+
+  // Look up the stored weights of 'events' at once, for the next calls of
+  // 'process' (one candidate each), which must be on the same events in the
+  // same order. Does nothing without a weight store.
+  void lookup(const std::vector<TruthEvent>& events) {
+    _lookup_keys.clear();
+    _next_lookup = 0;
+    if (!_store) return;
+
+    for (const auto& evt : events)
+      _lookup_keys.push_back(weight_store::key(evt, fix_b_id(evt), _scheme));
+    _store->find(_lookup_keys, _lookup_values, _lookup_found);
+  }
+
+  // Add the new weights to the weight store file, if any; returns how many
+  // were not in it yet
+  uint64_t flush_store() { return _store ? _store->flush() : 0; }
+
+  // Counters since the last call, e.g. per input tree
+  ReweightStats take_stats() {
+    auto result = _stats;
+    _stats      = {};
+    return result;
+  }
+
+  const ReweightStats&   stats() const { return _stats; }
+  truth_topology::Stats& topology() { return _topo; }
+  WeightCache&           cache() { return _cache; }
+  Hammer::Hammer&        hammer() { return _ham; }
+  weight_store::Store*   store() { return _store.get(); }
+
+ private:
+  // Candidates waiting for 'processEvent' in shared-event mode
+  struct Pending {
+    size_t                 cand;
+    size_t                 proc_id;
+    bool                   new_key;
+    EventKey               key;
+    truth_topology::Result topo;
+    weight_store::Key      store_key;
+    bool                   ran;  // not a duplicate of another candidate
+  };
+
+  static constexpr size_t none = size_t(-1);
+
+  Hammer::Hammer        _ham;
+  double                _topo_tol;
+  WeightCache           _cache;
+  ReweightStats         _stats;
+  truth_topology::Stats _topo;
+
+  std::unique_ptr<weight_store::Store> _store;
+  weight_store::Hasher                 _scheme;
+
+  // Results of the last 'lookup', and the next one to use
+  std::vector<weight_store::Key>   _lookup_keys;
+  std::vector<weight_store::Value> _lookup_values;
+  std::vector<bool>                _lookup_found;
+  size_t                           _next_lookup = 0;
+
+  // Reused across events; forked workers each have their own copy
+  std::vector<Hammer::Particle> _parts;
+  std::vector<Pending>          _pending;
+  std::vector<TruthEvent>       _batch;
+
+  // Stored weight of 'evt', from the last 'lookup' if 'looked_up' isn't
+  // 'none'; 'key' is set either way, to store the weight of a miss
+  bool find_stored(const TruthEvent& evt, int b_id_fix, size_t looked_up,
+                   weight_store::Key& key, weight_store::Value& value) {
+    auto found = false;
+    if (looked_up != none) {
+      key   = _lookup_keys[looked_up];
+      value = _lookup_values[looked_up];
+      found = _lookup_found[looked_up];
+    } else {
+      key   = weight_store::key(evt, b_id_fix, _scheme);
+      found = _store->find(key, value);
+    }
+
+    _stats.store_looks++;
+    if (found) _stats.store_hits++;
+    return found;
+  }
+
+  void store(const weight_store::Key& key, const EventResult& res) {
+    _store->insert(key, {res.w_ff, res.ok});
+    _stats.store_new++;
+  }
+
+  static double seconds_since(std::chrono::steady_clock::time_point start) {
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+  }
+
+  static void check_weight(double w_ff, uint64_t eventNumber) {
+    if (w_ff > 10)
+      std::cout << "Problematic weight of " << w_ff << " at " << eventNumber
+                << std::endl;
+  }
+};
+
+#endif
@@ -0,0 +1,159 @@
+// Author: Yipeng Sun
+// License: GPLv2
+// Description: Single-producer, single-consumer ring buffer in anonymous shared
+//              memory, for streaming fixed-size records from forked workers
+//              back to their parent.
+// Last Change: Sun Oct 18, 2026 at 08:51 AM +0200
+
+#ifndef _RDX_SHM_RING_H_
+#define _RDX_SHM_RING_H_
+
+#include <sched.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+namespace shm {
+
+// Zero-initialized array that stays shared with forked children
+template <class T>
+T* alloc(size_t n) {
+  static_assert(std::is_trivially_copyable<T>::value,
+                "Shared memory only holds trivially copyable types");
+
+  auto addr = mmap(nullptr, n * sizeof(T), PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (addr == MAP_FAILED)
+    throw std::runtime_error("Can't map " + std::to_string(n * sizeof(T)) +
+                             " bytes of shared memory");
+  return static_cast<T*>(addr);
+}
+
+template <class T>
+void free(T* ptr, size_t n) {
+  if (ptr) munmap(ptr, n * sizeof(T));
+}
+
+// NOTE: The ring must be created before fork() by the process that pops from
+//       it; only one process may push and only one may pop.
+template <class T>
+class SpscRing {
+  static_assert(std::is_trivially_copyable<T>::value,
+                "Ring records must be trivially copyable");
+  static_assert(std::atomic<uint64_t>::is_always_lock_free,
+                "Ring indices must be lock-free to work across processes");
+
+  struct Header {
+    alignas(64) std::atomic<uint64_t> head;  // next slot to pop
+    alignas(64) std::atomic<uint64_t> tail;  // next slot to push
+    alignas(64) std::atomic<bool> closed;
+  };
+
+ public:
+  SpscRing(uint64_t capacity)
+      : _capacity(capacity), _size(0), _data(nullptr), _consumer(getpid()) {
+    _size     = sizeof(Header) + capacity * sizeof(T);
+    auto addr = mmap(nullptr, _size, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (addr == MAP_FAILED)
+      throw std::runtime_error("Can't map shared memory for a ring buffer");
+
+    _data   = static_cast<char*>(addr);
+    _header = new (_data) Header{};
+    _slots  = reinterpret_cast<T*>(_data + sizeof(Header));
+  }
+
+  ~SpscRing() {
+    if (_data) munmap(_data, _size);
+  }
+
+  SpscRing(const SpscRing&) = delete;
+  SpscRing& operator=(const SpscRing&) = delete;
+
+  // Producer side; spins while the ring is full, and throws once the consumer
+  // is gone, so that an orphaned producer doesn't spin forever
+  void push(const T& rec) {
+    auto tail = _header->tail.load(std::memory_order_relaxed);
+    while (tail - _header->head.load(std::memory_order_acquire) >= _capacity) {
+      if (getppid() != _consumer)
+        throw std::runtime_error("Ring buffer consumer is gone");
+      sched_yield();
+    }
+
+    _slots[tail % _capacity] = rec;
+    _header->tail.store(tail + 1, std::memory_order_release);
+  }
+
+  void close() { _header->closed.store(true, std::memory_order_release); }
+
+  // Consumer side; returns false if the ring is currently empty
+  bool try_pop(T& rec) {
+    auto head = _header->head.load(std::memory_order_relaxed);
+    if (head == _header->tail.load(std::memory_order_acquire)) return false;
+
+    rec = _slots[head % _capacity];
+    _header->head.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Records waiting; only a snapshot while the producer is running
+  uint64_t size() const {
+    return _header->tail.load(std::memory_order_acquire) -
+           _header->head.load(std::memory_order_relaxed);
+  }
+
+  bool closed() const {
+    return _header->closed.load(std::memory_order_acquire);
+  }
+
+ private:
+  uint64_t _capacity;
+  uint64_t _size;
+  char*    _data;
+  pid_t    _consumer;
+  Header*  _header;
+  T*       _slots;
+};
+
+//////////////////
+// Memory usage //
+//////////////////
+
+struct MemUsage {
+  int64_t rss_kb      = 0;
+  int64_t pss_kb      = 0;
+  int64_t peak_rss_kb = 0;
+};
+
+// PSS splits copy-on-write pages evenly among the processes sharing them, so
+// the PSS of a parent and its forked children adds up to the real footprint.
+inline MemUsage mem_usage() {
+  MemUsage      usage{};
+  std::ifstream rollup("/proc/self/smaps_rollup");
+  std::string   line;
+
+  while (std::getline(rollup, line)) {
+    if (line.compare(0, 4, "Rss:") == 0)
+      usage.rss_kb = std::stoll(line.substr(4));
+    else if (line.compare(0, 4, "Pss:") == 0)
+      usage.pss_kb = std::stoll(line.substr(4));
+  }
+
+  std::ifstream status("/proc/self/status");
+  while (std::getline(status, line))
+    if (line.compare(0, 6, "VmHWM:") == 0)
+      usage.peak_rss_kb = std::stoll(line.substr(6));
+
+  return usage;
+}
+
+}  // namespace shm
+
+#endif
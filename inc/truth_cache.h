@@ -0,0 +1,370 @@
+// Author: Yipeng Sun
+// License: GPLv2
+// Description: Dense, column-oriented, memory-mappable cache of truth
+//              kinematics, so that repeated reweighting jobs don't go through
+//              ROOT decompression.
+// Last Change: Sun Oct 18, 2026 at 09:46 AM +0200
+//
+// File layout (all integers little-endian, as written by the host):
+//   FileHeader
+//   ColumnHeader x num_columns
+//   column data, each column is num_events values of its type, and starts at a
+//   64-byte aligned offset
+//
+// Momentum columns may be stored as float32 to halve the size; IDs and event
+// keys are always stored with their ROOT types.
+
+#ifndef _RDX_TRUTH_CACHE_H_
+#define _RDX_TRUTH_CACHE_H_
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+///////////////////////////////////////////////////
+// Truth particles of B0 -> D* Tau Nu, Tau -> Mu //
+///////////////////////////////////////////////////
+
+enum TruthPart {
+  B0 = 0,
+  Dst,
+  D0,
+  K,
+  Pi,
+  SlowPi,
+  Mu,
+  Tau,
+  AntiNuTau,
+  NuTau,
+  AntiNuMu,
+  NumOfTruthPart
+};
+
+// Branch prefixes in the step 1 ntuples, in the order of 'TruthPart'
+const std::vector<std::string> truth_part_prefixes{
+    "b",  "dst", "d0",      "k",      "pi",    "spi",
+    "mu", "tau", "anu_tau", "nu_tau", "anu_mu"};
+
+// All truth info needed to reweight a single candidate
+struct TruthEvent {
+  uint32_t runNumber;
+  uint64_t eventNumber;
+  int32_t  id[NumOfTruthPart];
+  double   pe[NumOfTruthPart];
+  double   px[NumOfTruthPart];
+  double   py[NumOfTruthPart];
+  double   pz[NumOfTruthPart];
+};
+
+//////////////////////////
+// On-disk cache format //
+//////////////////////////
+
+namespace truth_cache {
+
+constexpr char     magic[8]  = {'R', 'D', 'X', 'T', 'R', 'U', 'T', 'H'};
+constexpr uint32_t version   = 1;
+constexpr uint64_t alignment = 64;
+
+enum ColType : uint32_t { F32 = 0, F64 = 1, I32 = 2, U32 = 3, U64 = 4 };
+
+inline uint64_t col_type_size(uint32_t type) {
+  switch (type) {
+    case F32:
+    case I32:
+    case U32:
+      return 4;
+    case F64:
+    case U64:
+      return 8;
+  }
+  throw std::runtime_error("Unknown truth cache column type " +
+                           std::to_string(type));
+}
+
+struct FileHeader {
+  char     magic[8];
+  uint32_t version;
+  uint32_t num_columns;
+  uint64_t num_events;
+  char     tree[64];  // name of the tree the cache is built from
+};
+
+struct ColumnHeader {
+  char     name[48];
+  uint32_t type;
+  uint32_t reserved;
+  uint64_t offset;  // from the beginning of the file
+};
+
+using Schema = std::vector<std::pair<std::string, uint32_t>>;
+
+// Columns needed for reweighting, named after the corresponding branches
+inline Schema default_schema(bool f32_momenta = false) {
+  Schema schema{{"runNumber", U32}, {"eventNumber", U64}};
+  auto   mom_type = f32_momenta ? F32 : F64;
+
+  for (const auto& prefix : truth_part_prefixes) {
+    schema.emplace_back(prefix + "_id", I32);
+    for (const auto& comp : {"pe", "px", "py", "pz"})
+      schema.emplace_back(prefix + "_true_" + comp, mom_type);
+  }
+
+  return schema;
+}
+
+inline bool is_truth_cache(const std::string& path) {
+  char buf[sizeof(magic)] = {};
+  auto fd                 = open(path.c_str(), O_RDONLY);
+  if (fd < 0) return false;
+
+  auto nbytes = read(fd, buf, sizeof(buf));
+  close(fd);
+
+  return nbytes == sizeof(buf) && memcmp(buf, magic, sizeof(magic)) == 0;
+}
+
+/////////////////
+// Cache maker //
+/////////////////
+
+// The file is sized up front and mmap'ed, so that each column can be filled
+// in place, in any order.
+class Writer {
+ public:
+  Writer(const std::string& path, const std::string& tree,
+         uint64_t num_events, const Schema& schema)
+      : _size(0), _data(nullptr) {
+    auto offset = sizeof(FileHeader) + schema.size() * sizeof(ColumnHeader);
+
+    std::vector<ColumnHeader> cols(schema.size());
+    for (auto i = 0ul; i < schema.size(); i++) {
+      memset(&cols[i], 0, sizeof(ColumnHeader));
+      strncpy(cols[i].name, schema[i].first.c_str(), sizeof(cols[i].name) - 1);
+      cols[i].type   = schema[i].second;
+      offset         = (offset + alignment - 1) / alignment * alignment;
+      cols[i].offset = offset;
+      offset += num_events * col_type_size(schema[i].second);
+    }
+    _size = offset;
+
+    auto fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) throw std::runtime_error("Can't create " + path);
+    if (ftruncate(fd, _size) != 0) {
+      close(fd);
+      throw std::runtime_error("Can't allocate " + path);
+    }
+
+    auto addr = mmap(nullptr, _size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) throw std::runtime_error("Can't map " + path);
+    _data = static_cast<char*>(addr);
+
+    FileHeader hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, magic, sizeof(magic));
+    hdr.version     = version;
+    hdr.num_columns = schema.size();
+    hdr.num_events  = num_events;
+    strncpy(hdr.tree, tree.c_str(), sizeof(hdr.tree) - 1);
+
+    memcpy(_data, &hdr, sizeof(hdr));
+    memcpy(_data + sizeof(hdr), cols.data(),
+           cols.size() * sizeof(ColumnHeader));
+
+    for (const auto& col : cols) _offsets[col.name] = col.offset;
+  }
+
+  ~Writer() {
+    if (_data) munmap(_data, _size);
+  }
+
+  Writer(const Writer&) = delete;
+  Writer& operator=(const Writer&) = delete;
+
+  template <class T>
+  T* column(const std::string& name) {
+    auto itr = _offsets.find(name);
+    if (itr == _offsets.end())
+      throw std::runtime_error("Unknown truth cache column " + name);
+    return reinterpret_cast<T*>(_data + itr->second);
+  }
+
+ private:
+  uint64_t                        _size;
+  char*                           _data;
+  std::map<std::string, uint64_t> _offsets;
+};
+
+//////////////////
+// Cache reader //
+//////////////////
+
+// Momentum column that's either float32 or float64 on disk
+class MomColumn {
+ public:
+  MomColumn() : _f32(nullptr), _f64(nullptr) {}
+  MomColumn(const void* data, uint32_t type)
+      : _f32(type == F32 ? static_cast<const float*>(data) : nullptr),
+        _f64(type == F64 ? static_cast<const double*>(data) : nullptr) {}
+
+  double operator[](uint64_t i) const { return _f32 ? _f32[i] : _f64[i]; }
+
+ private:
+  const float*  _f32;
+  const double* _f64;
+};
+
+class Reader {
+ public:
+  Reader(const std::string& path) : _size(0), _data(nullptr) {
+    auto fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) throw std::runtime_error("Can't open " + path);
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+      close(fd);
+      throw std::runtime_error("Can't stat " + path);
+    }
+    _size = st.st_size;
+    if (_size < sizeof(FileHeader)) {
+      close(fd);
+      throw std::runtime_error(path + " is not a truth cache");
+    }
+
+    auto addr = mmap(nullptr, _size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) throw std::runtime_error("Can't map " + path);
+    _data = static_cast<const char*>(addr);
+    madvise(addr, _size, MADV_SEQUENTIAL);
+
+    // NOTE: '_data' is unmapped by the destructor only once constructed
+    try {
+      validate(path);
+    } catch (...) {
+      munmap(const_cast<char*>(_data), _size);
+      throw;
+    }
+
+    // Pre-resolve the columns needed to fill a 'TruthEvent'
+    _run = column<uint32_t>("runNumber");
+    _evt = column<uint64_t>("eventNumber");
+    for (auto i = 0; i < NumOfTruthPart; i++) {
+      auto prefix = truth_part_prefixes[i];
+      _id[i]      = column<int32_t>(prefix + "_id");
+      _pe[i]      = mom_column(prefix + "_true_pe");
+      _px[i]      = mom_column(prefix + "_true_px");
+      _py[i]      = mom_column(prefix + "_true_py");
+      _pz[i]      = mom_column(prefix + "_true_pz");
+    }
+  }
+
+  ~Reader() {
+    if (_data) munmap(const_cast<char*>(_data), _size);
+  }
+
+  Reader(const Reader&) = delete;
+  Reader& operator=(const Reader&) = delete;
+
+  const FileHeader& header() const {
+    return *reinterpret_cast<const FileHeader*>(_data);
+  }
+  uint64_t    num_events() const { return header().num_events; }
+  std::string tree() const {
+    return std::string(header().tree,
+                       strnlen(header().tree, sizeof(header().tree)));
+  }
+  bool has(const std::string& name) const { return _cols.count(name) > 0; }
+
+  template <class T>
+  const T* column(const std::string& name) const {
+    const auto& col = find(name);
+    if (col_type_size(col.type) != sizeof(T))
+      throw std::runtime_error("Type mismatch for truth cache column " + name);
+    return reinterpret_cast<const T*>(_data + col.offset);
+  }
+
+  MomColumn mom_column(const std::string& name) const {
+    const auto& col = find(name);
+    if (col.type != F32 && col.type != F64)
+      throw std::runtime_error("Truth cache column " + name +
+                               " is not floating point");
+    return MomColumn(_data + col.offset, col.type);
+  }
+
+  void load(uint64_t i, TruthEvent& evt) const {
+    evt.runNumber   = _run[i];
+    evt.eventNumber = _evt[i];
+    for (auto p = 0; p < NumOfTruthPart; p++) {
+      evt.id[p] = _id[p][i];
+      evt.pe[p] = _pe[p][i];
+      evt.px[p] = _px[p][i];
+      evt.py[p] = _py[p][i];
+      evt.pz[p] = _pz[p][i];
+    }
+  }
+
+ private:
+  uint64_t                            _size;
+  const char*                         _data;
+  std::map<std::string, ColumnHeader> _cols;
+
+  const uint32_t* _run;
+  const uint64_t* _evt;
+  const int32_t*  _id[NumOfTruthPart];
+  MomColumn       _pe[NumOfTruthPart];
+  MomColumn       _px[NumOfTruthPart];
+  MomColumn       _py[NumOfTruthPart];
+  MomColumn       _pz[NumOfTruthPart];
+
+  // Every size and offset is checked against the mapped file, so that a
+  // truncated or corrupt cache throws instead of being read out of bounds
+  void validate(const std::string& path) {
+    if (memcmp(header().magic, magic, sizeof(magic)) != 0)
+      throw std::runtime_error(path + " is not a truth cache");
+    if (header().version != version)
+      throw std::runtime_error(path + " has unsupported truth cache version " +
+                               std::to_string(header().version));
+
+    auto num_columns = uint64_t(header().num_columns);
+    auto num_events  = header().num_events;
+    if (num_columns > (_size - sizeof(FileHeader)) / sizeof(ColumnHeader))
+      throw std::runtime_error(path + " is truncated in the column headers");
+
+    auto cols =
+        reinterpret_cast<const ColumnHeader*>(_data + sizeof(FileHeader));
+    auto data_start = sizeof(FileHeader) + num_columns * sizeof(ColumnHeader);
+    for (auto i = 0u; i < num_columns; i++) {
+      auto col = cols[i];
+      col.name[sizeof(col.name) - 1] = '\0';
+
+      auto type_size = col_type_size(col.type);
+      if (col.offset < data_start || col.offset > _size ||
+          col.offset % type_size != 0 ||
+          num_events > (_size - col.offset) / type_size)
+        throw std::runtime_error(path + " is truncated or corrupt at column " +
+                                 col.name);
+      _cols[col.name] = col;
+    }
+  }
+
+  const ColumnHeader& find(const std::string& name) const {
+    auto itr = _cols.find(name);
+    if (itr == _cols.end())
+      throw std::runtime_error("Truth cache has no column " + name);
+    return itr->second;
+  }
+};
+
+}  // namespace truth_cache
+
+#endif
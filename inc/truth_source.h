@@ -0,0 +1,242 @@
+// Author: Yipeng Sun
+// License: GPLv2
+// Description: Sequential and random access to truth info, either from step 1
+//              ntuples or from truth caches.
+// Last Change: Sun Oct 18, 2026 at 10:11 AM +0200
+
+#ifndef _RDX_TRUTH_SOURCE_H_
+#define _RDX_TRUTH_SOURCE_H_
+
+#include <TBranch.h>
+#include <TFile.h>
+#include <TLeaf.h>
+#include <TObjArray.h>
+#include <TTree.h>
+#include <TTreeReader.h>
+#include <TTreeReaderArray.h>
+#include <TTreeReaderValue.h>
+
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "file_prefetch.h"
+#include "truth_cache.h"
+
+// Read truth info from a step 1 ntuple
+class TreeTruthSource {
+ public:
+  TreeTruthSource(const char* tree, TFile* input_file)
+      : _reader(tree, input_file),
+        _run(_reader, "runNumber"),
+        _evt(_reader, "eventNumber") {
+    for (const auto& prefix : truth_part_prefixes) {
+      auto id_br = prefix + "_id";
+      auto mom   = [&](const char* comp) {
+        auto br = prefix + "_true_" + comp;
+        return new TTreeReaderValue<Double_t>(_reader, br.c_str());
+      };
+
+      _id.emplace_back(new TTreeReaderValue<Int_t>(_reader, id_br.c_str()));
+      _pe.emplace_back(mom("pe"));
+      _px.emplace_back(mom("px"));
+      _py.emplace_back(mom("py"));
+      _pz.emplace_back(mom("pz"));
+    }
+  }
+
+  bool next(TruthEvent& evt) {
+    if (!_reader.Next()) return false;
+    copy(evt);
+    return true;
+  }
+
+  // Only read entries [first, last) with 'next'
+  void set_range(Long64_t first, Long64_t last) {
+    _reader.SetEntriesRange(first, last);
+  }
+
+  Long64_t size() { return _reader.GetTree()->GetEntries(); }
+
+  void load(Long64_t entry, TruthEvent& evt) {
+    _reader.SetEntry(entry);
+    copy(evt);
+  }
+
+ private:
+  TTreeReader                 _reader;
+  TTreeReaderValue<UInt_t>    _run;
+  TTreeReaderValue<ULong64_t> _evt;
+
+  std::vector<std::unique_ptr<TTreeReaderValue<Int_t>>>    _id;
+  std::vector<std::unique_ptr<TTreeReaderValue<Double_t>>> _pe, _px, _py, _pz;
+
+  void copy(TruthEvent& evt) {
+    evt.runNumber   = *_run;
+    evt.eventNumber = *_evt;
+    for (auto p = 0; p < NumOfTruthPart; p++) {
+      evt.id[p] = **_id[p];
+      evt.pe[p] = **_pe[p];
+      evt.px[p] = **_px[p];
+      evt.py[p] = **_py[p];
+      evt.pz[p] = **_pz[p];
+    }
+  }
+};
+
+// Read truth info from a ntuple storing several candidates per entry, with
+// each truth branch being an array over the candidates
+class ArrayTruthSource {
+ public:
+  ArrayTruthSource(const char* tree, TFile* input_file)
+      : _reader(tree, input_file),
+        _run(_reader, "runNumber"),
+        _evt(_reader, "eventNumber") {
+    for (const auto& prefix : truth_part_prefixes) {
+      auto id_br = prefix + "_id";
+      auto mom   = [&](const char* comp) {
+        auto br = prefix + "_true_" + comp;
+        return new TTreeReaderArray<Double_t>(_reader, br.c_str());
+      };
+
+      _id.emplace_back(new TTreeReaderArray<Int_t>(_reader, id_br.c_str()));
+      _pe.emplace_back(mom("pe"));
+      _px.emplace_back(mom("px"));
+      _py.emplace_back(mom("py"));
+      _pz.emplace_back(mom("pz"));
+    }
+
+    check_counts(tree, input_file);
+  }
+
+  bool next(std::vector<TruthEvent>& cands) {
+    if (!_reader.Next()) return false;
+
+    // NOTE: Arrays without a common count leaf, e.g. 'std::vector's, are only
+    //       known to match once read
+    auto size = _id[B0]->GetSize();
+    for (auto p = 0; p < NumOfTruthPart; p++)
+      if (_id[p]->GetSize() != size || _pe[p]->GetSize() != size ||
+          _px[p]->GetSize() != size || _py[p]->GetSize() != size ||
+          _pz[p]->GetSize() != size)
+        throw std::runtime_error(
+            "Truth arrays of " + truth_part_prefixes[p] +
+            " don't have one entry per candidate at entry " +
+            std::to_string(_reader.GetCurrentEntry()));
+
+    cands.resize(size);
+    for (auto i = 0ul; i < cands.size(); i++) {
+      auto& evt       = cands[i];
+      evt.runNumber   = *_run;
+      evt.eventNumber = *_evt;
+      for (auto p = 0; p < NumOfTruthPart; p++) {
+        evt.id[p] = (*_id[p])[i];
+        evt.pe[p] = (*_pe[p])[i];
+        evt.px[p] = (*_px[p])[i];
+        evt.py[p] = (*_py[p])[i];
+        evt.pz[p] = (*_pz[p])[i];
+      }
+    }
+
+    return true;
+  }
+
+  void set_range(Long64_t first, Long64_t last) {
+    _reader.SetEntriesRange(first, last);
+  }
+
+ private:
+  TTreeReader                 _reader;
+  TTreeReaderValue<UInt_t>    _run;
+  TTreeReaderValue<ULong64_t> _evt;
+
+  std::vector<std::unique_ptr<TTreeReaderArray<Int_t>>>    _id;
+  std::vector<std::unique_ptr<TTreeReaderArray<Double_t>>> _pe, _px, _py, _pz;
+
+  // All truth arrays must exist and be sized by the same count leaf as
+  // 'b_id', so that no candidate is read past the end of an array
+  static void check_counts(const char* tree, TFile* input_file) {
+    auto input = input_file->Get<TTree>(tree);
+    if (!input) throw std::runtime_error(std::string("No tree ") + tree);
+
+    auto count = [&](const std::string& name) {
+      auto br = input->GetBranch(name.c_str());
+      if (!br) throw std::runtime_error("No truth array " + name);
+      auto leaf  = static_cast<TLeaf*>(br->GetListOfLeaves()->At(0));
+      auto count = leaf ? leaf->GetLeafCount() : nullptr;
+      return count ? std::string(count->GetName()) : std::string();
+    };
+
+    auto ref = count(truth_part_prefixes[B0] + "_id");
+    for (const auto& prefix : truth_part_prefixes) {
+      std::vector<std::string> names{prefix + "_id"};
+      for (const auto& comp : {"pe", "px", "py", "pz"})
+        names.push_back(prefix + "_true_" + comp);
+
+      for (const auto& name : names)
+        if (count(name) != ref)
+          throw std::runtime_error("Truth array " + name + " is not sized by " +
+                                   (ref.empty() ? "the same count" : ref) +
+                                   " as " + truth_part_prefixes[B0] + "_id");
+    }
+  }
+};
+
+// Read the same tree from a list of files as one stream, with 'Source' being
+// 'TreeTruthSource' or 'ArrayTruthSource'. Files are opened when the previous
+// one is exhausted, and closed right after.
+template <class Source>
+class MultiFileSource {
+ public:
+  MultiFileSource(const char* tree, prefetch::FilePrefetcher& files)
+      : _tree(tree), _files(files), _next_file(0) {}
+
+  template <class T>
+  bool next(T& evt) {
+    while (!_source || !_source->next(evt)) {
+      if (_next_file >= _files.size()) return false;
+
+      _source.reset();
+      _file.reset(_files.open(_next_file++));
+      _source.reset(new Source(_tree.c_str(), _file.get()));
+    }
+    return true;
+  }
+
+ private:
+  std::string               _tree;
+  prefetch::FilePrefetcher& _files;
+  size_t                    _next_file;
+  std::unique_ptr<TFile>    _file;
+  std::unique_ptr<Source>   _source;  // destroyed before '_file'
+};
+
+// Read truth info from a truth cache made by build_truth_cache.u
+class CacheTruthSource {
+ public:
+  CacheTruthSource(const truth_cache::Reader& cache)
+      : _cache(cache), _next(0), _last(cache.num_events()) {}
+
+  bool next(TruthEvent& evt) {
+    if (_next >= _last) return false;
+    _cache.load(_next++, evt);
+    return true;
+  }
+
+  void set_range(Long64_t first, Long64_t last) {
+    _next = first;
+    _last = last;
+  }
+
+  Long64_t size() { return _cache.num_events(); }
+
+  void load(Long64_t entry, TruthEvent& evt) { _cache.load(entry, evt); }
+
+ private:
+  const truth_cache::Reader& _cache;
+  uint64_t                   _next, _last;
+};
+
+#endif
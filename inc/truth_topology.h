@@ -0,0 +1,206 @@
+// Author: Yipeng Sun
+// License: GPLv2
+// Description: Cheap validation of the truth decay tree of B0 -> D* Tau Nu,
+//              Tau -> Mu Nu Nu, before any HAMMER object is built.
+// Last Change: Sat Oct 17, 2026 at 07:31 PM +0200
+
+#ifndef _RDX_TRUTH_TOPOLOGY_H_
+#define _RDX_TRUTH_TOPOLOGY_H_
+
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "truth_cache.h"
+
+namespace truth_topology {
+
+enum Category {
+  Ok = 0,
+  MismatchedDaughter,  // unexpected |PDG ID|
+  WrongSign,           // charges inconsistent with the parent
+  MissingFsr,          // momentum deficit consistent with an unstored photon
+  MomNotConserved,     // any other four-momentum imbalance
+  NumOfCategories
+};
+
+const std::vector<std::string> category_names{
+    "ok", "mismatched daughter", "wrong sign", "missing photon FSR",
+    "momentum not conserved"};
+
+struct Vertex {
+  TruthPart              parent;
+  std::vector<TruthPart> daughters;
+  // HAMMER matches this vertex to its amplitudes, so a wrong ID or sign here
+  // means HAMMER will reject the process anyway
+  bool hammer;
+};
+
+constexpr int NumOfVertices = 4;
+
+// Same as what's passed to HAMMER in rdx-run1-sample.cpp
+const std::array<Vertex, NumOfVertices> decay_tree{
+    {{B0, {Dst, Tau, AntiNuTau}, true},
+     {Tau, {Mu, NuTau, AntiNuMu}, true},
+     {Dst, {D0, SlowPi}, true},
+     {D0, {K, Pi}, false}}};
+
+// Allowed |PDG ID|; TauEllNuNu covers both electrons and muons
+const std::vector<std::vector<int>> allowed_ids{
+    {511},      // B0
+    {413},      // D*
+    {421},      // D0
+    {321},      // K
+    {211},      // Pi
+    {211},      // SlowPi
+    {11, 13},   // Mu
+    {15},       // Tau
+    {16},       // AntiNuTau
+    {16},       // NuTau
+    {12, 14}};  // AntiNuMu
+
+// Sign of the PDG ID relative to the parent's, e.g. B0 -> D*- Tau+ Nu_Tau
+const std::vector<int> rel_sign{
+    0,    // B0
+    -1,   // D*
+    +1,   // D0
+    -1,   // K
+    +1,   // Pi
+    +1,   // SlowPi
+    +1,   // Mu
+    -1,   // Tau
+    +1,   // AntiNuTau
+    +1,   // NuTau
+    -1};  // AntiNuMu
+
+struct Result {
+  Category cat    = Ok;
+  int      vertex = -1;  // index in 'decay_tree'
+  bool     veto   = false;
+};
+
+inline bool id_allowed(TruthPart p, int id) {
+  for (auto allowed : allowed_ids[p])
+    if (std::abs(id) == allowed) return true;
+  return false;
+}
+
+inline int sign(int id) { return id > 0 ? 1 : -1; }
+
+// 'b_id' is the B ID after the 'wrong-sign' fix for oscillated B0's; 'tol' is
+// in the same unit as the four-momenta.
+inline Result check(const TruthEvent& evt, int b_id, double tol = 1.) {
+  auto id = [&](TruthPart p) { return p == B0 ? b_id : evt.id[p]; };
+
+  // IDs and charges first, as they decide if HAMMER can match the process
+  for (auto v = 0ul; v < decay_tree.size(); v++) {
+    const auto& vtx = decay_tree[v];
+    for (auto d : vtx.daughters)
+      if (!id_allowed(d, id(d)))
+        return Result{MismatchedDaughter, int(v), vtx.hammer};
+  }
+
+  for (auto v = 0ul; v < decay_tree.size(); v++) {
+    const auto& vtx = decay_tree[v];
+    for (auto d : vtx.daughters)
+      if (sign(id(d)) != rel_sign[d] * sign(id(vtx.parent)))
+        return Result{WrongSign, int(v), vtx.hammer};
+  }
+
+  // Four-momentum conservation at each vertex
+  for (auto v = 0ul; v < decay_tree.size(); v++) {
+    const auto& vtx = decay_tree[v];
+
+    auto de = evt.pe[vtx.parent];
+    auto dx = evt.px[vtx.parent];
+    auto dy = evt.py[vtx.parent];
+    auto dz = evt.pz[vtx.parent];
+    for (auto d : vtx.daughters) {
+      de -= evt.pe[d];
+      dx -= evt.px[d];
+      dy -= evt.py[d];
+      dz -= evt.pz[d];
+    }
+
+    if (std::fabs(de) <= tol && std::fabs(dx) <= tol && std::fabs(dy) <= tol &&
+        std::fabs(dz) <= tol)
+      continue;
+
+    // A radiated photon carries away a massless four-momentum
+    auto m2 = de * de - dx * dx - dy * dy - dz * dz;
+    if (de > 0 && std::fabs(m2) <= 2 * tol * de + tol * tol)
+      return Result{MissingFsr, int(v), false};
+    return Result{MomNotConserved, int(v), false};
+  }
+
+  return Result{};
+}
+
+// Counters per category and vertex.
+// NOTE: Plain arrays only, so that it can be copied through shared memory
+class Stats {
+ public:
+  void add(const Result& res) {
+    _total++;
+    if (res.cat != Ok) _counts[res.cat][res.vertex]++;
+    if (res.veto) _vetoed++;
+  }
+
+  // Record the pre-check category of an event HAMMER didn't accept
+  void add_hammer_rejection(const Result& res) { _hammer_rej[res.cat]++; }
+
+  Stats& operator+=(const Stats& rhs) {
+    for (auto c = 0; c < NumOfCategories; c++) {
+      for (auto v = 0; v < NumOfVertices; v++)
+        _counts[c][v] += rhs._counts[c][v];
+      _hammer_rej[c] += rhs._hammer_rej[c];
+    }
+    _total += rhs._total;
+    _vetoed += rhs._vetoed;
+    return *this;
+  }
+
+  bool has_failures() const {
+    for (auto c = 0; c < NumOfCategories; c++)
+      if (_hammer_rej[c] > 0) return true;
+    for (auto c = 1; c < NumOfCategories; c++)
+      for (auto v = 0; v < NumOfVertices; v++)
+        if (_counts[c][v] > 0) return true;
+    return false;
+  }
+
+  void print(std::ostream& os = std::cout) const {
+    os << "Truth topology pre-check of " << _total << " entries, " << _vetoed
+       << " skipped before HAMMER:" << std::endl;
+
+    os << std::left << std::setw(24) << "category" << std::right;
+    for (const auto& vtx : decay_tree)
+      os << std::setw(12) << truth_part_prefixes[vtx.parent] + " vertex";
+    os << std::setw(18) << "HAMMER rejected" << std::endl;
+
+    for (auto c = 1; c < NumOfCategories; c++) {
+      os << std::left << std::setw(24) << category_names[c] << std::right;
+      for (auto n : _counts[c]) os << std::setw(12) << n;
+      os << std::setw(18) << _hammer_rej[c] << std::endl;
+    }
+
+    if (_hammer_rej[Ok] > 0)
+      os << "WARNING: HAMMER rejected " << _hammer_rej[Ok]
+         << " entries that passed the pre-check." << std::endl;
+  }
+
+ private:
+  int64_t _counts[NumOfCategories][NumOfVertices] = {};
+  int64_t _hammer_rej[NumOfCategories]             = {};
+  int64_t _total                                   = 0;
+  int64_t _vetoed                                  = 0;
+};
+
+}  // namespace truth_topology
+
+#endif
@@ -0,0 +1,152 @@
+// Author: Yipeng Sun
+// License: GPLv2
+// Description: Unweighting of a weighted sample into a smaller sample of
+//              equal-weight events, and the statistical cost of doing so.
+// Last Change: Sun Oct 18, 2026 at 08:42 AM +0200
+//
+// Both methods return the number of copies of each entry in the output:
+//   accept_reject: keep entry i with probability min(1, w_i / w_max), at most
+//                  once. Entries above 'w_max' are kept with probability 1,
+//                  which biases the output by their excess weight.
+//   systematic:    'n' equally spaced points with one random offset over the
+//                  cumulative weights; entry i gets about n * w_i / sum_w
+//                  copies, without bias, but heavy entries are repeated.
+// Either way, every output event stands for sum_w / (number of copies) of the
+// original weight. Negative (invalid) weights count as 0.
+
+#ifndef _RDX_UNWEIGHT_H_
+#define _RDX_UNWEIGHT_H_
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+namespace unweight {
+
+struct Summary {
+  int64_t entries    = 0;
+  int64_t weighted   = 0;  // entries with a positive weight
+  int64_t kept       = 0;  // output events, counting copies
+  int64_t unique     = 0;  // entries with at least one copy
+  int64_t over_max   = 0;  // entries above 'w_max'
+  double  sum_w      = 0;
+  double  sum_w2     = 0;
+  double  w_max      = 0;
+  double  excess_w   = 0;  // sum of w - w_max over entries above it
+  double  sum_copies = 0;  // sum of squared copies
+
+  // Effective number of entries before and after the reduction
+  double n_eff() const { return sum_w2 > 0 ? sum_w * sum_w / sum_w2 : 0; }
+  double n_eff_out() const {
+    return sum_copies > 0 ? double(kept) * kept / sum_copies : 0;
+  }
+
+  double efficiency() const {
+    return weighted > 0 ? double(kept) / weighted : 0;
+  }
+  // Weight of each output event, so that the output keeps the normalization
+  double unit_weight() const { return kept > 0 ? sum_w / kept : 0; }
+  // Relative statistical error of the output over that of the input
+  double error_inflation() const {
+    return n_eff_out() > 0 ? std::sqrt(n_eff() / n_eff_out()) : 0;
+  }
+  // Fraction of the total weight lost by capping at 'w_max'
+  double bias() const { return sum_w > 0 ? excess_w / sum_w : 0; }
+};
+
+// Effective number of entries of the weights alone, e.g. the default number
+// of events of 'systematic'
+inline double n_eff(const std::vector<double>& w) {
+  double sum_w = 0, sum_w2 = 0;
+  for (auto x : w)
+    if (x > 0) {
+      sum_w += x;
+      sum_w2 += x * x;
+    }
+  return sum_w2 > 0 ? sum_w * sum_w / sum_w2 : 0;
+}
+
+// Weight below which a fraction 'quantile' of the positive weights are; 1 is
+// the largest weight
+inline double max_weight(const std::vector<double>& w, double quantile = 1) {
+  std::vector<double> pos{};
+  for (auto x : w)
+    if (x > 0) pos.push_back(x);
+  if (pos.empty()) return 0;
+
+  auto idx = size_t(std::ceil(std::clamp(quantile, 0., 1.) * pos.size()));
+  idx      = std::min(std::max(idx, size_t(1)), pos.size()) - 1;
+  std::nth_element(pos.begin(), pos.begin() + idx, pos.end());
+  return pos[idx];
+}
+
+inline std::vector<uint32_t> accept_reject(const std::vector<double>& w,
+                                           double w_max, std::mt19937_64& rng) {
+  std::uniform_real_distribution<double> uniform(0., w_max);
+  std::vector<uint32_t>                  copies(w.size(), 0);
+
+  // NOTE: One number is drawn per entry, so that the output only depends on
+  //       the seed, not on which entries happen to be accepted
+  for (size_t i = 0; i < w.size(); i++) {
+    auto u = uniform(rng);
+    if (w[i] > 0 && u < w[i]) copies[i] = 1;
+  }
+
+  return copies;
+}
+
+inline std::vector<uint32_t> systematic(const std::vector<double>& w,
+                                        int64_t n, std::mt19937_64& rng) {
+  std::vector<uint32_t> copies(w.size(), 0);
+
+  double sum_w = 0;
+  for (auto x : w)
+    if (x > 0) sum_w += x;
+  if (sum_w <= 0 || n <= 0) return copies;
+
+  auto    step   = sum_w / n;
+  auto    offset = std::uniform_real_distribution<double>(0., step)(rng);
+  double  cum    = 0;
+  int64_t drawn  = 0;
+
+  for (size_t i = 0; i < w.size() && drawn < n; i++) {
+    if (w[i] <= 0) continue;
+    cum += w[i];
+    for (; drawn < n && offset + step * drawn < cum; drawn++) copies[i]++;
+  }
+
+  return copies;
+}
+
+// NOTE: Entries past the end of 'copies' count as not kept
+inline Summary summarize(const std::vector<double>&   w,
+                         const std::vector<uint32_t>& copies, double w_max) {
+  Summary s{};
+  s.entries = w.size();
+  s.w_max   = w_max;
+
+  for (size_t i = 0; i < w.size(); i++) {
+    if (w[i] > 0) {
+      s.weighted++;
+      s.sum_w += w[i];
+      s.sum_w2 += w[i] * w[i];
+      if (w_max > 0 && w[i] > w_max) {
+        s.over_max++;
+        s.excess_w += w[i] - w_max;
+      }
+    }
+
+    if (i >= copies.size()) continue;
+    s.kept += copies[i];
+    s.sum_copies += double(copies[i]) * copies[i];
+    if (copies[i] > 0) s.unique++;
+  }
+
+  return s;
+}
+
+}  // namespace unweight
+
+#endif
@@ -0,0 +1,363 @@
+// Author: Yipeng Sun
+// License: GPLv2
+// Description: Persistent, memory-mapped store of FF weights keyed by the
+//              truth kinematics, shared by all reweighting runs.
+// Last Change: Sun Oct 18, 2026 at 09:53 AM +0200
+//
+// The same generator-level decays show up in several productions (different
+// reco simulations, filterings), with different run and event numbers. The
+// store keys each weight by a 128-bit hash of the HAMMER scheme (see
+// 'hammer_scheme'), the IDs (after the 'wrong-sign' B fix) and the four-
+// momenta rounded to 1 keV, so that any later run can skip HAMMER for them.
+//
+// File layout (all integers little-endian, as written by the host):
+//   FileHeader, padded to 64 bytes
+//   Slot x capacity, an open-addressing hash table with linear probing; the
+//   capacity is a power of 2, and at most half of the slots are used
+//
+// Lookups only read the mapped file. New weights are kept in memory, and
+// 'flush' merges them into the latest version of the file under an exclusive
+// 'flock' on '<path>.lock', then atomically replaces it. Concurrent runs
+// (forked workers, MPI ranks, other productions) can thus share one store, as
+// long as the file system supports 'flock'.
+
+#ifndef _RDX_WEIGHT_STORE_H_
+#define _RDX_WEIGHT_STORE_H_
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "truth_cache.h"
+
+namespace weight_store {
+
+constexpr char     magic[8]     = {'R', 'D', 'X', 'W', 'S', 'T', 'O', 'R'};
+constexpr uint32_t version      = 1;
+constexpr uint64_t slots_offset = 64;
+constexpr uint64_t min_capacity = 1 << 16;
+constexpr double   mom_unit     = 1e-3;  // MeV, resolution of the key
+
+struct FileHeader {
+  char     magic[8];
+  uint32_t version;
+  uint32_t reserved;
+  uint64_t capacity;
+  uint64_t size;  // used slots
+};
+
+/////////
+// Key //
+/////////
+
+struct Key {
+  uint64_t lo, hi;
+
+  bool operator==(const Key& rhs) const { return lo == rhs.lo && hi == rhs.hi; }
+};
+
+// Finalizer of splitmix64
+inline uint64_t mix(uint64_t x) {
+  x ^= x >> 30;
+  x *= 0xbf58476d1ce4e5b9ull;
+  x ^= x >> 27;
+  x *= 0x94d049bb133111ebull;
+  x ^= x >> 31;
+  return x;
+}
+
+// Two independently seeded lanes, for 128 bits
+class Hasher {
+ public:
+  Hasher(uint64_t seed = 0)
+      : _lo(mix(seed ^ 0x243f6a8885a308d3ull)),
+        _hi(mix(seed ^ 0x13198a2e03707344ull)) {}
+
+  void add(uint64_t word) {
+    _lo = mix(_lo ^ word) + 0x9e3779b97f4a7c15ull;
+    _hi = mix(_hi + (word ^ 0xa4093822299f31d0ull)) ^ (_hi >> 17);
+  }
+
+  void add(const std::string& str) {
+    for (unsigned char c : str) add(c);
+    add(str.size());
+  }
+
+  Key key() const { return {mix(_lo ^ _hi), mix(_hi + _lo)}; }
+
+ private:
+  uint64_t _lo, _hi;
+};
+
+// 'scheme' identifies the HAMMER settings, e.g. 'Hasher(hammer_scheme())'
+// NOTE: Run and event numbers are left out on purpose, as they differ between
+//       productions of the same generator-level events.
+inline Key key(const TruthEvent& evt, int b_id, const Hasher& scheme) {
+  auto h = scheme;
+  for (auto p = 0; p < NumOfTruthPart; p++) {
+    h.add(uint64_t(int64_t(p == B0 ? b_id : evt.id[p])));
+    for (auto mom : {evt.pe[p], evt.px[p], evt.py[p], evt.pz[p]})
+      h.add(uint64_t(std::llround(mom / mom_unit)));
+  }
+  return h.key();
+}
+
+struct Value {
+  double w_ff;
+  bool   ok;  // HAMMER accepted the process
+};
+
+struct Slot {
+  Key      key;
+  double   w_ff;
+  uint32_t flags;  // 0: empty
+  uint32_t reserved;
+};
+
+enum SlotFlags : uint32_t { Used = 1, Ok = 2 };
+
+///////////
+// Store //
+///////////
+
+class Store {
+ public:
+  // A missing or 0-byte file is an empty store, written by the first 'flush'
+  explicit Store(std::string path) : _path(std::move(path)) { map(); }
+
+  ~Store() { unmap(); }
+
+  Store(const Store&) = delete;
+  Store& operator=(const Store&) = delete;
+
+  bool find(const Key& key, Value& value) const {
+    if (_capacity == 0) return false;
+
+    for (auto i = home(key);; i = (i + 1) & (_capacity - 1)) {
+      const auto& slot = _slots[i];
+      if (slot.flags == 0) return false;
+      if (slot.key == key) {
+        value = {slot.w_ff, (slot.flags & Ok) != 0};
+        return true;
+      }
+    }
+  }
+
+  // Look up all 'keys' at once. The pages of all home slots are requested
+  // from the kernel first, in file order, so that reading them from disk
+  // overlaps instead of faulting them in one at a time.
+  void find(const std::vector<Key>& keys, std::vector<Value>& values,
+            std::vector<bool>& found) const {
+    values.resize(keys.size());
+    found.assign(keys.size(), false);
+    if (_capacity == 0) return;
+
+    auto page = uint64_t(sysconf(_SC_PAGESIZE));
+    _pages.clear();
+    for (const auto& key : keys)
+      _pages.push_back((slots_offset + home(key) * sizeof(Slot)) / page);
+    std::sort(_pages.begin(), _pages.end());
+
+    for (size_t i = 0; i < _pages.size();) {
+      auto j = i + 1;
+      while (j < _pages.size() && _pages[j] <= _pages[j - 1] + 1) j++;
+      madvise(_data + _pages[i] * page, (_pages[j - 1] - _pages[i] + 1) * page,
+              MADV_WILLNEED);
+      i = j;
+    }
+
+    for (size_t i = 0; i < keys.size(); i++)
+      found[i] = find(keys[i], values[i]);
+  }
+
+  // Kept in memory until 'flush'
+  void insert(const Key& key, const Value& value) {
+    _pending.push_back({key, value.w_ff, Used | (value.ok ? Ok : 0u), 0});
+  }
+
+  // Merge the new weights into the file; returns how many were not in it.
+  // Also picks up the weights added by other processes since the file was
+  // mapped.
+  uint64_t flush() {
+    if (_pending.empty()) {
+      unmap();
+      map();
+      return 0;
+    }
+
+    auto lock_path = _path + ".lock";
+    auto lock      = open(lock_path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (lock < 0) throw std::runtime_error("Can't create " + lock_path);
+    int locked;
+    while ((locked = flock(lock, LOCK_EX)) != 0 && errno == EINTR) {
+    }
+    if (locked != 0) {
+      close(lock);
+      throw std::runtime_error("Can't lock " + lock_path + ": " +
+                               strerror(errno));
+    }
+
+    uint64_t added = 0;
+    try {
+      // Another process may have replaced the file since it was mapped
+      unmap();
+      map();
+      added = rewrite();
+      unmap();
+      map();
+    } catch (...) {
+      flock(lock, LOCK_UN);
+      close(lock);
+      throw;
+    }
+
+    flock(lock, LOCK_UN);
+    close(lock);
+    _pending.clear();
+    return added;
+  }
+
+  const std::string& path() const { return _path; }
+  uint64_t           size() const { return _size; }
+  uint64_t           capacity() const { return _capacity; }
+  uint64_t           pending() const { return _pending.size(); }
+
+ private:
+  std::string       _path;
+  uint64_t          _bytes    = 0;
+  uint64_t          _capacity = 0;
+  uint64_t          _size     = 0;
+  char*             _data     = nullptr;
+  const Slot*       _slots    = nullptr;
+  std::vector<Slot> _pending;
+
+  // Scratch space of the batched 'find'
+  mutable std::vector<uint64_t> _pages;
+
+  uint64_t home(const Key& key) const { return key.lo & (_capacity - 1); }
+
+  void map() {
+    auto fd = open(_path.c_str(), O_RDONLY);
+    if (fd < 0 && errno == ENOENT) return;  // empty store
+    if (fd < 0)
+      throw std::runtime_error("Can't open " + _path + ": " + strerror(errno));
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+      close(fd);
+      throw std::runtime_error("Can't stat " + _path + ": " + strerror(errno));
+    }
+    // NOTE: A 0-byte file, e.g. from 'touch', is an empty store too
+    if (st.st_size == 0) {
+      close(fd);
+      return;
+    }
+    if (uint64_t(st.st_size) < slots_offset) {
+      close(fd);
+      throw std::runtime_error(_path + " is not a weight store");
+    }
+    _bytes = st.st_size;
+
+    auto addr = mmap(nullptr, _bytes, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) throw std::runtime_error("Can't map " + _path);
+    _data = static_cast<char*>(addr);
+    // Lookups are all over the table
+    madvise(addr, _bytes, MADV_RANDOM);
+
+    FileHeader hdr;
+    if (_bytes < slots_offset || memcmp(_data, magic, sizeof(magic)) != 0)
+      throw std::runtime_error(_path + " is not a weight store");
+    memcpy(&hdr, _data, sizeof(hdr));
+    if (hdr.version != version)
+      throw std::runtime_error(_path + " has unsupported weight store " +
+                               "version " + std::to_string(hdr.version));
+    if (_bytes < slots_offset + hdr.capacity * sizeof(Slot))
+      throw std::runtime_error(_path + " is truncated");
+
+    _capacity = hdr.capacity;
+    _size     = hdr.size;
+    _slots    = reinterpret_cast<const Slot*>(_data + slots_offset);
+  }
+
+  void unmap() {
+    if (_data) munmap(_data, _bytes);
+    _data     = nullptr;
+    _slots    = nullptr;
+    _bytes    = 0;
+    _capacity = 0;
+    _size     = 0;
+  }
+
+  // Write the mapped and pending slots into a new, large enough table, and
+  // rename it over the old file
+  uint64_t rewrite() {
+    auto capacity = std::max(_capacity, min_capacity);
+    while (2 * (_size + _pending.size()) > capacity) capacity *= 2;
+
+    auto tmp   = _path + ".tmp";
+    auto bytes = slots_offset + capacity * sizeof(Slot);
+    auto fd    = open(tmp.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) throw std::runtime_error("Can't create " + tmp);
+    if (ftruncate(fd, bytes) != 0) {
+      close(fd);
+      throw std::runtime_error("Can't allocate " + tmp);
+    }
+    auto addr = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) throw std::runtime_error("Can't map " + tmp);
+
+    auto data  = static_cast<char*>(addr);
+    auto slots = reinterpret_cast<Slot*>(data + slots_offset);
+    auto size  = uint64_t{0};
+
+    // Returns false if the key is there already
+    auto put = [&](const Slot& s) {
+      for (auto i = s.key.lo & (capacity - 1);; i = (i + 1) & (capacity - 1)) {
+        if (slots[i].flags == 0) {
+          slots[i] = s;
+          size++;
+          return true;
+        }
+        if (slots[i].key == s.key) return false;
+      }
+    };
+
+    for (uint64_t i = 0; i < _capacity; i++)
+      if (_slots[i].flags != 0) put(_slots[i]);
+    uint64_t added = 0;
+    for (const auto& s : _pending)
+      if (put(s)) added++;
+
+    FileHeader hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, magic, sizeof(magic));
+    hdr.version  = version;
+    hdr.capacity = capacity;
+    hdr.size     = size;
+    memcpy(data, &hdr, sizeof(hdr));
+
+    auto synced = msync(addr, bytes, MS_SYNC) == 0;
+    munmap(addr, bytes);
+    if (!synced || rename(tmp.c_str(), _path.c_str()) != 0)
+      throw std::runtime_error("Can't write " + _path);
+
+    return added;
+  }
+};
+
+}  // namespace weight_store
+
+#endif
@@ -0,0 +1,325 @@
+// Author: Yipeng Sun
+// License: GPLv2
+// Description: Multi-dimensional weight lookup table on a tensor-product grid
+//              with adaptively placed nodes and multilinear interpolation.
+// Last Change: Sat Oct 17, 2026 at 09:47 PM +0200
+//
+// The table is built once from an exact (but slow) oracle; the nodes of each
+// axis are refined where the interpolation error is above the target. Lookups
+// are a binary search per axis plus 2^dim table reads.
+//
+// File layout:
+//   char[8] magic, uint32 version, uint32 num_axes
+//   per axis: char[32] name, uint32 discrete, uint32 num_nodes, double nodes[]
+//   double values[] (last axis runs fastest)
+
+#ifndef _RDX_WEIGHT_TABLE_H_
+#define _RDX_WEIGHT_TABLE_H_
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace weight_table {
+
+constexpr char     magic[8] = {'R', 'D', 'X', 'W', 'T', 'A', 'B', 'L'};
+constexpr uint32_t version  = 1;
+
+struct Axis {
+  std::string         name;
+  std::vector<double> nodes;  // sorted; the first and last are the domain
+  // Only evaluated at the nodes themselves (e.g. a charge), never refined
+  bool discrete = false;
+
+  double lo() const { return nodes.front(); }
+  double hi() const { return nodes.back(); }
+};
+
+inline Axis uniform_axis(const std::string& name, double lo, double hi,
+                         int num_nodes) {
+  Axis axis{name, {}, false};
+  for (auto i = 0; i < num_nodes; i++)
+    axis.nodes.push_back(lo + (hi - lo) * i / (num_nodes - 1));
+  return axis;
+}
+
+class Table {
+ public:
+  Table() = default;
+  Table(const std::vector<Axis>& axes) : _axes(axes) { resize(); }
+
+  const std::vector<Axis>& axes() const { return _axes; }
+  size_t                   dim() const { return _axes.size(); }
+  size_t                   num_nodes() const { return _values.size(); }
+
+  // Evaluate 'oracle(const double* point)' at every node
+  template <class F>
+  void fill(F oracle) {
+    std::vector<double> point(dim());
+    std::vector<size_t> idx(dim(), 0);
+
+    for (auto flat = 0ul; flat < _values.size(); flat++) {
+      for (auto a = 0ul; a < dim(); a++) point[a] = _axes[a].nodes[idx[a]];
+      _values[flat] = oracle(point.data());
+
+      // Increment the multi-index, last axis first
+      for (auto a = dim(); a-- > 0;) {
+        if (++idx[a] < _axes[a].nodes.size()) break;
+        idx[a] = 0;
+      }
+    }
+  }
+
+  // Multilinear interpolation; points outside of the domain are clamped
+  double operator()(const double* x) const {
+    size_t base = 0;
+    double frac[max_dim];
+    size_t step[max_dim];
+
+    for (auto a = 0ul; a < dim(); a++) {
+      const auto& nodes = _axes[a].nodes;
+      auto        xa    = std::min(std::max(x[a], nodes.front()), nodes.back());
+
+      auto i = std::upper_bound(nodes.begin(), nodes.end(), xa) - nodes.begin();
+      i      = std::min(std::max(i, 1l), static_cast<long>(nodes.size()) - 1);
+
+      frac[a] = (xa - nodes[i - 1]) / (nodes[i] - nodes[i - 1]);
+      step[a] = _strides[a];
+      base += (i - 1) * _strides[a];
+    }
+
+    double result = 0;
+    for (auto corner = 0ul; corner < (1ul << dim()); corner++) {
+      auto   flat = base;
+      double w    = 1;
+      for (auto a = 0ul; a < dim(); a++) {
+        if (corner & (1ul << a)) {
+          flat += step[a];
+          w *= frac[a];
+        } else
+          w *= 1 - frac[a];
+      }
+      if (w != 0) result += w * _values[flat];
+    }
+
+    return result;
+  }
+
+  // Insert the midpoint of interval 'i' (between nodes i and i+1) of axis 'a'
+  void split(size_t a, size_t i) {
+    auto& nodes = _axes[a].nodes;
+    nodes.insert(nodes.begin() + i + 1, (nodes[i] + nodes[i + 1]) / 2);
+    resize();
+  }
+
+  void save(const std::string& path) const {
+    std::ofstream out(path, std::ios::binary);
+    if (!out) throw std::runtime_error("Can't create " + path);
+
+    uint32_t num_axes = dim();
+    out.write(magic, sizeof(magic));
+    out.write(reinterpret_cast<const char*>(&version), sizeof(version));
+    out.write(reinterpret_cast<const char*>(&num_axes), sizeof(num_axes));
+
+    for (const auto& axis : _axes) {
+      char name[32] = {};
+      strncpy(name, axis.name.c_str(), sizeof(name) - 1);
+      uint32_t discrete = axis.discrete, n = axis.nodes.size();
+
+      out.write(name, sizeof(name));
+      out.write(reinterpret_cast<const char*>(&discrete), sizeof(discrete));
+      out.write(reinterpret_cast<const char*>(&n), sizeof(n));
+      out.write(reinterpret_cast<const char*>(axis.nodes.data()),
+                n * sizeof(double));
+    }
+
+    out.write(reinterpret_cast<const char*>(_values.data()),
+              _values.size() * sizeof(double));
+  }
+
+  static Table load(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    char          buf[sizeof(magic)] = {};
+    uint32_t      ver = 0, num_axes = 0;
+
+    in.read(buf, sizeof(buf));
+    in.read(reinterpret_cast<char*>(&ver), sizeof(ver));
+    in.read(reinterpret_cast<char*>(&num_axes), sizeof(num_axes));
+    if (!in || memcmp(buf, magic, sizeof(magic)) != 0)
+      throw std::runtime_error(path + " is not a weight table");
+    if (ver != version || num_axes > max_dim)
+      throw std::runtime_error(path + " has an unsupported format");
+
+    std::vector<Axis> axes(num_axes);
+    for (auto& axis : axes) {
+      char     name[32] = {};
+      uint32_t discrete = 0, n = 0;
+
+      in.read(name, sizeof(name));
+      in.read(reinterpret_cast<char*>(&discrete), sizeof(discrete));
+      in.read(reinterpret_cast<char*>(&n), sizeof(n));
+
+      axis.name     = std::string(name, strnlen(name, sizeof(name)));
+      axis.discrete = discrete;
+      axis.nodes.resize(n);
+      in.read(reinterpret_cast<char*>(axis.nodes.data()), n * sizeof(double));
+    }
+
+    Table table(axes);
+    in.read(reinterpret_cast<char*>(table._values.data()),
+            table._values.size() * sizeof(double));
+    if (!in) throw std::runtime_error(path + " is truncated");
+
+    return table;
+  }
+
+  static constexpr size_t max_dim = 8;
+
+ private:
+  std::vector<Axis>   _axes;
+  std::vector<size_t> _strides;
+  std::vector<double> _values;
+
+  void resize() {
+    if (dim() > max_dim)
+      throw std::runtime_error("Weight tables have at most " +
+                               std::to_string(max_dim) + " axes");
+
+    _strides.assign(dim(), 1);
+    for (auto a = dim(); a-- > 1;)
+      _strides[a - 1] = _strides[a] * _axes[a].nodes.size();
+    _values.assign(dim() ? _strides[0] * _axes[0].nodes.size() : 0, 0.);
+  }
+};
+
+//////////////////////////////
+// Adaptive build and check //
+//////////////////////////////
+
+struct Report {
+  size_t num_points = 0;
+  size_t num_nodes  = 0;
+  int    iterations = 0;
+  bool   converged  = false;
+  double max_err    = 0;  // absolute errors on the weight
+  double mean_err   = 0;
+  double p99_err    = 0;
+};
+
+// Random points, uniform in the continuous axes, on the nodes of discrete ones
+inline std::vector<std::vector<double>> random_points(
+    const std::vector<Axis>& axes, size_t n, std::mt19937_64& rng) {
+  std::vector<std::vector<double>> points(n, std::vector<double>(axes.size()));
+
+  for (auto& point : points)
+    for (auto a = 0ul; a < axes.size(); a++) {
+      const auto& axis = axes[a];
+      if (axis.discrete) {
+        std::uniform_int_distribution<size_t> pick(0, axis.nodes.size() - 1);
+        point[a] = axis.nodes[pick(rng)];
+      } else
+        point[a] = std::uniform_real_distribution<double>(axis.lo(),
+                                                          axis.hi())(rng);
+    }
+
+  return points;
+}
+
+template <class F>
+Report validate(const Table& table, F oracle,
+                const std::vector<std::vector<double>>& points,
+                std::vector<double>*                    errs = nullptr) {
+  Report              report{};
+  std::vector<double> e(points.size());
+
+  for (auto i = 0ul; i < points.size(); i++) {
+    e[i] = std::fabs(table(points[i].data()) - oracle(points[i].data()));
+    report.mean_err += e[i];
+    report.max_err = std::max(report.max_err, e[i]);
+  }
+
+  report.num_points = points.size();
+  report.num_nodes  = table.num_nodes();
+  if (!points.empty()) report.mean_err /= points.size();
+  if (errs) *errs = e;
+
+  auto sorted = e;
+  if (!sorted.empty()) {
+    auto k = static_cast<size_t>(0.99 * (sorted.size() - 1));
+    std::nth_element(sorted.begin(), sorted.begin() + k, sorted.end());
+    report.p99_err = sorted[k];
+  }
+
+  return report;
+}
+
+// Start from 'axes' and split the intervals where the interpolation error on
+// 'num_points' random points is above 'target', until every point is within
+// 'target' or the table would exceed 'max_nodes'. Intervals are scored by the
+// summed excess error of the points inside them; all intervals scoring at
+// least a quarter of the best one are split at once.
+template <class F>
+Table build(const std::vector<Axis>& axes, F oracle, double target,
+            size_t max_nodes, size_t num_points, std::mt19937_64& rng,
+            Report& report) {
+  Table table(axes);
+  table.fill(oracle);
+
+  auto                points = random_points(axes, num_points, rng);
+  std::vector<double> errs;
+
+  for (report.iterations = 0;; report.iterations++) {
+    auto check = validate(table, oracle, points, &errs);
+    if (check.max_err <= target) {
+      report.converged = true;
+      break;
+    }
+
+    // Score each interval of each axis
+    std::vector<std::vector<double>> score(table.dim());
+    for (auto a = 0ul; a < table.dim(); a++)
+      score[a].assign(table.axes()[a].nodes.size() - 1, 0.);
+
+    for (auto p = 0ul; p < points.size(); p++) {
+      if (errs[p] <= target) continue;
+      for (auto a = 0ul; a < table.dim(); a++) {
+        const auto& axis = table.axes()[a];
+        if (axis.discrete) continue;
+
+        auto i = std::upper_bound(axis.nodes.begin(), axis.nodes.end(),
+                                  points[p][a]) -
+                 axis.nodes.begin();
+        i = std::min(std::max(i, 1l), static_cast<long>(axis.nodes.size()) - 1);
+        score[a][i - 1] += errs[p] - target;
+      }
+    }
+
+    double best = 0;
+    for (const auto& s : score)
+      for (auto v : s) best = std::max(best, v);
+
+    // Split from the back, so that interval indices stay valid
+    auto candidate = Table(table.axes());
+    for (auto a = 0ul; a < table.dim(); a++)
+      for (auto i = score[a].size(); i-- > 0;)
+        if (score[a][i] >= best / 4) candidate.split(a, i);
+
+    if (candidate.num_nodes() > max_nodes) break;
+
+    table = candidate;
+    table.fill(oracle);
+  }
+
+  report.num_nodes = table.num_nodes();
+  return table;
+}
+
+}  // namespace weight_table
+
+#endif
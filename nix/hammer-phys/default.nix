@@ -26,6 +26,8 @@ stdenv.mkDerivation rec {
     root
   ];
 
+  # TODO: No patch makes separate Hammer instances thread safe yet; one must
+  #       pass 'make hammer-stress' before any threaded reweighting is enabled
   patches = [ ./add_missing_header.patch ];
 
   cmakeFlags = [
@@ -0,0 +1,43 @@
+// Author: Yipeng Sun
+// License: GPLv2
+// Description: Replacements of the global operator new and delete that count
+//              heap allocations per stage (see inc/alloc_stats.h).
+// Last Change: Sun Oct 18, 2026 at 08:02 AM +0200
+//
+// NOTE: Link this into executables only. A shared library that replaces them
+//       takes over the allocator of every program that loads it.
+
+#include <cstdlib>
+#include <new>
+
+#include "alloc_stats.h"
+
+void* operator new(std::size_t n) {
+  if (auto ptr = alloc_stats::counted_alloc(n)) return ptr;
+  throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t n) { return operator new(n); }
+
+void* operator new(std::size_t n, const std::nothrow_t&) noexcept {
+  return alloc_stats::counted_alloc(n);
+}
+
+void* operator new[](std::size_t n, const std::nothrow_t&) noexcept {
+  return alloc_stats::counted_alloc(n);
+}
+
+// NOTE: GCC doesn't know that the replaced operator new uses malloc
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete[](void* ptr) noexcept { std::free(ptr); }
+void operator delete(void* ptr, std::size_t) noexcept { std::free(ptr); }
+void operator delete[](void* ptr, std::size_t) noexcept { std::free(ptr); }
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
@@ -0,0 +1,209 @@
+// Author: Yipeng Sun
+// License: GPLv2
+// Description: Run many HAMMER instances concurrently on the same truth
+//              events, and compare their weights bitwise with a serial run.
+// Last Change: Sat Oct 17, 2026 at 08:34 PM +0200
+//
+// Each thread owns its own Hammer::Hammer; nothing is shared on our side, so
+// any mismatch, exception or crash is due to shared state inside HAMMER.
+
+#include <Hammer/Hammer.hh>
+
+#include <TFile.h>
+
+#include <atomic>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <cxxopts.hpp>
+
+#include "rdx_hammer.h"
+#include "truth_source.h"
+
+using namespace std;
+
+// Weight of events that HAMMER doesn't accept
+const double w_rejected = -1.;
+
+struct ThreadResult {
+  Long64_t mismatches     = 0;
+  Long64_t first_mismatch = -1;
+  double   expected       = 0;
+  double   got            = 0;
+  string   error          = "";
+};
+
+// Weights of all 'events' with a single HAMMER instance, starting at 'offset'
+// so that concurrent instances work on different events at any given time
+vector<double> compute_weights(Hammer::Hammer&           ham,
+                               const vector<TruthEvent>& events,
+                               size_t                    offset) {
+  vector<double> weights(events.size(), w_rejected);
+
+  for (auto k = 0ul; k < events.size(); k++) {
+    auto        i   = (k + offset) % events.size();
+    const auto& evt = events[i];
+
+    auto proc = make_process(evt, fix_b_id(evt));
+    ham.initEvent();
+    auto proc_id = ham.addProcess(proc);
+
+    if (proc_id != 0) {
+      ham.processEvent();
+      weights[i] = ham.getWeight("SemiTauonic");
+    }
+  }
+
+  return weights;
+}
+
+bool bit_equal(double a, double b) { return memcmp(&a, &b, sizeof(a)) == 0; }
+
+ThreadResult compare(const vector<double>& ref, const vector<double>& weights) {
+  ThreadResult res{};
+
+  for (auto i = 0ul; i < ref.size(); i++) {
+    if (bit_equal(ref[i], weights[i])) continue;
+
+    if (res.first_mismatch < 0) {
+      res.first_mismatch = i;
+      res.expected       = ref[i];
+      res.got            = weights[i];
+    }
+    res.mismatches++;
+  }
+
+  return res;
+}
+
+int main(int argc, char** argv) {
+  cxxopts::Options argopts(
+      "hammer-thread-stress",
+      "Check that separate HAMMER instances can process events concurrently.");
+
+  // clang-format off
+  argopts.add_options()
+    ("h,help", "print help")
+    ("input", "specify input ntuple",
+     cxxopts::value<string>()->default_value("samples/rdst-run1.root"))
+    ("t,tree", "specify input tree",
+     cxxopts::value<string>()->default_value("mc_dst_tau_aux"))
+    ("n,threads", "specify the number of concurrent HAMMER instances",
+     cxxopts::value<unsigned>()->default_value(
+         to_string(max(2u, thread::hardware_concurrency()))))
+    ("r,rounds", "specify how many times the threads are restarted",
+     cxxopts::value<int>()->default_value("3"))
+    ("m,max-events", "only use the first N events (0 for all)",
+     cxxopts::value<Long64_t>()->default_value("0"))
+    ("parallel-init", "also run 'initRun' concurrently")
+  ;
+  // clang-format on
+
+  argopts.parse_positional({"input"});
+  auto parsed_args = argopts.parse(argc, argv);
+
+  if (parsed_args.count("help")) {
+    cout << argopts.help() << endl;
+    return 0;
+  }
+
+  auto input_path    = parsed_args["input"].as<string>();
+  auto tree          = parsed_args["tree"].as<string>();
+  auto num_of_thread = parsed_args["threads"].as<unsigned>();
+  auto rounds        = parsed_args["rounds"].as<int>();
+  auto max_evt       = parsed_args["max-events"].as<Long64_t>();
+  auto parallel_init = parsed_args.count("parallel-init") > 0;
+
+  // Load all truth events up front, so that threads only touch HAMMER /////////
+  vector<TruthEvent> events{};
+  {
+    TFile           input_file(input_path.c_str(), "read");
+    TreeTruthSource truth(tree.c_str(), &input_file);
+    TruthEvent      evt;
+
+    while (truth.next(evt) &&
+           (max_evt <= 0 || static_cast<Long64_t>(events.size()) < max_evt))
+      events.push_back(evt);
+  }
+  cout << "Loaded " << events.size() << " events from " << tree << endl;
+
+  // Serial reference //////////////////////////////////////////////////////////
+  vector<double> ref{};
+  {
+    Hammer::Hammer ham{};
+    setup_hammer(ham);
+    ref = compute_weights(ham, events, 0);
+  }
+
+  // Concurrent instances //////////////////////////////////////////////////////
+  auto failed = false;
+
+  for (auto round = 0; round < rounds; round++) {
+    vector<ThreadResult> results(num_of_thread);
+    vector<thread>       threads{};
+    mutex                init_mutex;
+    atomic<unsigned>     ready{0};
+
+    for (auto t = 0u; t < num_of_thread; t++) {
+      threads.emplace_back([&, t] {
+        unique_ptr<Hammer::Hammer> ham{};
+
+        try {
+          ham.reset(new Hammer::Hammer{});
+          if (parallel_init)
+            setup_hammer(*ham);
+          else {
+            lock_guard<mutex> lock(init_mutex);
+            setup_hammer(*ham);
+          }
+        } catch (const exception& e) {
+          results[t].error = string("initRun: ") + e.what();
+        }
+
+        // Start processing at the same time to maximize overlap
+        ready++;
+        while (ready < num_of_thread) this_thread::yield();
+        if (!results[t].error.empty()) return;
+
+        try {
+          auto offset = t * events.size() / num_of_thread;
+          results[t]  = compare(ref, compute_weights(*ham, events, offset));
+        } catch (const exception& e) {
+          results[t].error = e.what();
+        }
+      });
+    }
+
+    for (auto& th : threads) th.join();
+
+    for (auto t = 0u; t < num_of_thread; t++) {
+      const auto& res = results[t];
+
+      if (!res.error.empty()) {
+        cout << "Round " << round << ", thread " << t
+             << ": exception: " << res.error << endl;
+        failed = true;
+      } else if (res.mismatches > 0) {
+        cout << "Round " << round << ", thread " << t << ": " << res.mismatches
+             << " weights differ from the serial run, first at event "
+             << res.first_mismatch << " (" << res.got << " vs. "
+             << res.expected << ")" << endl;
+        failed = true;
+      }
+    }
+  }
+
+  if (failed) {
+    cout << "FAILED: concurrent HAMMER instances are not reproducible." << endl;
+    return 1;
+  }
+
+  cout << "OK: " << rounds << " rounds of " << num_of_thread
+       << " concurrent HAMMER instances match the serial run bitwise." << endl;
+  return 0;
+}
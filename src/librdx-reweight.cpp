@@ -0,0 +1,91 @@
+// Author: Yipeng Sun
+// License: GPLv2
+// Description: Shared library of the streaming reweighter, for C and Python
+//              (see utils/rdx_reweight.py).
+// Last Change: Sun Oct 18, 2026 at 09:12 AM +0200
+
+#include <exception>
+#include <mutex>
+#include <string>
+
+#include "rdx_reweight_capi.h"
+#include "reweighter.h"
+
+using namespace std;
+
+struct rdx_reweighter {
+  Reweighter rw;
+};
+
+// NOTE: No exception may cross the C interface
+static thread_local string last_error{};
+
+// NOTE: Held while any thread is in HAMMER, which is not known to be thread
+//       safe, even across separate instances
+static mutex hammer_busy{};
+
+template <class F>
+static bool guarded(F f) {
+  unique_lock<mutex> lock(hammer_busy, try_to_lock);
+  if (!lock.owns_lock()) {
+    last_error = "HAMMER is not known to be thread safe; another thread is "
+                 "using a reweighter";
+    return false;
+  }
+
+  try {
+    f();
+    return true;
+  } catch (const exception& e) {
+    last_error = e.what();
+  } catch (...) {
+    last_error = "unknown exception";
+  }
+  return false;
+}
+
+extern "C" {
+
+rdx_reweighter* rdx_reweighter_new(double topo_tol) {
+  rdx_reweighter* result = nullptr;
+  guarded([&] {
+    result = new rdx_reweighter{Reweighter(ReweighterOptions{{}, topo_tol})};
+  });
+  return result;
+}
+
+void rdx_reweighter_free(rdx_reweighter* rw) {
+  lock_guard<mutex> lock(hammer_busy);
+  delete rw;
+}
+
+int64_t rdx_reweighter_push(rdx_reweighter* rw, size_t size,
+                            const uint32_t* run, const uint64_t* evt,
+                            const int32_t* const* id, const double* const* pe,
+                            const double* const* px, const double* const* py,
+                            const double* const* pz, const bool* selected,
+                            double* w_ff, double* q2, double* mm2, double* el) {
+  TruthBatch in{size, run, evt};
+  for (auto p = 0; p < NumOfTruthPart; p++) {
+    in.id[p] = id[p];
+    in.pe[p] = pe[p];
+    in.px[p] = px[p];
+    in.py[p] = py[p];
+    in.pz[p] = pz[p];
+  }
+  in.selected = selected;
+
+  int64_t weights = -1;
+  guarded([&] { weights = rw->rw.push(in, {w_ff, q2, mm2, el}); });
+  return weights;
+}
+
+void rdx_reweighter_take_stats(rdx_reweighter* rw, rdx_reweight_stats* out) {
+  auto s = rw->rw.take_stats();
+  *out   = rdx_reweight_stats{s.entries,  s.hammer_runs, s.cache_hits,
+                            s.presel_rej, s.topo_rej,    s.weights,
+                            s.sum_w,      s.sum_w2,      s.hammer_time};
+}
+
+const char* rdx_reweighter_error(void) { return last_error.c_str(); }
+}
@@ -0,0 +1,128 @@
+// Author: Yipeng Sun
+// License: GPLv2
+// Description: Throughput of the RDataFrame FF weight column vs. the number
+//              of implicit MT threads.
+// Last Change: Sun Oct 18, 2026 at 09:27 AM +0200
+//
+// For each thread count, a new set of HAMMER instances (one per slot) is
+// initialized, and a single event loop fills the sum of weights and the
+// number of weighted entries. The sums should agree between thread counts up
+// to the order of the additions.
+//
+// NOTE: Thread counts above 1 need '--unverified-threads', as HAMMER is not
+//       known to be thread safe (see 'rdf_weight.h'). Until a thread-safe
+//       HAMMER exists, the scaling with implicit MT is not measured.
+
+#include <ROOT/RDataFrame.hxx>
+#include <TROOT.h>
+
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <cxxopts.hpp>
+
+#include "rdf_weight.h"
+
+using namespace std;
+
+double seconds_since(chrono::steady_clock::time_point start) {
+  chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+  return elapsed.count();
+}
+
+int main(int argc, char** argv) {
+  cxxopts::Options argopts(
+      "rdf-weight-bench",
+      "Time the RDataFrame FF weight column with implicit MT.");
+
+  // clang-format off
+  argopts.add_options()
+    ("h,help", "print help")
+    ("input", "specify input ntuple",
+     cxxopts::value<string>()->default_value("samples/rdst-run1.root"))
+    ("t,tree", "specify input tree",
+     cxxopts::value<string>()->default_value("mc_dst_tau_aux"))
+    ("j,threads", "specify the thread counts to compare (1: no implicit MT)",
+     cxxopts::value<vector<unsigned>>()->default_value("1"))
+    ("unverified-threads", "allow thread counts above 1, with a HAMMER build "
+                           "that is not known to be thread safe")
+    ("c,cut", "specify a filter to apply before the weight column",
+     cxxopts::value<string>()->default_value(""))
+  ;
+  // clang-format on
+
+  argopts.parse_positional({"input"});
+  auto parsed_args = argopts.parse(argc, argv);
+
+  if (parsed_args.count("help")) {
+    cout << argopts.help() << endl;
+    return 0;
+  }
+
+  auto input_path = parsed_args["input"].as<string>();
+  auto tree       = parsed_args["tree"].as<string>();
+  auto threads    = parsed_args["threads"].as<vector<unsigned>>();
+  auto cut        = parsed_args["cut"].as<string>();
+  auto unverified = parsed_args.count("unverified-threads") > 0;
+
+  for (auto n : threads)
+    if (n > 1 && !unverified) {
+      cerr << "Thread counts above 1 need --unverified-threads." << endl;
+      return 1;
+    }
+  if (unverified)
+    cerr << "WARNING: HAMMER is not known to be thread safe, so results with "
+            "more than 1 thread are not verified."
+         << endl;
+
+  double ref_sum = 0, ref_rate = 0;
+  cout << setprecision(15);
+
+  for (auto k = 0ul; k < threads.size(); k++) {
+    auto n = threads[k];
+
+    ROOT::DisableImplicitMT();
+    if (n > 1) ROOT::EnableImplicitMT(n);
+
+    auto start = chrono::steady_clock::now();
+    auto w     = rdf_weight::HammerWeight{rdf_weight::num_slots(), {}, 1.,
+                                      unverified};
+    auto init  = seconds_since(start);
+
+    ROOT::RDataFrame df(tree, input_path);
+    ROOT::RDF::RNode node = df;
+    if (!cut.empty()) node = df.Filter(cut);
+
+    auto weighted =
+        node.DefineSlot("w_ff", w, rdf_weight::HammerWeight::columns())
+            .Filter("w_ff >= 0");
+    auto sum   = weighted.Sum<double>("w_ff");
+    auto count = weighted.Count();
+
+    // Both results are filled in the same event loop
+    start        = chrono::steady_clock::now();
+    auto sum_w   = *sum;
+    auto elapsed = seconds_since(start);
+    auto stats   = w.stats();
+    auto rate    = stats.entries / elapsed;
+
+    if (k == 0) {
+      ref_sum  = sum_w;
+      ref_rate = rate;
+    }
+
+    cout << n << " threads (" << rdf_weight::num_slots() << " slots): "
+         << "init " << init << " s, loop " << elapsed << " s, " << rate
+         << " entries/s, speedup " << rate / ref_rate << endl;
+    cout << "  " << stats.entries << " entries, " << stats.hammer_runs
+         << " HAMMER runs, " << stats.topo_rej << " topology rejections, "
+         << *count << " weights, sum w_ff " << sum_w << " (rel. diff "
+         << (ref_sum != 0 ? abs(sum_w / ref_sum - 1) : 0.) << ")" << endl;
+  }
+
+  return 0;
+}
@@ -3,7 +3,7 @@
 // Description: FF reweighting for R(D(*)) run 1, step 1 ntuples.
 // Based on:
 //   https://github.com/ZishuoYang/my-hammer-reweighting/blob/master/Bc2JpsiMuNu.cc
-// Last Change: Mon Oct 26, 2020 at 12:21 AM +0100
+// Last Change: Sun Oct 18, 2026 at 09:21 AM +0200
 
 #include <Hammer/Hammer.hh>
 #include <Hammer/Math/FourMomentum.hh>
@@ -12,292 +12,1304 @@
 #include <Hammer/Tools/HammerRoot.hh>
 
 #include <TBranch.h>
+#include <TChain.h>
 #include <TFile.h>
-#include <TLorentzVector.h>
+#include <TH1D.h>
+#include <TEntryList.h>
+#include <TROOT.h>
 #include <TTree.h>
 #include <TTreeReader.h>
-#include <TVector.h>
+#include <TTreeReaderArray.h>
 
-#include <initializer_list>
+#include <signal.h>
+#include <sys/prctl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#ifdef WITH_MPI
+#include <mpi.h>
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <complex>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <stdexcept>
 #include <string>
+#include <unordered_set>
+#include <vector>
+
+#include <cxxopts.hpp>
+
+#include "alloc_stats.h"
+#include "file_prefetch.h"
+#include "metrics.h"
+#include "perf_counters.h"
+#include "preview_sample.h"
+#include "rdx_hammer.h"
+#include "reweighter.h"
+#include "shm_ring.h"
+#include "truth_cache.h"
+#include "truth_source.h"
+#include "truth_topology.h"
 
 using namespace std;
 
+// Branches computed by the reweighter
+const vector<string> reweight_branches{"w_ff", "q2_true", "mm2_true",
+                                       "el_true"};
+
+// Events per batched weight store lookup
+const size_t lookup_block = 1024;
+
 //////////////////////////////
 // General helper functions //
 //////////////////////////////
 
-auto particle(Double_t pe, Double_t px, Double_t py, Double_t pz, Int_t pid) {
-  auto four_mom = Hammer::FourMomentum(pe, px, py, pz);
-  auto part_id  = static_cast<Hammer::PdgId>(pid);
-
-  return Hammer::Particle(four_mom, part_id);
+double seconds_since(chrono::steady_clock::time_point start) {
+  chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+  return elapsed.count();
 }
 
-template <class T>
-auto calc_mm2_with_nu(initializer_list<T> momenta) {
-  TLorentzVector tot_mom;
-  tot_mom.SetPxPyPzE(0, 0, 0, 0);
+// Parse 'name=re' or 'name=re:im' settings of Wilson coefficients
+map<string, complex<double>> parse_wc_values(const vector<string>& settings) {
+  map<string, complex<double>> result{};
+
+  for (const auto& setting : settings) {
+    auto eq = setting.find('=');
+    if (eq == string::npos)
+      throw runtime_error("Invalid WC setting " + setting +
+                          ", expecting name=value");
 
-  for (auto mom : momenta) {
-    tot_mom += mom;
+    auto   val   = setting.substr(eq + 1);
+    auto   colon = val.find(':');
+    double re    = stod(val.substr(0, colon));
+    double im    = colon == string::npos ? 0. : stod(val.substr(colon + 1));
+
+    result[setting.substr(0, eq)] = complex<double>(re, im);
   }
 
-  return tot_mom.M2() / 1E6;
+  return result;
+}
+
+// Whether 'file' failed to open, with the error printed
+bool zombie(TFile* file, const string& path) {
+  if (!file->IsZombie()) return false;
+  cerr << "Can't open " << path << endl;
+  return true;
 }
 
-///////////////////////////////////////////
-// Helper functions for B0 -> Dst Tau Nu //
-///////////////////////////////////////////
+// Name of the weight tree for a given input tree, e.g.:
+//   mc_dst_tau_aux -> mc_dst_tau_ff_w
+//   dst_iso        -> dst_iso_ff_w
+string weight_tree_name(string tree) {
+  const string aux_suffix = "_aux";
 
-// clang-format off
-void calc_true_fit_vars(Double_t& q2, Double_t& el,
-                        TVector3& b_lab_v,
-                        TLorentzVector& b_mom, TLorentzVector& dst_mom,
-                        TLorentzVector mu_mom) {
-  // clang-format on
-  q2 = (b_mom - dst_mom).M2() / 1E6;
+  if (tree.size() > aux_suffix.size() &&
+      tree.compare(tree.size() - aux_suffix.size(), aux_suffix.size(),
+                   aux_suffix) == 0)
+    tree.erase(tree.size() - aux_suffix.size());
 
-  // NOTE: The Mu momentum is copied so that we don't mess up with later
-  // calculation!
-  mu_mom.Boost(-b_lab_v);
-  el = mu_mom.E() / 1E3;
+  return tree + "_ff_w";
 }
 
-// clang-format off
-void add_ham_part_Tau(Hammer::Process& proc,
-                      Hammer::Particle& B0,
-                      Hammer::Particle& Dst,
-                      Hammer::Particle& D0, Hammer::Particle& SlowPi,
-                      Hammer::Particle& K, Hammer::Particle& Pi,
-                      Hammer::Particle& Tau, Hammer::Particle& Anti_Nu_Tau,
-                      Hammer::Particle& Nu_Tau,
-                      Hammer::Particle& Mu, Hammer::Particle& Anti_Nu_Mu) {
-  // clang-format on
-  auto B0_idx          = proc.addParticle(B0);
-  auto Dst_idx         = proc.addParticle(Dst);
-  auto SlowPi_idx      = proc.addParticle(SlowPi);
-  auto D0_idx          = proc.addParticle(D0);
-  auto K_idx           = proc.addParticle(K);
-  auto Pi_idx          = proc.addParticle(Pi);
-  auto Mu_idx          = proc.addParticle(Mu);
-  auto Tau_idx         = proc.addParticle(Tau);
-  auto Anti_Nu_Mu_idx  = proc.addParticle(Anti_Nu_Mu);
-  auto Anti_Nu_Tau_idx = proc.addParticle(Anti_Nu_Tau);
-  auto Nu_Tau_idx      = proc.addParticle(Nu_Tau);
-
-  proc.addVertex(B0_idx, {Dst_idx, Tau_idx, Anti_Nu_Tau_idx});
-  proc.addVertex(Tau_idx, {Mu_idx, Nu_Tau_idx, Anti_Nu_Mu_idx});
-  proc.addVertex(Dst_idx, {D0_idx, SlowPi_idx});
-  proc.addVertex(D0_idx, {K_idx, Pi_idx});
+void print_reweight_stats(const vector<string>&        trees,
+                          const vector<ReweightStats>& stats) {
+  ReweightStats tot{};
+
+  cout << left << setw(24) << "Tree" << right << setw(12) << "entries"
+       << setw(14) << "HAMMER runs" << setw(12) << "cache hits" << setw(16)
+       << "pre-selected out" << setw(14) << "bad topology" << endl;
+  for (auto i = 0ul; i < trees.size(); i++) {
+    cout << left << setw(24) << trees[i] << right << setw(12)
+         << stats[i].entries << setw(14) << stats[i].hammer_runs << setw(12)
+         << stats[i].cache_hits << setw(16) << stats[i].presel_rej << setw(14)
+         << stats[i].topo_rej << endl;
+    tot += stats[i];
+  }
+
+  auto pct = [&](Long64_t num) {
+    return tot.entries > 0 ? 100. * num / tot.entries : 0.;
+  };
+  cout << "Total: " << tot.entries << " entries, " << tot.hammer_runs
+       << " HAMMER runs; deduplication saved " << tot.cache_hits << " runs ("
+       << pct(tot.cache_hits) << "%), pre-selection saved " << tot.presel_rej
+       << " runs (" << pct(tot.presel_rej) << "%), topology pre-check saved "
+       << tot.topo_rej << " runs (" << pct(tot.topo_rej) << "%)" << endl;
+  if (tot.weights > 0)
+    cout << "Sum of " << tot.weights << " weights: " << tot.sum_w
+         << ", sum of squares: " << tot.sum_w2 << ", effective entries: "
+         << tot.sum_w * tot.sum_w / tot.sum_w2 << endl;
+  if (tot.store_looks > 0)
+    cout << "Weight store: " << tot.store_hits << " of " << tot.store_looks
+         << " lookups hit (" << 100. * tot.store_hits / tot.store_looks
+         << "%), saving as many HAMMER runs; " << tot.store_new
+         << " new weights" << endl;
+  if (tot.hammer_runs > 0)
+    cout << "HAMMER processEvent and getWeight took " << tot.hammer_time
+         << " s, " << 1e6 * tot.hammer_time / tot.hammer_runs << " us per run"
+         << endl;
+  if (tot.collisions > 0)
+    cout << "WARNING: " << tot.collisions
+         << " entries share (runNumber, eventNumber) with a different truth "
+            "decay; they were reweighted separately."
+         << endl;
 }
 
+///////////////////
+// Pre-selection //
+///////////////////
+
+// Cheap pre-selection so that HAMMER only runs on events that could end up in
+// the fit. Both the cut and the event list are resolved before the event loop.
+class Preselection {
+ public:
+  bool enabled() const { return _has_cut || _has_list; }
+
+  // Evaluate 'expr' on the whole tree in one go with TTree::Draw; only the
+  // branches used in 'expr' are read.
+  void set_cut(TTree* tree, const string& expr) {
+    auto dir = gDirectory;
+    gROOT->cd();  // don't attach the entry list to any file
+
+    tree->Draw(">>presel_elist", expr.c_str(), "entrylist");
+    auto elist = gDirectory->Get<TEntryList>("presel_elist");
+
+    _mask.assign(tree->GetEntries(), false);
+    for (Long64_t i = 0; i < elist->GetN(); i++)
+      _mask[elist->GetEntry(i)] = true;
+
+    delete elist;
+    dir->cd();
+    _has_cut = true;
+  }
+
+  // Plain text file with one 'runNumber eventNumber' pair per line
+  void load_event_list(const string& path) {
+    ifstream input(path);
+    string   line;
+
+    while (getline(input, line)) {
+      if (line.empty() || line[0] == '#') continue;
+
+      istringstream fields(line);
+      UInt_t        run;
+      ULong64_t     evt;
+      if (fields >> run >> evt) _events.insert(EventKey{run, evt});
+    }
+
+    _has_list = true;
+  }
+
+  bool pass(Long64_t entry, const TruthEvent& evt) const {
+    if (_has_cut && !_mask[entry]) return false;
+    if (_has_list && !_events.count(EventKey{evt.runNumber, evt.eventNumber}))
+      return false;
+    return true;
+  }
+
+ private:
+  bool                                  _has_cut  = false;
+  bool                                  _has_list = false;
+  vector<bool>                          _mask;
+  unordered_set<EventKey, EventKeyHash> _events;
+};
+
 //////////////////////////////
 // Main reweighting routine //
 //////////////////////////////
 
-void reweight(TFile* input_file, TFile* output_file,
-              const char* tree        = "mc_dst_tau_aux",
-              const char* tree_output = "mc_dst_tau_ff_w") {
-  TTreeReader reader(tree, input_file);
-  TTree       output(tree_output, tree_output);
-
-  // Read input branches ///////////////////////////////////////////////////////
-  // General
-  TTreeReaderValue<ULong64_t> eventNumber(reader, "eventNumber");
-  TTreeReaderValue<UInt_t>    runNumber(reader, "runNumber");
-  // B
-  TTreeReaderValue<Int_t>    b_id(reader, "b_id");
-  TTreeReaderValue<Double_t> b_true_pe(reader, "b_true_pe");
-  TTreeReaderValue<Double_t> b_true_px(reader, "b_true_px");
-  TTreeReaderValue<Double_t> b_true_py(reader, "b_true_py");
-  TTreeReaderValue<Double_t> b_true_pz(reader, "b_true_pz");
-  // D*
-  TTreeReaderValue<Int_t>    dst_id(reader, "dst_id");
-  TTreeReaderValue<Double_t> dst_true_pe(reader, "dst_true_pe");
-  TTreeReaderValue<Double_t> dst_true_px(reader, "dst_true_px");
-  TTreeReaderValue<Double_t> dst_true_py(reader, "dst_true_py");
-  TTreeReaderValue<Double_t> dst_true_pz(reader, "dst_true_pz");
-  // D0
-  TTreeReaderValue<Int_t>    d0_id(reader, "d0_id");
-  TTreeReaderValue<Double_t> d0_true_pe(reader, "d0_true_pe");
-  TTreeReaderValue<Double_t> d0_true_px(reader, "d0_true_px");
-  TTreeReaderValue<Double_t> d0_true_py(reader, "d0_true_py");
-  TTreeReaderValue<Double_t> d0_true_pz(reader, "d0_true_pz");
-  // Mu
-  TTreeReaderValue<Int_t>    mu_id(reader, "mu_id");
-  TTreeReaderValue<Double_t> mu_true_pe(reader, "mu_true_pe");
-  TTreeReaderValue<Double_t> mu_true_px(reader, "mu_true_px");
-  TTreeReaderValue<Double_t> mu_true_py(reader, "mu_true_py");
-  TTreeReaderValue<Double_t> mu_true_pz(reader, "mu_true_pz");
-  // K
-  TTreeReaderValue<Int_t>    k_id(reader, "k_id");
-  TTreeReaderValue<Double_t> k_true_pe(reader, "k_true_pe");
-  TTreeReaderValue<Double_t> k_true_px(reader, "k_true_px");
-  TTreeReaderValue<Double_t> k_true_py(reader, "k_true_py");
-  TTreeReaderValue<Double_t> k_true_pz(reader, "k_true_pz");
-  // Pi
-  TTreeReaderValue<Int_t>    pi_id(reader, "pi_id");
-  TTreeReaderValue<Double_t> pi_true_pe(reader, "pi_true_pe");
-  TTreeReaderValue<Double_t> pi_true_px(reader, "pi_true_px");
-  TTreeReaderValue<Double_t> pi_true_py(reader, "pi_true_py");
-  TTreeReaderValue<Double_t> pi_true_pz(reader, "pi_true_pz");
-  // Slow Pi
-  TTreeReaderValue<Int_t>    spi_id(reader, "spi_id");
-  TTreeReaderValue<Double_t> spi_true_pe(reader, "spi_true_pe");
-  TTreeReaderValue<Double_t> spi_true_px(reader, "spi_true_px");
-  TTreeReaderValue<Double_t> spi_true_py(reader, "spi_true_py");
-  TTreeReaderValue<Double_t> spi_true_pz(reader, "spi_true_pz");
-  // Tau
-  TTreeReaderValue<Int_t>    tau_id(reader, "tau_id");
-  TTreeReaderValue<Double_t> tau_true_pe(reader, "tau_true_pe");
-  TTreeReaderValue<Double_t> tau_true_px(reader, "tau_true_px");
-  TTreeReaderValue<Double_t> tau_true_py(reader, "tau_true_py");
-  TTreeReaderValue<Double_t> tau_true_pz(reader, "tau_true_pz");
-  // Anti-Nu_Tau
-  TTreeReaderValue<Int_t>    anu_tau_id(reader, "anu_tau_id");
-  TTreeReaderValue<Double_t> anu_tau_true_pe(reader, "anu_tau_true_pe");
-  TTreeReaderValue<Double_t> anu_tau_true_px(reader, "anu_tau_true_px");
-  TTreeReaderValue<Double_t> anu_tau_true_py(reader, "anu_tau_true_py");
-  TTreeReaderValue<Double_t> anu_tau_true_pz(reader, "anu_tau_true_pz");
-  // Nu_Tau
-  TTreeReaderValue<Int_t>    nu_tau_id(reader, "nu_tau_id");
-  TTreeReaderValue<Double_t> nu_tau_true_pe(reader, "nu_tau_true_pe");
-  TTreeReaderValue<Double_t> nu_tau_true_px(reader, "nu_tau_true_px");
-  TTreeReaderValue<Double_t> nu_tau_true_py(reader, "nu_tau_true_py");
-  TTreeReaderValue<Double_t> nu_tau_true_pz(reader, "nu_tau_true_pz");
-  // Anti-Nu_Mu
-  TTreeReaderValue<Int_t>    anu_mu_id(reader, "anu_mu_id");
-  TTreeReaderValue<Double_t> anu_mu_true_pe(reader, "anu_mu_true_pe");
-  TTreeReaderValue<Double_t> anu_mu_true_px(reader, "anu_mu_true_px");
-  TTreeReaderValue<Double_t> anu_mu_true_py(reader, "anu_mu_true_py");
-  TTreeReaderValue<Double_t> anu_mu_true_pz(reader, "anu_mu_true_pz");
+// Copy all baskets of the input tree to the output file as-is, without
+// decompressing them. Input branches that clash with the reweighter's output
+// are not copied, as they will be recomputed.
+TTree* fast_clone_tree(TFile* input_file, TFile* output_file,
+                       const char* tree) {
+  auto input_tree = input_file->Get<TTree>(tree);
+
+  for (const auto& br : reweight_branches)
+    if (input_tree->GetBranch(br.c_str()))
+      input_tree->SetBranchStatus(br.c_str(), false);
+
+  output_file->cd();
+  auto output = input_tree->CloneTree(-1, "fast");
+
+  input_tree->SetBranchStatus("*", true);
+  return output;
+}
+
+// Progress of the live metrics, for one candidate per entry
+void count_entry(const EventResult& res) {
+  if (res.ok) metrics::live.weight(res.w_ff);
+  metrics::live.entry_done();
+}
+
+// Output branches of a weight tree, one candidate per entry.
+// NOTE: If 'fill_all' is set, every input entry gets an output entry (needed
+//       in fast-clone mode, where the output tree is a copy of the input with
+//       the weight branches appended)
+class WeightOutput {
+ public:
+  WeightOutput(TTree* output, bool fill_all)
+      : _output(output), _fill_all(fill_all) {
+    if (!fill_all) {
+      output->Branch("eventNumber", &_eventNumber);
+      output->Branch("runNumber", &_runNumber);
+    }
+
+    _new_branches = vector<TBranch*>{
+        output->Branch("w_ff", &_w_ff), output->Branch("q2_true", &_q2),
+        output->Branch("mm2_true", &_mm2), output->Branch("el_true", &_el)};
+  }
+
+  void fill(UInt_t run, ULong64_t evt, const EventResult& res) {
+    _runNumber   = run;
+    _eventNumber = evt;
+    _w_ff        = res.ok ? res.w_ff : w_ff_invalid;
+    _q2          = res.q2;
+    _mm2         = res.mm2;
+    _el          = res.el;
+
+    if (_fill_all)
+      for (auto br : _new_branches) br->Fill();
+    else if (res.ok)
+      _output->Fill();
+  }
+
+  void write() {
+    _output->Write("", TObject::kOverwrite);
+    delete _output;
+  }
+
+ private:
+  TTree*           _output;
+  bool             _fill_all;
+  vector<TBranch*> _new_branches;
+
+  ULong64_t _eventNumber;
+  UInt_t    _runNumber;
+  Double_t  _w_ff, _q2, _mm2, _el;
+};
+
+// 'first' is the input entry number of the first event of 'truth', if it only
+// reads a range of entries (see the MPI mode)
+template <class Source>
+ReweightStats reweight(Source& truth, TTree* output, Reweighter& rw,
+                       const Preselection& presel, bool fill_all = false,
+                       Long64_t first = 0) {
+  WeightOutput out(output, fill_all);
 
+  // NOTE: Events are read in blocks only to look up the weight store at once
+  auto               block_size = rw.store() ? lookup_block : 1;
+  vector<TruthEvent> block(block_size);
+  auto               next = [&] {
+    alloc_stats::Scope scope(alloc_stats::Input);
+    size_t             n = 0;
+    while (n < block_size && truth.next(block[n])) n++;
+    block.resize(n);
+    return n > 0;
+  };
+
+  for (Long64_t entry = first; next(); block.resize(block_size)) {
+    rw.lookup(block);
+    for (const auto& evt : block) {
+      auto res = rw.process(evt, presel.pass(entry++, evt));
+      count_entry(res);
+
+      alloc_stats::Scope scope(alloc_stats::Output);
+      out.fill(evt.runNumber, evt.eventNumber, res);
+    }
+  }
+
+  alloc_stats::Scope scope(alloc_stats::Output);
+  out.write();
+  return rw.take_stats();
+}
+
+// Same as 'reweight', but for ntuples with arrays of candidates per entry.
+// Every input entry gets an output entry, with one weight per candidate in the
+// same order; candidates that HAMMER can't process get 'w_ff_invalid'.
+// 'first' is the same as in 'reweight', and 'shared_event' as in
+// 'Reweighter::process'.
+template <class Source>
+ReweightStats reweight_multi(Source& truth, TTree* output, Reweighter& rw,
+                             const Preselection& presel, bool shared_event,
+                             bool fill_all = false, Long64_t first = 0) {
   // Define output branches ////////////////////////////////////////////////////
   ULong64_t eventNumber_out;
-  output.Branch("eventNumber", &eventNumber_out);
-  UInt_t runNumber_out;
-  output.Branch("runNumber", &runNumber_out);
-  Double_t w_ff_out;
-  output.Branch("w_ff", &w_ff_out);
-  Double_t q2_out;
-  output.Branch("q2_true", &q2_out);
-  Double_t mm2_out;
-  output.Branch("mm2_true", &mm2_out);
-  Double_t el_out;
-  output.Branch("el_true", &el_out);
-
-  // Setup HAMMER //////////////////////////////////////////////////////////////
-  Hammer::Hammer   ham{};
-  Hammer::IOBuffer ham_buf;
-
-  auto semi_tau_decay = vector<string>{"BD*TauNu", "TauEllNuNu"};
-
-  ham.includeDecay(semi_tau_decay);
-  ham.addFFScheme("SemiTauonic", {{"BD*", "CLN"}});
-  // ham.setOptions("BctoJpsiBGL: {dvec: [0., 0., 0.] }");
-  ham.setFFInputScheme({{"BD*", "ISGW2"}});
-
-  ham.setUnits("MeV");
-
-  ham.initRun();
-
-  while (reader.Next()) {
-    eventNumber_out = *eventNumber;
-    runNumber_out   = *runNumber;
-
-    // We need to fix the ID for B0's that oscillate to B~0
-    // a.k.a Manually fix 'wrong-sign' IDs
-    int b_id_fix;
-    if (*b_id * *dst_id > 0)
-      b_id_fix = -*b_id;
+  UInt_t    runNumber_out;
+  if (!fill_all) {
+    output->Branch("eventNumber", &eventNumber_out);
+    output->Branch("runNumber", &runNumber_out);
+  }
+
+  vector<Double_t> w_ff_out, q2_out, mm2_out, el_out;
+  auto             new_branches = vector<TBranch*>{
+      output->Branch("w_ff", &w_ff_out), output->Branch("q2_true", &q2_out),
+      output->Branch("mm2_true", &mm2_out), output->Branch("el_true", &el_out)};
+
+  vector<TruthEvent>  cands;
+  vector<bool>        selected;
+  vector<EventResult> res;
+  auto                next = [&] {
+    alloc_stats::Scope scope(alloc_stats::Input);
+    return truth.next(cands);
+  };
+
+  for (Long64_t entry = first; next(); entry++) {
+    eventNumber_out = cands.empty() ? 0 : cands[0].eventNumber;
+    runNumber_out   = cands.empty() ? 0 : cands[0].runNumber;
+
+    selected.clear();
+    for (const auto& evt : cands) selected.push_back(presel.pass(entry, evt));
+    rw.process(cands, selected, shared_event, res);
+
+    alloc_stats::Scope scope(alloc_stats::Output);
+    w_ff_out.clear();
+    q2_out.clear();
+    mm2_out.clear();
+    el_out.clear();
+    for (const auto& r : res) {
+      w_ff_out.push_back(r.ok ? r.w_ff : w_ff_invalid);
+      q2_out.push_back(r.q2);
+      mm2_out.push_back(r.mm2);
+      el_out.push_back(r.el);
+      if (r.ok) metrics::live.weight(r.w_ff);
+    }
+
+    if (fill_all)
+      for (auto br : new_branches) br->Fill();
     else
-      b_id_fix = *b_id;
-
-    // Compute q2, mm2, and el /////////////////////////////////////////////////
-
-    // Find B velocity in the lab frame
-    auto v_x = *b_true_px / *b_true_pe;
-    auto v_y = *b_true_py / *b_true_pe;
-    auto v_z = *b_true_pz / *b_true_pe;
-
-    // velocity of B in the lab frame
-    auto b_lab_v = TVector3(v_x, v_y, v_z);
-
-    // Compute q2 and el
-    TLorentzVector b_mom, dst_mom, mu_mom;
-    b_mom.SetPxPyPzE(*b_true_px, *b_true_py, *b_true_pz, *b_true_pe);
-    dst_mom.SetPxPyPzE(*dst_true_px, *dst_true_py, *dst_true_pz, *dst_true_pe);
-    mu_mom.SetPxPyPzE(*mu_true_px, *mu_true_py, *mu_true_pz, *mu_true_pe);
-    calc_true_fit_vars(q2_out, el_out, b_lab_v, b_mom, dst_mom, mu_mom);
-
-    // Compute mm2
-    TLorentzVector nu_tau_mom, anu_tau_mom, anu_mu_mom;
-    nu_tau_mom.SetPxPyPzE(*nu_tau_true_px, *nu_tau_true_py, *nu_tau_true_pz,
-                          *nu_tau_true_pe);
-    anu_tau_mom.SetPxPyPzE(*anu_tau_true_px, *anu_tau_true_py, *anu_tau_true_pz,
-                           *anu_tau_true_pe);
-    anu_mu_mom.SetPxPyPzE(*anu_mu_true_px, *anu_mu_true_py, *anu_mu_true_pz,
-                          *anu_mu_true_pe);
-    mm2_out = calc_mm2_with_nu({nu_tau_mom, anu_tau_mom, anu_mu_mom});
-
-    // Compute FF weight ///////////////////////////////////////////////////////
-
-    // Define MC truth particles for FF reweighting
-    auto B0 =
-        particle(*b_true_pe, *b_true_px, *b_true_py, *b_true_pz, b_id_fix);
-    auto Dst = particle(*dst_true_pe, *dst_true_px, *dst_true_py, *dst_true_pz,
-                        *dst_id);
-    auto SlowPi = particle(*spi_true_pe, *spi_true_px, *spi_true_py,
-                           *spi_true_pz, *spi_id);
-    auto D0 =
-        particle(*d0_true_pe, *d0_true_px, *d0_true_py, *d0_true_pz, *d0_id);
-    auto K = particle(*k_true_pe, *k_true_px, *k_true_py, *k_true_pz, *k_id);
-    auto Pi =
-        particle(*pi_true_pe, *pi_true_px, *pi_true_py, *pi_true_pz, *pi_id);
-    auto Mu =
-        particle(*mu_true_pe, *mu_true_px, *mu_true_py, *mu_true_pz, *mu_id);
-    auto Tau = particle(*tau_true_pe, *tau_true_px, *tau_true_py, *tau_true_pz,
-                        *tau_id);
-    auto Anti_Nu_Mu = particle(*anu_mu_true_pe, *anu_mu_true_px,
-                               *anu_mu_true_py, *anu_mu_true_pz, *anu_mu_id);
-    auto Anti_Nu_Tau =
-        particle(*anu_tau_true_pe, *anu_tau_true_px, *anu_tau_true_py,
-                 *anu_tau_true_pz, *anu_tau_id);
-    auto Nu_Tau = particle(*nu_tau_true_pe, *nu_tau_true_px, *nu_tau_true_py,
-                           *nu_tau_true_pz, *nu_tau_id);
-
-    Hammer::Process proc;
-    add_ham_part_Tau(proc, B0, Dst, D0, SlowPi, K, Pi, Tau, Anti_Nu_Tau, Nu_Tau,
-                     Mu, Anti_Nu_Mu);
-
-    ham.initEvent();
-    auto proc_id = ham.addProcess(proc);
-
-    if (proc_id != 0) {
-      ham.processEvent();
-      w_ff_out = ham.getWeight("SemiTauonic");
-
-      if (w_ff_out > 10) {
-        std::cout << "Problematic weight of " << w_ff_out << " at "
-                  << *eventNumber << std::endl;
+      output->Fill();
+    metrics::live.entry_done();
+  }
+
+  alloc_stats::Scope scope(alloc_stats::Output);
+  output->Write("", TObject::kOverwrite);
+  delete output;
+
+  return rw.take_stats();
+}
+
+/////////////
+// Preview //
+/////////////
+
+struct PreviewOptions {
+  Long64_t samples;  // entries to reweight, in all strata
+  int      strata;
+  uint64_t seed;
+};
+
+// Comparison histograms of the true fit variables before and after the FF
+// weights, extrapolated to the whole tree
+class PreviewHistos {
+ public:
+  PreviewHistos(const string& tree) {
+    add(tree + "_q2", "q^{2} [GeV^{2}]", 50, 2.5, 12);
+    add(tree + "_mm2", "m_{miss}^{2} [GeV^{2}]", 50, -2, 10);
+    add(tree + "_el", "E_{l} [GeV]", 50, 0, 2.6);
+  }
+
+  void fill(const EventResult& res, double expansion) {
+    Double_t vals[] = {res.q2, res.mm2, res.el};
+    for (auto i = 0; i < 3; i++) {
+      _raw[i]->Fill(vals[i], expansion);
+      _ff[i]->Fill(vals[i], expansion * res.w_ff);
+    }
+  }
+
+ private:
+  vector<TH1D*> _raw, _ff;  // owned by the output file
+
+  void add(const string& name, const string& title, int nbins, double lo,
+           double hi) {
+    auto raw = name + "_raw", ff = name + "_ff";
+    _raw.push_back(
+        new TH1D(raw.c_str(), (title + ", ISGW2").c_str(), nbins, lo, hi));
+    _ff.push_back(
+        new TH1D(ff.c_str(), (title + ", CLN").c_str(), nbins, lo, hi));
+    _raw.back()->Sumw2();
+    _ff.back()->Sumw2();
+  }
+};
+
+// Reweight a stratified subsample (see 'preview_sample.h') and extrapolate the
+// sum of weights and the effective sample size to the whole tree, without
+// writing any weight tree. Entries that HAMMER can't process count as 0.
+template <class Source>
+ReweightStats reweight_preview(Source& truth, const vector<Long64_t>& bounds,
+                               const string& tree, Reweighter& rw,
+                               const Preselection&   presel,
+                               const PreviewOptions& opts) {
+  enum { Reweighted = 0, SumW, SumW2 };
+
+  mt19937_64 rng(opts.seed);
+  auto       strata = preview::plan(bounds, opts.samples, opts.strata, rng);
+
+  preview::Totals<3> totals{};
+  PreviewHistos      histos(tree);
+  TruthEvent         evt;
+
+  for (const auto& s : strata)
+    metrics::add(metrics::live.expected, int64_t(s.entries.size()));
+
+  auto start = chrono::steady_clock::now();
+  for (const auto& s : strata) {
+    totals.add_stratum(s);
+    for (auto entry : s.entries) {
+      {
+        alloc_stats::Scope scope(alloc_stats::Input);
+        truth.load(entry, evt);
+      }
+      auto res = rw.process(evt, presel.pass(entry, evt));
+      count_entry(res);
+      if (!res.ok) {
+        totals.add({0, 0, 0});
+        continue;
+      }
+
+      totals.add({1, res.w_ff, res.w_ff * res.w_ff});
+      histos.fill(res, s.expansion());
+    }
+  }
+  auto seconds = seconds_since(start);
+  auto stats   = rw.take_stats();
+
+  // Errors of ratios of totals from their gradients
+  auto   entries = bounds.back();
+  auto   tot     = totals.total();
+  double ess = 0, ess_err = 0, mean_w = 0, mean_err = 0;
+  if (tot[SumW2] > 0) {
+    ess     = tot[SumW] * tot[SumW] / tot[SumW2];
+    ess_err = totals.error({0, 2 * tot[SumW] / tot[SumW2], -ess / tot[SumW2]});
+  }
+  if (tot[Reweighted] > 0) {
+    mean_w   = tot[SumW] / tot[Reweighted];
+    mean_err =
+        totals.error({-mean_w / tot[Reweighted], 1 / tot[Reweighted], 0});
+  }
+
+  cout << "Preview of " << tree << ": " << stats.entries << " of " << entries
+       << " entries, from " << strata.size() << " clusters, in " << seconds
+       << " s" << endl;
+  cout << "  reweighted entries:    " << tot[Reweighted] << " +- "
+       << totals.error(Reweighted) << endl;
+  cout << "  sum of w_ff:           " << tot[SumW] << " +- "
+       << totals.error(SumW) << endl;
+  cout << "  mean w_ff:             " << mean_w << " +- " << mean_err << endl;
+  cout << "  effective sample size: " << ess << " +- " << ess_err << endl;
+  if (stats.entries > 0)
+    cout << "  full run:              about "
+         << seconds * entries / stats.entries << " s" << endl;
+
+  return stats;
+}
+
+/////////////////////////////////////
+// Fork-based parallel reweighting //
+/////////////////////////////////////
+
+// Result of one entry, streamed from a worker to the writer
+struct WorkerRecord {
+  UInt_t      run;
+  ULong64_t   evt;
+  EventResult res;
+  bool        cache;  // new truth decay for the worker, so cache it
+};
+
+// Written by each worker once it's done
+struct WorkerReport {
+  ReweightStats         stats;
+  truth_topology::Stats topo;
+  alloc_stats::Counters alloc;
+  perf::Totals          perf;
+  shm::MemUsage         mem;
+  double                seconds;
+};
+
+struct ForkOptions {
+  int                 jobs;
+  Long64_t            chunk;                // entries per work unit
+  double              init_seconds;         // time spent in 'setup_hammer'
+  metrics::Publisher* publisher = nullptr;  // paused while forking
+};
+
+void print_fork_report(const ForkOptions& opts, const WorkerReport* reports,
+                       Long64_t entries, double seconds,
+                       const shm::MemUsage& parent_mem) {
+  auto mib = [](int64_t kb) { return kb / 1024.; };
+
+  cout << "Forked " << opts.jobs << " workers: " << entries << " entries in "
+       << seconds << " s (" << entries / seconds << " entries/s)" << endl;
+  cout << left << setw(10) << "Process" << right << setw(14) << "RSS [MiB]"
+       << setw(14) << "PSS [MiB]" << setw(18) << "peak RSS [MiB]" << setw(14)
+       << "entries/s" << endl;
+  cout << left << setw(10) << "writer" << right << setw(14)
+       << mib(parent_mem.rss_kb) << setw(14) << mib(parent_mem.pss_kb)
+       << setw(18) << mib(parent_mem.peak_rss_kb) << endl;
+
+  int64_t tot_pss = parent_mem.pss_kb;
+  int64_t tot_rss = 0;
+  for (auto w = 0; w < opts.jobs; w++) {
+    const auto& rep = reports[w];
+    cout << left << setw(10) << "worker " + to_string(w) << right << setw(14)
+         << mib(rep.mem.rss_kb) << setw(14) << mib(rep.mem.pss_kb) << setw(18)
+         << mib(rep.mem.peak_rss_kb) << setw(14)
+         << rep.stats.entries / rep.seconds << endl;
+    tot_pss += rep.mem.pss_kb;
+    tot_rss += rep.mem.peak_rss_kb;
+  }
+
+  // NOTE: An independent process would hold all the pages a worker only
+  //       shares, so its footprint is about the worker's peak RSS.
+  cout << "Total PSS: " << mib(tot_pss) << " MiB; " << opts.jobs
+       << " independent processes would need about " << mib(tot_rss)
+       << " MiB, and " << opts.jobs * opts.init_seconds
+       << " s of HAMMER initialization instead of " << opts.init_seconds
+       << " s." << endl;
+}
+
+// Whether 'pid' has exited, without reaping it, so that its exit status is
+// still there for the final 'waitpid'
+bool exited(pid_t pid) {
+  siginfo_t info{};
+  return waitid(P_PID, pid, &info, WEXITED | WNOHANG | WNOWAIT) != 0 ||
+         info.si_pid != 0;
+}
+
+// Workers that the parent hasn't reaped yet; all are killed and reaped when
+// the parent gives up, e.g. on an exception, so that none is left behind
+struct ForkedWorkers {
+  vector<pid_t> pids{};
+
+  ~ForkedWorkers() {
+    for (auto pid : pids)
+      if (pid > 0) kill(pid, SIGKILL);
+    for (auto pid : pids)
+      if (pid > 0) waitpid(pid, nullptr, 0);
+  }
+};
+
+// The parent initializes HAMMER once and forks 'opts.jobs' workers, which
+// inherit it copy-on-write. Entries are dealt out round-robin in chunks, so
+// that the parent, as the single writer, can drain the rings in entry order
+// while all workers stay busy.
+// NOTE: 'make_source' is called in each worker, so that each one reopens the
+//       input instead of sharing a file offset with its siblings.
+template <class MakeSource>
+ReweightStats reweight_forked(MakeSource make_source, Long64_t num_of_entries,
+                              TTree* output, Reweighter& rw,
+                              const Preselection& presel,
+                              const ForkOptions& opts, bool fill_all = false) {
+  using Clock = chrono::steady_clock;
+
+  vector<unique_ptr<shm::SpscRing<WorkerRecord>>> rings{};
+  for (auto w = 0; w < opts.jobs; w++)
+    rings.emplace_back(new shm::SpscRing<WorkerRecord>(4 * opts.chunk));
+  auto reports = shm::alloc<WorkerReport>(opts.jobs);
+
+  auto start = Clock::now();
+  cout.flush();  // otherwise pending output is printed by every worker
+
+  // NOTE: Workers inherit the held lock, but never use the publisher
+  auto paused =
+      opts.publisher ? opts.publisher->pause() : unique_lock<mutex>{};
+
+  ForkedWorkers workers{};
+  auto&         pids   = workers.pids;
+  auto          parent = getpid();
+  for (auto w = 0; w < opts.jobs; w++) {
+    auto pid = fork();
+    if (pid < 0) throw runtime_error("Can't fork worker " + to_string(w));
+
+    if (pid == 0) {
+      // NOTE: Don't outlive the parent, e.g. if it is killed
+      prctl(PR_SET_PDEATHSIG, SIGKILL);
+      if (getppid() != parent) _exit(1);
+
+      auto status = 0;
+      try {
+        // NOTE: The parent's counters are inherited, and so is the live
+        //       metrics hook, whose state only the parent publishes
+        rw.take_stats();
+        rw.topology()         = {};
+        alloc_stats::counters = {};
+        if (alloc_stats::hook == &metrics::live)
+          alloc_stats::hook = metrics::live.next;
+        if (perf::counters.is_open() && !perf::counters.open())
+          alloc_stats::hook = nullptr;
+        auto truth = make_source();
+
+        vector<TruthEvent> chunk{};
+        for (Long64_t first = w * opts.chunk; first < num_of_entries;
+             first += opts.jobs * opts.chunk) {
+          auto last = min(first + opts.chunk, num_of_entries);
+
+          {
+            alloc_stats::Scope scope(alloc_stats::Input);
+            chunk.resize(last - first);
+            for (auto entry = first; entry < last; entry++)
+              truth->load(entry, chunk[entry - first]);
+          }
+          rw.lookup(chunk);
+
+          for (auto entry = first; entry < last; entry++) {
+            const auto& evt        = chunk[entry - first];
+            auto        cache_size = rw.cache().size();
+            auto        res = rw.process(evt, presel.pass(entry, evt));
+            rings[w]->push({evt.runNumber, evt.eventNumber, res,
+                            rw.cache().size() > cache_size});
+          }
+        }
+        // NOTE: Serialized with the other workers by the store's file lock
+        rw.flush_store();
+
+        chrono::duration<double> elapsed = Clock::now() - start;
+        reports[w] = WorkerReport{rw.take_stats(), rw.topology(),
+                                  alloc_stats::counters, perf::counters.totals,
+                                  shm::mem_usage(), elapsed.count()};
+      } catch (const exception& e) {
+        cerr << "Worker " << w << ": " << e.what() << endl;
+        status = 1;
       }
 
-      output.Fill();
+      rings[w]->close();
+      cout.flush();
+      // NOTE: Skip all destructors, as the output file belongs to the parent
+      _exit(status);
     }
+
+    pids.push_back(pid);
+  }
+  if (paused.owns_lock()) paused.unlock();
+
+  // Single writer /////////////////////////////////////////////////////////////
+  auto         output_mem = shm::mem_usage();  // while the workers share pages
+  WeightOutput out(output, fill_all);
+  WorkerRecord rec;
+
+  for (Long64_t entry = 0; entry < num_of_entries; entry++) {
+    auto w = (entry / opts.chunk) % opts.jobs;
+
+    while (!rings[w]->try_pop(rec)) {
+      // A worker that crashed never closes its ring
+      if (rings[w]->closed() || exited(pids[w])) {
+        if (rings[w]->try_pop(rec)) break;
+        throw runtime_error("Worker " + to_string(w) +
+                            " stopped before entry " + to_string(entry));
+      }
+      sched_yield();
+    }
+
+    metrics::live.set_queue(w, rings[w]->size());
+    count_entry(rec.res);
+
+    {
+      alloc_stats::Scope scope(alloc_stats::Output);
+      out.fill(rec.run, rec.evt, rec.res);
+    }
+    if (rec.cache) rw.cache().emplace(EventKey{rec.run, rec.evt}, rec.res);
+  }
+
+  out.write();
+
+  for (auto w = 0; w < opts.jobs; w++) {
+    auto status = 0;
+    auto reaped = waitpid(pids[w], &status, 0) == pids[w];
+    if (reaped) pids[w] = 0;
+    if (!reaped || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+      throw runtime_error("Worker " + to_string(w) + " failed");
+  }
+
+  chrono::duration<double> elapsed = Clock::now() - start;
+
+  ReweightStats stats{};
+  for (auto w = 0; w < opts.jobs; w++) {
+    stats += reports[w].stats;
+    rw.topology() += reports[w].topo;
+    alloc_stats::counters += reports[w].alloc;
+    perf::counters.totals += reports[w].perf;
   }
 
-  output_file->Write("", TObject::kOverwrite);
+  print_fork_report(opts, reports, num_of_entries, elapsed.count(), output_mem);
+  shm::free(reports, opts.jobs);
+
+  return stats;
+}
+
+/////////////////////////////////
+// MPI-distributed reweighting //
+/////////////////////////////////
+
+// Rank of this process and number of ranks; 0 and 1 without MPI
+int mpi_rank = 0;
+int mpi_size = 1;
+
+// Contiguous share [first, last) of 'n' items (entries or input files) of
+// 'rank', so that the shards, in rank order, follow the input order
+pair<Long64_t, Long64_t> rank_range(Long64_t n, int rank, int size) {
+  return {n * rank / size, n * (rank + 1) / size};
+}
+
+string output_stem(const string& output) {
+  auto ext = output.rfind(".root");
+  return ext == string::npos ? output : output.substr(0, ext);
 }
 
-int main(int, char** argv) {
-  TFile* input_file  = new TFile(argv[1], "read");
-  TFile* output_file = new TFile(argv[2], "recreate");
+// Output of a rank, e.g. gen/rdst-run1-ff_w.root -> gen/rdst-run1-ff_w.3.root
+string shard_path(const string& output, int rank) {
+  return output_stem(output) + "." + to_string(rank) + ".root";
+}
 
-  reweight(input_file, output_file);
+#ifdef WITH_MPI
 
-  delete input_file;
-  delete output_file;
+// Per tree, written by every rank and gathered on rank 0
+struct ShardTree {
+  Long64_t      first, last;  // entry range, -1 if the rank reads whole files
+  ReweightStats stats;
+};
+
+// Once per rank
+struct RankReport {
+  truth_topology::Stats topo;
+  alloc_stats::Counters alloc;
+  perf::Totals          perf;
+  double                seconds;
+};
+
+// Rank 0 lists every shard with its input, entries and sums of weights, and
+// the totals
+void write_manifest(const string& path, const string& output,
+                    const vector<string>& inputs, bool by_file,
+                    const vector<string>& trees, const vector<ShardTree>& all,
+                    const vector<RankReport>& reports,
+                    const vector<ReweightStats>& totals) {
+  ofstream out(path);
+  out << setprecision(17);
+
+  auto sums = [&](const ReweightStats& s) {
+    out << "\"entries\": " << s.entries << ", \"weights\": " << s.weights
+        << ", \"sum_w\": " << s.sum_w << ", \"sum_w2\": " << s.sum_w2;
+  };
+
+  out << "{\n  \"ranks\": " << mpi_size << ",\n  \"shards\": [\n";
+  for (auto r = 0; r < mpi_size; r++) {
+    out << "    {\"rank\": " << r << ", \"path\": \"" << shard_path(output, r)
+        << "\", \"seconds\": " << reports[r].seconds << ", \"inputs\": [";
+    auto files = by_file ? rank_range(inputs.size(), r, mpi_size)
+                         : pair<Long64_t, Long64_t>{0, 1};
+    for (auto f = files.first; f < files.second; f++)
+      out << (f > files.first ? ", " : "") << "\"" << inputs[f] << "\"";
+    out << "],\n     \"trees\": {";
+
+    for (auto t = 0ul; t < trees.size(); t++) {
+      const auto& shard = all[r * trees.size() + t];
+      out << (t > 0 ? ", " : "") << "\"" << trees[t] << "\": {";
+      if (!by_file)
+        out << "\"first\": " << shard.first << ", \"last\": " << shard.last
+            << ", ";
+      sums(shard.stats);
+      out << "}";
+    }
+    out << "}}" << (r + 1 < mpi_size ? "," : "") << "\n";
+  }
+
+  out << "  ],\n  \"totals\": {";
+  for (auto t = 0ul; t < trees.size(); t++) {
+    out << (t > 0 ? ", " : "") << "\"" << trees[t] << "\": {";
+    sums(totals[t]);
+    out << "}";
+  }
+  out << "}\n}\n";
+}
+
+// Collect the stats of all ranks on rank 0, which replaces 'stats' and the
+// counters with their sums, and writes the manifest of the shards.
+// NOTE: Sums are taken on rank 0 in rank order, instead of with MPI_Reduce,
+//       so that they don't depend on how the MPI implementation reduces.
+void gather_ranks(const vector<string>& trees, vector<ReweightStats>& stats,
+                  const vector<pair<Long64_t, Long64_t>>& ranges,
+                  truth_topology::Stats& topo_stats, double seconds,
+                  const string& output, const vector<string>& inputs,
+                  bool by_file) {
+  vector<ShardTree> mine{};
+  for (auto t = 0ul; t < trees.size(); t++)
+    mine.push_back({ranges[t].first, ranges[t].second, stats[t]});
+  RankReport report{topo_stats, alloc_stats::counters, perf::counters.totals,
+                    seconds};
+
+  vector<ShardTree>  all(mpi_rank == 0 ? mpi_size * trees.size() : 0);
+  vector<RankReport> reports(mpi_rank == 0 ? mpi_size : 0);
+  MPI_Gather(mine.data(), mine.size() * sizeof(ShardTree), MPI_BYTE,
+             all.data(), mine.size() * sizeof(ShardTree), MPI_BYTE, 0,
+             MPI_COMM_WORLD);
+  MPI_Gather(&report, sizeof(RankReport), MPI_BYTE, reports.data(),
+             sizeof(RankReport), MPI_BYTE, 0, MPI_COMM_WORLD);
+
+  // The slowest rank sets the wall time of the whole job
+  double wall = 0;
+  MPI_Reduce(&seconds, &wall, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+  if (mpi_rank != 0) return;
+
+  stats.assign(trees.size(), ReweightStats{});
+  topo_stats            = truth_topology::Stats{};
+  alloc_stats::counters = alloc_stats::Counters{};
+  perf::counters.totals = perf::Totals{};
+  for (auto r = 0; r < mpi_size; r++) {
+    for (auto t = 0ul; t < trees.size(); t++)
+      stats[t] += all[r * trees.size() + t].stats;
+    topo_stats += reports[r].topo;
+    alloc_stats::counters += reports[r].alloc;
+    perf::counters.totals += reports[r].perf;
+  }
+
+  auto manifest = output_stem(output) + ".manifest.json";
+  write_manifest(manifest, output, inputs, by_file, trees, all, reports,
+                 stats);
+
+  cout << mpi_size << " ranks done in " << wall << " s; shards are listed in "
+       << manifest << endl;
+}
+
+#endif
+
+int run(int argc, char** argv) {
+  cxxopts::Options argopts("rdx-run1-sample",
+                           "FF reweighting for R(D(*)) run 1 ntuples.");
+
+  // clang-format off
+  argopts.add_options()
+    ("h,help", "print help")
+    ("input", "specify input ntuple, or a truth cache made by "
+              "build_truth_cache.u; a glob or '@list.txt' (one path per line) "
+              "for multiple ntuples", cxxopts::value<string>())
+    ("output", "specify output ntuple", cxxopts::value<string>())
+    ("t,trees", "specify input trees; truth events shared among them are "
+                "reweighted only once",
+     cxxopts::value<vector<string>>()->default_value("mc_dst_tau_aux"))
+    ("fast-clone", "copy the input trees to the output with the weights "
+                   "appended, instead of writing separate weight trees")
+    ("s,selection", "only reweight entries passing this cut on the input "
+                    "tree", cxxopts::value<string>())
+    ("e,event-list", "only reweight events listed in this file, one "
+                     "'runNumber eventNumber' per line",
+     cxxopts::value<string>())
+    ("m,multi-cand", "input truth branches are arrays of candidates; write "
+                     "array-valued weight branches aligned with them")
+    ("shared-event", "with --multi-cand, process all candidates of an entry "
+                     "in a single HAMMER event")
+    ("j,jobs", "fork this many workers sharing one initialized HAMMER",
+     cxxopts::value<int>()->default_value("1"))
+    ("chunk", "specify the number of consecutive entries per work unit of "
+              "a worker", cxxopts::value<Long64_t>()->default_value("1000"))
+    ("freeze-wc", "specify HAMMER WC processes whose Wilson coefficients are "
+                  "fixed for the whole run, e.g. BtoCTauNu",
+     cxxopts::value<vector<string>>())
+    ("wc", "specify the frozen Wilson coefficients as name=re[:im]",
+     cxxopts::value<vector<string>>()->default_value("SM=1"))
+    ("topo-tol", "specify the four-momentum tolerance (MeV) of the truth "
+                 "topology pre-check",
+     cxxopts::value<double>()->default_value("1"))
+    ("weight-store", "look up FF weights in this file first, keyed by truth "
+                     "kinematics, and add the new ones to it; shared by all "
+                     "runs with the same HAMMER settings",
+     cxxopts::value<string>())
+    ("alloc-stats", "count heap allocations and time per stage of the event "
+                    "loop")
+    ("perf-counters", "read hardware counters (cycles, instructions, cache "
+                      "and branch misses) per stage of the event loop")
+    ("no-prefetch", "with multiple input files, don't open the next file in "
+                    "the background")
+    ("prefetch-mb", "specify how many MiB of each end of the next local "
+                    "input file are read into the page cache",
+     cxxopts::value<size_t>()->default_value("64"))
+    ("preview", "only reweight a stratified random subsample of about this "
+                "many entries, spread over clusters; print the extrapolated "
+                "sum of weights and effective sample size, and write q2, mm2 "
+                "and el histograms instead of weight trees",
+     cxxopts::value<Long64_t>())
+    ("preview-strata", "specify the number of strata (one cluster is read "
+                       "from each) of --preview",
+     cxxopts::value<int>()->default_value("50"))
+    ("preview-seed", "specify the random seed of --preview",
+     cxxopts::value<uint64_t>()->default_value("42"))
+    ("metrics", "periodically rewrite this file with progress, throughput, "
+                "time per stage, I/O and weight statistics, in the "
+                "Prometheus text format", cxxopts::value<string>())
+    ("metrics-interval", "specify the seconds between metrics updates",
+     cxxopts::value<double>()->default_value("10"))
+    ("progress", "print a progress line at every metrics update")
+  ;
+  // clang-format on
+
+  argopts.parse_positional({"input", "output"});
+  auto parsed_args = argopts.parse(argc, argv);
+
+  if (parsed_args.count("help") || !parsed_args.count("output")) {
+    cout << argopts.help() << endl;
+    return parsed_args.count("help") ? 0 : 1;
+  }
+
+  auto input_path = parsed_args["input"].as<string>();
+  auto input_paths = vector<string>{};
+  try {
+    input_paths = input_path[0] == '@'
+                      ? prefetch::read_list(input_path.substr(1))
+                      : prefetch::expand({input_path});
+  } catch (const exception& e) {
+    cerr << e.what() << endl;
+    return 1;
+  }
+  if (input_paths.empty()) {
+    cerr << "No input files in " << input_path << endl;
+    return 1;
+  }
+  input_path = input_paths[0];
+
+  auto output_path = parsed_args["output"].as<string>();
+  auto trees       = parsed_args["trees"].as<vector<string>>();
+  auto fast_clone  = parsed_args.count("fast-clone") > 0;
+  auto multi_file  = input_paths.size() > 1;
+  auto from_cache  = !multi_file && truth_cache::is_truth_cache(input_path);
+  auto topo_tol    = parsed_args["topo-tol"].as<double>();
+  auto store_path  = parsed_args.count("weight-store")
+                         ? parsed_args["weight-store"].as<string>()
+                         : string{};
+  auto multi_cand  = parsed_args.count("multi-cand") > 0;
+  auto shared_evt  = parsed_args.count("shared-event") > 0;
+  auto fork_opts   = ForkOptions{parsed_args["jobs"].as<int>(),
+                               parsed_args["chunk"].as<Long64_t>(), 0};
+
+  if (from_cache && fast_clone) {
+    cerr << "Fast cloning needs a ROOT input, not a truth cache." << endl;
+    return 1;
+  }
+  if (from_cache && parsed_args.count("selection")) {
+    cerr << "A selection cut needs a ROOT input; use an event list for truth "
+            "caches."
+         << endl;
+    return 1;
+  }
+  if (from_cache && multi_cand) {
+    cerr << "Truth caches store one candidate per entry; --multi-cand needs a "
+            "ROOT input."
+         << endl;
+    return 1;
+  }
+
+  if (multi_file && (fast_clone || fork_opts.jobs > 1)) {
+    cerr << "Multiple input files don't support --fast-clone and --jobs yet."
+         << endl;
+    return 1;
+  }
+
+  auto is_preview   = parsed_args.count("preview") > 0;
+  auto preview_opts = PreviewOptions{
+      is_preview ? parsed_args["preview"].as<Long64_t>() : 0,
+      parsed_args["preview-strata"].as<int>(),
+      parsed_args["preview-seed"].as<uint64_t>()};
+  if (is_preview &&
+      (multi_file || fast_clone || multi_cand || fork_opts.jobs > 1)) {
+    cerr << "--preview needs a single input, without --fast-clone, "
+            "--multi-cand and --jobs."
+         << endl;
+    return 1;
+  }
+  if (is_preview && (preview_opts.samples < 1 || preview_opts.strata < 1)) {
+    cerr << "--preview and --preview-strata must be positive." << endl;
+    return 1;
+  }
+
+  if (fork_opts.jobs > 1 && multi_cand) {
+    cerr << "--jobs doesn't support --multi-cand yet." << endl;
+    return 1;
+  }
+  if (fork_opts.jobs < 1 || fork_opts.chunk < 1) {
+    cerr << "--jobs and --chunk must be positive." << endl;
+    return 1;
+  }
+
+  // With MPI, each rank reads a contiguous range of the entries of every
+  // tree, or of the input files, and writes its own output shard
+  auto all_inputs   = input_paths;
+  auto output_shard = output_path;
+  if (mpi_size > 1) {
+    if (fast_clone || fork_opts.jobs > 1 || is_preview) {
+      cerr << "MPI mode doesn't support --fast-clone, --jobs and --preview."
+           << endl;
+      return 1;
+    }
+    if (multi_file && input_paths.size() < size_t(mpi_size)) {
+      cerr << "MPI mode needs at least as many input files as ranks." << endl;
+      return 1;
+    }
+
+    output_shard = shard_path(output_path, mpi_rank);
+    if (multi_file) {
+      auto files  = rank_range(all_inputs.size(), mpi_rank, mpi_size);
+      input_paths = vector<string>(all_inputs.begin() + files.first,
+                                   all_inputs.begin() + files.second);
+    }
+  }
+
+  Preselection presel{};
+  if (parsed_args.count("event-list"))
+    presel.load_event_list(parsed_args["event-list"].as<string>());
+
+  WCSettings frozen_wc{};
+  if (parsed_args.count("freeze-wc")) {
+    map<string, complex<double>> wc_values{};
+    try {
+      wc_values = parse_wc_values(parsed_args["wc"].as<vector<string>>());
+    } catch (const exception& e) {
+      cerr << e.what() << endl;
+      return 1;
+    }
+
+    for (const auto& proc : parsed_args["freeze-wc"].as<vector<string>>())
+      frozen_wc[proc] = wc_values;
+  }
+
+  alloc_stats::enabled = parsed_args.count("alloc-stats") > 0;
+  if (parsed_args.count("perf-counters")) {
+    if (perf::counters.open())
+      alloc_stats::hook = &perf::counters;
+    else
+      cerr << "WARNING: hardware counters unavailable, "
+           << perf::counters.error() << endl;
+  }
+
+  // NOTE: Stopped before the final report, so that the last update is complete
+  unique_ptr<metrics::Publisher> publisher{};
+  if (parsed_args.count("metrics") || parsed_args.count("progress")) {
+    metrics::live.next = alloc_stats::hook;
+    alloc_stats::hook  = &metrics::live;
+    publisher.reset(new metrics::Publisher(
+        parsed_args.count("metrics") ? parsed_args["metrics"].as<string>() : "",
+        parsed_args["metrics-interval"].as<double>(),
+        parsed_args.count("progress") > 0));
+    fork_opts.publisher = publisher.get();
+  }
+
+  auto                  init_start = chrono::steady_clock::now();
+  unique_ptr<Reweighter> rw_ptr;
+  try {
+    rw_ptr.reset(
+        new Reweighter(ReweighterOptions{frozen_wc, topo_tol, store_path}));
+  } catch (const exception& e) {
+    cerr << e.what() << endl;
+    return 1;
+  }
+  auto& rw               = *rw_ptr;
+  fork_opts.init_seconds = seconds_since(init_start);
+
+  vector<ReweightStats> stats{};
+
+  // Entries read of each tree
+  vector<pair<Long64_t, Long64_t>> ranges{};
+#ifdef WITH_MPI
+  auto run_start = chrono::steady_clock::now();
+#endif
+
+  if (from_cache) {
+    truth_cache::Reader truth_in(input_path);
+    CacheTruthSource    truth(truth_in);
+    trees = {truth_in.tree()};
+    rw.cache().reserve(truth.size());
+
+    auto range = rank_range(truth.size(), mpi_rank, mpi_size);
+    truth.set_range(range.first, range.second);
+    ranges.push_back(range);
+    if (!is_preview)
+      metrics::add(metrics::live.expected, int64_t(range.second - range.first));
+
+    TFile* output_file = new TFile(output_shard.c_str(), "recreate");
+    if (zombie(output_file, output_shard)) return 1;
+    auto   tree_output = weight_tree_name(truth_in.tree());
+
+    if (is_preview) {
+      // Truth caches are read through mmap, so any contiguous range will do
+      auto bounds = preview::uniform_bounds(truth.size(), 1000);
+      stats.push_back(reweight_preview(truth, bounds, truth_in.tree(), rw,
+                                       presel, preview_opts));
+      output_file->Write();
+    } else if (fork_opts.jobs > 1) {
+      auto output      = new TTree(tree_output.c_str(), tree_output.c_str());
+      auto make_source = [&] {
+        return unique_ptr<CacheTruthSource>(new CacheTruthSource(truth_in));
+      };
+      stats.push_back(reweight_forked(make_source, truth.size(), output, rw,
+                                      presel, fork_opts));
+    } else {
+      auto output = new TTree(tree_output.c_str(), tree_output.c_str());
+      stats.push_back(reweight(truth, output, rw, presel, false, range.first));
+    }
+    delete output_file;
+  } else if (multi_file) {
+    // All files are one stream per tree, written to the same output trees
+    prefetch::FilePrefetcher files(
+        input_paths, !parsed_args.count("no-prefetch"),
+        parsed_args["prefetch-mb"].as<size_t>() << 20);
+    TFile* output_file = new TFile(output_shard.c_str(), "recreate");
+    if (zombie(output_file, output_shard)) return 1;
+
+    for (const auto& tree : trees) {
+      auto tree_output = weight_tree_name(tree);
+      output_file->cd();
+      auto output = new TTree(tree_output.c_str(), tree_output.c_str());
+      ranges.emplace_back(-1, -1);
+
+      // NOTE: The entry numbers of the chain match those of the stream
+      if (parsed_args.count("selection")) {
+        TChain chain(tree.c_str());
+        for (const auto& path : input_paths) chain.Add(path.c_str());
+        presel.set_cut(&chain, parsed_args["selection"].as<string>());
+      }
+
+      if (multi_cand) {
+        MultiFileSource<ArrayTruthSource> truth(tree.c_str(), files);
+        stats.push_back(reweight_multi(truth, output, rw, presel, shared_evt));
+      } else {
+        MultiFileSource<TreeTruthSource> truth(tree.c_str(), files);
+        stats.push_back(reweight(truth, output, rw, presel));
+      }
+    }
+
+    delete output_file;
+    cout << "Opened " << files.num_opened() << " input files ("
+         << files.num_prefetched() << " prefetched), waiting "
+         << files.open_seconds() << " s in total for opens" << endl;
+  } else {
+    TFile* input_file = new TFile(input_path.c_str(), "read");
+    if (zombie(input_file, input_path)) return 1;
+    for (const auto& tree : trees)
+      if (!input_file->Get<TTree>(tree.c_str())) {
+        cerr << "No tree " << tree << " in " << input_path << endl;
+        return 1;
+      }
+
+    TFile* output_file = new TFile(output_shard.c_str(), "recreate");
+    if (zombie(output_file, output_shard)) return 1;
+
+    for (const auto& tree : trees) {
+      auto   input_tree = input_file->Get<TTree>(tree.c_str());
+      TTree* output     = nullptr;
+      if (is_preview)
+        output_file->cd();  // for the histograms
+      else if (fast_clone)
+        output = fast_clone_tree(input_file, output_file, tree.c_str());
+      else {
+        auto tree_output = weight_tree_name(tree);
+        output_file->cd();
+        output = new TTree(tree_output.c_str(), tree_output.c_str());
+      }
+
+      // Avoid rehashing in the event loop
+      auto entries = input_tree->GetEntries();
+      auto range   = rank_range(entries, mpi_rank, mpi_size);
+      rw.cache().reserve(rw.cache().size() + range.second - range.first);
+      ranges.push_back(range);
+      if (!is_preview)
+        metrics::add(metrics::live.expected,
+                     int64_t(range.second - range.first));
+
+      if (parsed_args.count("selection"))
+        presel.set_cut(input_tree, parsed_args["selection"].as<string>());
+
+      if (is_preview) {
+        TreeTruthSource truth(tree.c_str(), input_file);
+        auto bounds = preview::cluster_bounds(input_tree);
+        stats.push_back(
+            reweight_preview(truth, bounds, tree, rw, presel, preview_opts));
+      } else if (multi_cand) {
+        ArrayTruthSource truth(tree.c_str(), input_file);
+        truth.set_range(range.first, range.second);
+        stats.push_back(reweight_multi(truth, output, rw, presel, shared_evt,
+                                       fast_clone, range.first));
+      } else if (fork_opts.jobs > 1) {
+        // NOTE: Each worker leaks its input file, as it exits without cleanup
+        auto make_source = [&] {
+          auto file = new TFile(input_path.c_str(), "read");
+          return unique_ptr<TreeTruthSource>(
+              new TreeTruthSource(tree.c_str(), file));
+        };
+        stats.push_back(reweight_forked(make_source, input_tree->GetEntries(),
+                                        output, rw, presel, fork_opts,
+                                        fast_clone));
+      } else {
+        TreeTruthSource truth(tree.c_str(), input_file);
+        truth.set_range(range.first, range.second);
+        stats.push_back(
+            reweight(truth, output, rw, presel, fast_clone, range.first));
+      }
+    }
+
+    if (is_preview) output_file->Write();
+    delete input_file;
+    delete output_file;
+  }
+
+  publisher.reset();
+
+  // NOTE: Every rank merges its own new weights
+  if (rw.store()) {
+    try {
+      auto added = rw.flush_store();
+      if (mpi_rank == 0)
+        cout << "Weight store " << store_path << ": added " << added
+             << ", now " << rw.store()->size() << " weights" << endl;
+    } catch (const exception& e) {
+      // NOTE: The output is fine, but the weights computed here are lost
+      cerr << "Weight store " << store_path << ": " << e.what() << endl;
+      return 1;
+    }
+  }
+
+#ifdef WITH_MPI
+  if (mpi_size > 1) {
+    gather_ranks(trees, stats, ranges, rw.topology(), seconds_since(run_start),
+                 output_path, all_inputs, multi_file);
+    if (mpi_rank != 0) return 0;
+  }
+#endif
+
+  print_reweight_stats(trees, stats);
+  if (rw.topology().has_failures()) rw.topology().print();
+
+  Long64_t entries = 0;
+  for (const auto& s : stats) entries += s.entries;
+  if (alloc_stats::enabled) alloc_stats::counters.print(entries);
+  if (perf::counters.is_open()) perf::counters.totals.print(entries);
 
   return 0;
 }
+
+int main(int argc, char** argv) {
+#ifdef WITH_MPI
+  MPI_Init(&argc, &argv);
+  MPI_Comm_rank(MPI_COMM_WORLD, &mpi_rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &mpi_size);
+#endif
+
+  auto status = 1;
+  try {
+    status = run(argc, argv);
+  } catch (const exception& e) {
+    cerr << e.what() << endl;
+  }
+
+#ifdef WITH_MPI
+  // NOTE: A rank that fails on its own would leave the others waiting in
+  //       'gather_ranks' forever
+  if (status != 0 && mpi_size > 1) MPI_Abort(MPI_COMM_WORLD, status);
+  MPI_Finalize();
+#endif
+  return status;
+}
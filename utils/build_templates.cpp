@@ -0,0 +1,384 @@
+// Author: Yipeng Sun
+// License: GPLv2
+// Description: Fill 3D fit templates (e.g. in q2, mm2, El) for a list of
+//              weights in a single multi-threaded pass over a reco tree and
+//              its FF weight friend.
+// Last Change: Sun Oct 18, 2026 at 09:38 AM +0200
+//
+// Each thread reads a disjoint set of whole clusters with its own file handles
+// and formulas, and accumulates sum(w) and sum(w^2) of all templates into a
+// private dense array; the arrays are added up at the end. The bin of an entry
+// is found once and shared by all weights, so the cost of an extra weight is
+// two additions per entry, not another read of the data.
+
+#include <TFile.h>
+#include <TH3D.h>
+#include <TROOT.h>
+#include <TTree.h>
+#include <TTreeFormula.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <cxxopts.hpp>
+
+using namespace std;
+
+/////////////
+// Binning //
+/////////////
+
+struct Axis {
+  string expr;
+  int    n;
+  double lo, hi;
+
+  // Same convention as TAxis: 0 is underflow, n + 1 overflow
+  int find(double x) const {
+    if (!(x >= lo)) return 0;  // also catches NaN
+    if (x >= hi) return n + 1;
+    return 1 + static_cast<int>((x - lo) / (hi - lo) * n);
+  }
+};
+
+// Parse '(n,lo,hi)' or 'n,lo,hi', same as the binning in plot_ratio.py
+Axis parse_axis(const string& expr, string spec) {
+  spec.erase(remove_if(spec.begin(), spec.end(),
+                       [](char c) { return c == '(' || c == ')' || c == ' '; }),
+             spec.end());
+
+  auto first = spec.find(',');
+  auto last  = spec.rfind(',');
+  if (first == string::npos || first == last)
+    throw runtime_error("Invalid binning " + spec + ", expecting n,lo,hi");
+
+  auto axis = Axis{expr, stoi(spec.substr(0, first)),
+                   stod(spec.substr(first + 1, last - first - 1)),
+                   stod(spec.substr(last + 1))};
+  if (axis.n < 1 || !(axis.hi > axis.lo))
+    throw runtime_error("Invalid binning " + spec);
+  return axis;
+}
+
+// 'name=expr', or just a branch name
+struct Template {
+  string name;
+  string expr;
+};
+
+Template parse_template(const string& spec) {
+  auto eq = spec.find('=');
+  if (eq != string::npos) return {spec.substr(0, eq), spec.substr(eq + 1)};
+
+  auto name = spec;
+  for (auto& c : name)
+    if (!isalnum(c) && c != '_') c = '_';
+  return {name, spec};
+}
+
+//////////////////////
+// Threaded filling //
+//////////////////////
+
+struct Input {
+  string reco_path, reco_tree;
+  string weight_path, weight_tree;
+  bool   index;  // weight tree is not aligned with the reco tree
+  string cut;
+};
+
+// Entry ranges of whole clusters, about 'num_ranges' of them
+vector<pair<Long64_t, Long64_t>> cluster_ranges(TTree* tree, int num_ranges) {
+  auto entries = tree->GetEntries();
+  auto target  = max(1ll, entries / num_ranges);
+
+  vector<pair<Long64_t, Long64_t>> ranges{};
+  auto     cluster = tree->GetClusterIterator(0);
+  Long64_t first   = 0;
+  Long64_t start;
+
+  while ((start = cluster()) < entries) {
+    auto end = cluster.GetNextEntry();
+    if (end - first >= target || end >= entries) {
+      ranges.emplace_back(first, min(end, entries));
+      first = end;
+    }
+  }
+
+  return ranges;
+}
+
+// Sums of one thread, laid out as [bin][template], so that all templates of
+// an entry are next to each other
+struct Sums {
+  vector<double> w, w2;
+  Long64_t       entries = 0;
+
+  Sums(size_t num_bins, size_t num_templates)
+      : w(num_bins * num_templates, 0.), w2(num_bins * num_templates, 0.) {}
+
+  Sums& operator+=(const Sums& rhs) {
+    for (auto i = 0ul; i < w.size(); i++) {
+      w[i] += rhs.w[i];
+      w2[i] += rhs.w2[i];
+    }
+    entries += rhs.entries;
+    return *this;
+  }
+};
+
+class Filler {
+ public:
+  Filler(const Input& in, const vector<Axis>& axes,
+         const vector<Template>& templates)
+      : _axes(axes), _num_tpl(templates.size()) {
+    auto cut = in.cut;
+    _reco_file.reset(TFile::Open(in.reco_path.c_str(), "read"));
+    if (!_reco_file || _reco_file->IsZombie())
+      throw runtime_error("Can't open " + in.reco_path);
+    _tree = _reco_file->Get<TTree>(in.reco_tree.c_str());
+    if (!_tree) throw runtime_error("No tree " + in.reco_tree);
+
+    if (!in.weight_path.empty()) {
+      _weight_file.reset(TFile::Open(in.weight_path.c_str(), "read"));
+      if (!_weight_file || _weight_file->IsZombie())
+        throw runtime_error("Can't open " + in.weight_path);
+      auto weights = _weight_file->Get<TTree>(in.weight_tree.c_str());
+      if (!weights) throw runtime_error("No tree " + in.weight_tree);
+
+      if (in.index) weights->BuildIndex("runNumber", "eventNumber");
+      _tree->AddFriend(weights);
+
+      // NOTE: Reco entries that join_weights.u found no weight for only carry
+      //       its '--miss-value', so they are left out of all templates
+      if (!in.index && weights->GetBranch("matched"))
+        cut = cut.empty() ? in.weight_tree + ".matched"
+                          : "(" + cut + ") && " + in.weight_tree + ".matched";
+    }
+
+    auto formula = [&](const string& expr) {
+      auto f = new TTreeFormula(expr.c_str(), expr.c_str(), _tree);
+      if (f->GetNdim() == 0) throw runtime_error("Invalid expression " + expr);
+      _formulas.emplace_back(f);
+      return f;
+    };
+
+    for (const auto& axis : axes) _vars.push_back(formula(axis.expr));
+    for (const auto& tpl : templates) _weights.push_back(formula(tpl.expr));
+    if (!cut.empty()) _cut = formula(cut);
+
+    _tree->SetCacheSize(64 << 20);
+    _tree->AddBranchToCache("*", true);
+  }
+
+  TTree* tree() { return _tree; }
+
+  void fill(Long64_t first, Long64_t last, Sums& sums) {
+    Long64_t filled = 0;  // not in 'sums', to avoid false sharing
+    _tree->SetCacheEntryRange(first, last);
+
+    for (auto entry = first; entry < last; entry++) {
+      _tree->LoadTree(entry);
+      for (auto& f : _formulas) f->GetNdata();  // reads the branches
+      if (_cut && _cut->EvalInstance() == 0) continue;
+
+      size_t bin = 0, stride = 1;
+      for (auto a = 0ul; a < _axes.size(); a++) {
+        bin += stride * _axes[a].find(_vars[a]->EvalInstance());
+        stride *= _axes[a].n + 2;
+      }
+
+      auto w  = &sums.w[bin * _num_tpl];
+      auto w2 = &sums.w2[bin * _num_tpl];
+      for (auto t = 0ul; t < _num_tpl; t++) {
+        auto x = _weights[t]->EvalInstance();
+        w[t] += x;
+        w2[t] += x * x;
+      }
+      filled++;
+    }
+
+    sums.entries += filled;
+  }
+
+ private:
+  const vector<Axis>& _axes;
+  size_t              _num_tpl;
+
+  // NOTE: The reco tree refers to the weight tree, so it's destroyed first
+  unique_ptr<TFile>                _weight_file, _reco_file;
+  TTree*                           _tree = nullptr;
+  vector<unique_ptr<TTreeFormula>> _formulas;
+  vector<TTreeFormula*>            _vars, _weights;
+  TTreeFormula*                    _cut = nullptr;
+};
+
+int main(int argc, char** argv) {
+  cxxopts::Options argopts(
+      "build_templates",
+      "Fill 3D fit templates for many weights in one threaded pass.");
+
+  // clang-format off
+  argopts.add_options()
+    ("h,help", "print help")
+    ("reco", "specify reco ntuple", cxxopts::value<string>())
+    ("output", "specify output ntuple", cxxopts::value<string>())
+    ("t,tree", "specify reco tree",
+     cxxopts::value<string>()->default_value("dst_iso"))
+    ("W,weight-ntuple", "specify weight ntuple, added as a friend",
+     cxxopts::value<string>())
+    ("T,weight-tree", "specify weight tree",
+     cxxopts::value<string>()->default_value("mc_dst_tau_ff_w"))
+    ("index", "match weights by (runNumber, eventNumber), instead of entry "
+              "number as for the output of join_weights.u")
+    ("w,weights", "specify template weights as 'name=expr' or a branch name; "
+                  "'1' for unweighted",
+     cxxopts::value<vector<string>>()->default_value("raw=1,w_ff"))
+    ("v,vars", "specify the 3 template variables (expressions)",
+     cxxopts::value<vector<string>>()
+     ->default_value("q2_true,mm2_true,el_true"))
+    ("b,bins", "specify the binning of each variable as n,lo,hi",
+     cxxopts::value<vector<string>>()
+     ->default_value("(4,-0.4,12.6),(40,-2,10.9),(36,0.1,2.65)"))
+    ("s,selection", "only fill entries passing this cut",
+     cxxopts::value<string>()->default_value(""))
+    ("p,prefix", "specify the prefix of the template names",
+     cxxopts::value<string>()->default_value("tpl"))
+    ("j,threads", "specify the number of threads",
+     cxxopts::value<unsigned>()->default_value(
+         to_string(max(1u, thread::hardware_concurrency()))))
+  ;
+  // clang-format on
+
+  argopts.parse_positional({"reco", "output"});
+  auto parsed_args = argopts.parse(argc, argv);
+
+  if (parsed_args.count("help") || !parsed_args.count("output")) {
+    cout << argopts.help() << endl;
+    return parsed_args.count("help") ? 0 : 1;
+  }
+
+  Input in{parsed_args["reco"].as<string>(),
+           parsed_args["tree"].as<string>(),
+           parsed_args.count("weight-ntuple")
+               ? parsed_args["weight-ntuple"].as<string>()
+               : "",
+           parsed_args["weight-tree"].as<string>(),
+           parsed_args.count("index") > 0,
+           parsed_args["selection"].as<string>()};
+
+  auto output_path = parsed_args["output"].as<string>();
+  auto prefix      = parsed_args["prefix"].as<string>();
+  auto vars        = parsed_args["vars"].as<vector<string>>();
+  auto bins        = parsed_args["bins"].as<vector<string>>();
+  auto num_threads = max(1u, parsed_args["threads"].as<unsigned>());
+
+  // NOTE: cxxopts splits vectors at commas, including those inside binnings
+  vector<string> bin_specs{};
+  for (auto i = 0ul; i + 2 < bins.size(); i += 3)
+    bin_specs.push_back(bins[i] + "," + bins[i + 1] + "," + bins[i + 2]);
+
+  if (vars.size() != 3 || bin_specs.size() != 3 || bins.size() != 9) {
+    cerr << "Expecting 3 variables, each with a n,lo,hi binning." << endl;
+    return 1;
+  }
+
+  vector<Axis>     axes{};
+  vector<Template> templates{};
+  try {
+    for (auto i = 0; i < 3; i++)
+      axes.push_back(parse_axis(vars[i], bin_specs[i]));
+    for (const auto& w : parsed_args["weights"].as<vector<string>>())
+      templates.push_back(parse_template(w));
+  } catch (const exception& e) {
+    cerr << e.what() << endl;
+    return 1;
+  }
+
+  size_t num_bins = 1;
+  for (const auto& axis : axes) num_bins *= axis.n + 2;
+
+  // Split the tree into work units of whole clusters //////////////////////////
+  ROOT::EnableThreadSafety();
+  auto start = chrono::steady_clock::now();
+
+  vector<pair<Long64_t, Long64_t>> ranges{};
+  try {
+    Filler probe(in, axes, templates);  // also validates all expressions
+    ranges = cluster_ranges(probe.tree(), 4 * num_threads);
+  } catch (const exception& e) {
+    cerr << e.what() << endl;
+    return 1;
+  }
+
+  // Fill //////////////////////////////////////////////////////////////////////
+  vector<Sums>   sums(num_threads, Sums(num_bins, templates.size()));
+  vector<thread> threads{};
+  atomic<size_t> next_range{0};
+  mutex          err_mutex;
+  string         error = "";
+
+  for (auto t = 0u; t < num_threads; t++) {
+    threads.emplace_back([&, t] {
+      try {
+        Filler filler(in, axes, templates);
+        for (auto r = next_range++; r < ranges.size(); r = next_range++)
+          filler.fill(ranges[r].first, ranges[r].second, sums[t]);
+      } catch (const exception& e) {
+        lock_guard<mutex> lock(err_mutex);
+        error = e.what();
+      }
+    });
+  }
+  for (auto& th : threads) th.join();
+
+  if (!error.empty()) {
+    cerr << error << endl;
+    return 1;
+  }
+
+  for (auto t = 1u; t < num_threads; t++) sums[0] += sums[t];
+  const auto& tot = sums[0];
+
+  chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+
+  // Write one TH3D per weight /////////////////////////////////////////////////
+  TFile output_file(output_path.c_str(), "recreate");
+
+  for (auto t = 0ul; t < templates.size(); t++) {
+    auto name = prefix + "_" + templates[t].name;
+    auto hist = new TH3D(name.c_str(), templates[t].expr.c_str(), axes[0].n,
+                         axes[0].lo, axes[0].hi, axes[1].n, axes[1].lo,
+                         axes[1].hi, axes[2].n, axes[2].lo, axes[2].hi);
+    hist->Sumw2();
+
+    // NOTE: Our bin layout is the same as TH3's global bin numbers
+    for (auto bin = 0ul; bin < num_bins; bin++) {
+      hist->SetBinContent(bin, tot.w[bin * templates.size() + t]);
+      hist->SetBinError(bin, sqrt(tot.w2[bin * templates.size() + t]));
+    }
+    hist->SetEntries(tot.entries);
+    hist->GetXaxis()->SetTitle(axes[0].expr.c_str());
+    hist->GetYaxis()->SetTitle(axes[1].expr.c_str());
+    hist->GetZaxis()->SetTitle(axes[2].expr.c_str());
+  }
+
+  output_file.Write();
+
+  cout << "Filled " << templates.size() << " templates of " << num_bins
+       << " bins from " << tot.entries << " entries in " << elapsed.count()
+       << " s (" << tot.entries / elapsed.count() << " entries/s, "
+       << ranges.size() << " cluster ranges on " << num_threads << " threads)"
+       << endl;
+
+  return 0;
+}
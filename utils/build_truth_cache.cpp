@@ -0,0 +1,133 @@
+// Author: Yipeng Sun
+// License: GPLv2
+// Description: Extract truth four-momenta and PDG IDs from a step 1 ntuple
+//              into a memory-mappable truth cache (see inc/truth_cache.h).
+// Last Change: Sat Oct 17, 2026 at 04:05 PM +0200
+
+#include <TFile.h>
+#include <TTree.h>
+#include <TTreeReader.h>
+#include <TTreeReaderValue.h>
+
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <cxxopts.hpp>
+
+#include "truth_cache.h"
+
+using namespace std;
+
+template <class T>
+using ReaderValues = vector<unique_ptr<TTreeReaderValue<T>>>;
+
+template <class T>
+void copy_mom(ReaderValues<Double_t>& vals, vector<T*>& cols, uint64_t i) {
+  for (auto p = 0ul; p < vals.size(); p++) cols[p][i] = **vals[p];
+}
+
+template <class T>
+vector<T*> mom_columns(truth_cache::Writer& writer, const string& comp) {
+  vector<T*> cols{};
+  for (const auto& prefix : truth_part_prefixes)
+    cols.push_back(writer.column<T>(prefix + "_true_" + comp));
+  return cols;
+}
+
+template <class T>
+void convert(TTreeReader& reader, truth_cache::Writer& writer) {
+  TTreeReaderValue<UInt_t>    runNumber(reader, "runNumber");
+  TTreeReaderValue<ULong64_t> eventNumber(reader, "eventNumber");
+
+  ReaderValues<Int_t>    ids{};
+  ReaderValues<Double_t> pe{}, px{}, py{}, pz{};
+  for (const auto& prefix : truth_part_prefixes) {
+    auto id_br = prefix + "_id";
+    auto mom   = [&](const char* comp) {
+      auto br = prefix + "_true_" + comp;
+      return new TTreeReaderValue<Double_t>(reader, br.c_str());
+    };
+
+    ids.emplace_back(new TTreeReaderValue<Int_t>(reader, id_br.c_str()));
+    pe.emplace_back(mom("pe"));
+    px.emplace_back(mom("px"));
+    py.emplace_back(mom("py"));
+    pz.emplace_back(mom("pz"));
+  }
+
+  auto run_col = writer.column<uint32_t>("runNumber");
+  auto evt_col = writer.column<uint64_t>("eventNumber");
+
+  vector<int32_t*> id_cols{};
+  for (const auto& prefix : truth_part_prefixes)
+    id_cols.push_back(writer.column<int32_t>(prefix + "_id"));
+
+  auto pe_cols = mom_columns<T>(writer, "pe");
+  auto px_cols = mom_columns<T>(writer, "px");
+  auto py_cols = mom_columns<T>(writer, "py");
+  auto pz_cols = mom_columns<T>(writer, "pz");
+
+  uint64_t i = 0;
+  while (reader.Next()) {
+    run_col[i] = *runNumber;
+    evt_col[i] = *eventNumber;
+
+    for (auto p = 0ul; p < ids.size(); p++) id_cols[p][i] = **ids[p];
+    copy_mom(pe, pe_cols, i);
+    copy_mom(px, px_cols, i);
+    copy_mom(py, py_cols, i);
+    copy_mom(pz, pz_cols, i);
+
+    i++;
+  }
+}
+
+int main(int argc, char** argv) {
+  cxxopts::Options argopts("build_truth_cache",
+                           "Extract truth kinematics into a truth cache.");
+
+  // clang-format off
+  argopts.add_options()
+    ("h,help", "print help")
+    ("input", "specify input ntuple", cxxopts::value<string>())
+    ("output", "specify output truth cache", cxxopts::value<string>())
+    ("t,tree", "specify input tree",
+     cxxopts::value<string>()->default_value("mc_dst_tau_aux"))
+    ("f,float", "store four-momenta as float32")
+  ;
+  // clang-format on
+
+  argopts.parse_positional({"input", "output"});
+  auto parsed_args = argopts.parse(argc, argv);
+
+  if (parsed_args.count("help") || !parsed_args.count("output")) {
+    cout << argopts.help() << endl;
+    return parsed_args.count("help") ? 0 : 1;
+  }
+
+  auto input_path  = parsed_args["input"].as<string>();
+  auto output_path = parsed_args["output"].as<string>();
+  auto tree        = parsed_args["tree"].as<string>();
+  auto f32         = parsed_args.count("float") > 0;
+
+  TFile*      input_file = new TFile(input_path.c_str(), "read");
+  TTreeReader reader(tree.c_str(), input_file);
+
+  auto num_of_evt = reader.GetTree()->GetEntries();
+  {
+    truth_cache::Writer writer(output_path, tree, num_of_evt,
+                               truth_cache::default_schema(f32));
+    if (f32)
+      convert<float>(reader, writer);
+    else
+      convert<double>(reader, writer);
+  }
+
+  cout << "Wrote " << num_of_evt << " entries of " << tree << " to "
+       << output_path << endl;
+
+  delete input_file;
+  return 0;
+}
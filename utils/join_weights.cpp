@@ -0,0 +1,296 @@
+// Author: Yipeng Sun
+// License: GPLv2
+// Description: Join a FF weight ntuple onto a reco tree with a single
+//              sort-merge pass, producing a positional (index-free) friend.
+// Last Change: Sat Oct 17, 2026 at 02:07 PM +0200
+
+#include <TBranch.h>
+#include <TFile.h>
+#include <TLeaf.h>
+#include <TObjArray.h>
+#include <TTree.h>
+#include <TTreeReader.h>
+#include <TTreeReaderValue.h>
+
+#include <algorithm>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <cxxopts.hpp>
+
+using namespace std;
+
+////////////////////
+// Join key types //
+////////////////////
+
+struct EventKey {
+  UInt_t    run;
+  ULong64_t evt;
+
+  bool operator<(const EventKey& rhs) const {
+    return run < rhs.run || (run == rhs.run && evt < rhs.evt);
+  }
+  bool operator==(const EventKey& rhs) const {
+    return run == rhs.run && evt == rhs.evt;
+  }
+};
+
+struct KeyedEntry {
+  EventKey key;
+  Long64_t entry;
+
+  // NOTE: Ties are broken by entry number so that the first occurrence of a
+  //       duplicated key wins, same as a TTreeIndex lookup would.
+  bool operator<(const KeyedEntry& rhs) const {
+    return key < rhs.key || (key == rhs.key && entry < rhs.entry);
+  }
+};
+
+struct JoinStats {
+  Long64_t reco_entries   = 0;
+  Long64_t hits           = 0;
+  Long64_t misses         = 0;
+  Long64_t weight_entries = 0;
+  Long64_t weight_dups    = 0;
+  Long64_t weight_unused  = 0;
+};
+
+/////////////
+// Helpers //
+/////////////
+
+// All Double_t branches that are not join keys are carried over by default
+vector<string> default_payload(TTree* tree, const string& run_br,
+                               const string& evt_br) {
+  vector<string> result{};
+
+  for (auto obj : *tree->GetListOfBranches()) {
+    auto br   = static_cast<TBranch*>(obj);
+    auto name = string(br->GetName());
+    if (name == run_br || name == evt_br) continue;
+
+    auto leaf = static_cast<TLeaf*>(br->GetListOfLeaves()->At(0));
+    if (string(leaf->GetTypeName()) == "Double_t") result.push_back(name);
+  }
+
+  return result;
+}
+
+// Sequential read of the join keys; 'on_entry' is invoked after each entry is
+// loaded, so that other TTreeReaderValues on the same reader can be copied out.
+template <class F>
+vector<KeyedEntry> read_keys(TTreeReader& reader, const string& run_br,
+                             const string& evt_br, F on_entry) {
+  TTreeReaderValue<UInt_t>    run(reader, run_br.c_str());
+  TTreeReaderValue<ULong64_t> evt(reader, evt_br.c_str());
+
+  vector<KeyedEntry> keys{};
+  keys.reserve(reader.GetTree()->GetEntries());
+
+  while (reader.Next()) {
+    keys.push_back({{*run, *evt}, reader.GetCurrentEntry()});
+    on_entry();
+  }
+
+  return keys;
+}
+
+///////////////////////
+// Main join routine //
+///////////////////////
+
+// Returns, for each reco entry in order, the matching weight entry or -1.
+vector<Long64_t> merge_keys(vector<KeyedEntry>& reco_keys,
+                            vector<KeyedEntry>& weight_keys, JoinStats& stats) {
+  vector<Long64_t> match(reco_keys.size(), -1);
+
+  sort(reco_keys.begin(), reco_keys.end());
+  sort(weight_keys.begin(), weight_keys.end());
+
+  auto w_itr = weight_keys.cbegin();
+  auto w_end = weight_keys.cend();
+
+  for (auto r_itr = reco_keys.cbegin(); r_itr != reco_keys.cend(); r_itr++) {
+    while (w_itr != w_end && w_itr->key < r_itr->key) {
+      // Skip weight entries that have no reco counterpart
+      auto next = w_itr + 1;
+      if (next == w_end || !(next->key == w_itr->key))
+        stats.weight_unused++;
+      w_itr = next;
+    }
+
+    if (w_itr != w_end && w_itr->key == r_itr->key) {
+      match[r_itr->entry] = w_itr->entry;
+      stats.hits++;
+    } else
+      stats.misses++;
+  }
+
+  // Everything left after the last reco key is unused
+  while (w_itr != w_end) {
+    auto next = w_itr + 1;
+    if (next == w_end || !(next->key == w_itr->key)) stats.weight_unused++;
+    w_itr = next;
+  }
+
+  for (auto i = 1ul; i < weight_keys.size(); i++)
+    if (weight_keys[i].key == weight_keys[i - 1].key) stats.weight_dups++;
+
+  return match;
+}
+
+JoinStats join(TFile* reco_file, TFile* weight_file, TFile* output_file,
+               const string& reco_tree, const string& weight_tree,
+               const string& output_tree, vector<string> payload,
+               const string& run_br, const string& evt_br,
+               Double_t miss_val) {
+  JoinStats stats{};
+
+  // Load weights into memory with one sequential read ////////////////////////
+  TTreeReader weight_reader(weight_tree.c_str(), weight_file);
+  if (payload.empty())
+    payload = default_payload(weight_reader.GetTree(), run_br, evt_br);
+
+  auto num_of_weights = weight_reader.GetTree()->GetEntries();
+
+  vector<unique_ptr<TTreeReaderValue<Double_t>>> payload_vals{};
+  vector<vector<Double_t>>                       payload_cols(payload.size());
+  for (auto i = 0ul; i < payload.size(); i++) {
+    payload_vals.emplace_back(
+        new TTreeReaderValue<Double_t>(weight_reader, payload[i].c_str()));
+    payload_cols[i].reserve(num_of_weights);
+  }
+
+  auto weight_keys = read_keys(weight_reader, run_br, evt_br, [&] {
+    for (auto i = 0ul; i < payload_vals.size(); i++)
+      payload_cols[i].push_back(**payload_vals[i]);
+  });
+  stats.weight_entries = weight_keys.size();
+
+  // Read only the key branches of the reco tree, then merge //////////////////
+  TTreeReader reco_reader(reco_tree.c_str(), reco_file);
+  auto        reco_keys = read_keys(reco_reader, run_br, evt_br, [] {});
+  stats.reco_entries    = reco_keys.size();
+
+  // NOTE: Keep the keys in entry order for output; merge_keys sorts in place
+  vector<EventKey> keys_in_order(reco_keys.size());
+  for (const auto& k : reco_keys) keys_in_order[k.entry] = k.key;
+
+  auto match = merge_keys(reco_keys, weight_keys, stats);
+
+  // Write weights in reco entry order /////////////////////////////////////////
+  output_file->cd();
+  TTree output(output_tree.c_str(), output_tree.c_str());
+
+  UInt_t    run_out;
+  ULong64_t evt_out;
+  Bool_t    matched_out;
+  output.Branch(run_br.c_str(), &run_out);
+  output.Branch(evt_br.c_str(), &evt_out);
+  output.Branch("matched", &matched_out);
+
+  vector<Double_t> payload_out(payload.size());
+  for (auto i = 0ul; i < payload.size(); i++)
+    output.Branch(payload[i].c_str(), &payload_out[i]);
+
+  for (auto entry = 0ul; entry < match.size(); entry++) {
+    run_out     = keys_in_order[entry].run;
+    evt_out     = keys_in_order[entry].evt;
+    matched_out = match[entry] >= 0;
+
+    for (auto i = 0ul; i < payload.size(); i++)
+      payload_out[i] = matched_out ? payload_cols[i][match[entry]] : miss_val;
+
+    output.Fill();
+  }
+
+  output_file->Write("", TObject::kOverwrite);
+
+  return stats;
+}
+
+void print_stats(const JoinStats& stats) {
+  auto pct = [](Long64_t num, Long64_t denom) {
+    return denom > 0 ? 100. * num / denom : 0.;
+  };
+
+  cout << "Reco entries:              " << stats.reco_entries << endl;
+  cout << "  with a weight (hits):    " << stats.hits << " ("
+       << pct(stats.hits, stats.reco_entries) << "%)" << endl;
+  cout << "  without weight (misses): " << stats.misses << " ("
+       << pct(stats.misses, stats.reco_entries) << "%)" << endl;
+  cout << "Weight entries:            " << stats.weight_entries << endl;
+  cout << "  duplicated keys:         " << stats.weight_dups << endl;
+  cout << "  unused keys:             " << stats.weight_unused << endl;
+}
+
+int main(int argc, char** argv) {
+  cxxopts::Options argopts("join_weights",
+                           "Join FF weights onto a reco tree, in reco entry "
+                           "order, so that it can be friended positionally.");
+
+  // clang-format off
+  argopts.add_options()
+    ("h,help", "print help")
+    ("reco", "specify reco ntuple", cxxopts::value<string>())
+    ("weight", "specify FF weight ntuple", cxxopts::value<string>())
+    ("output", "specify output ntuple", cxxopts::value<string>())
+    ("t,reco-tree", "specify reco tree name",
+     cxxopts::value<string>()->default_value("dst_iso"))
+    ("T,weight-tree", "specify FF weight tree name",
+     cxxopts::value<string>()->default_value("mc_dst_tau_ff_w"))
+    ("O,output-tree", "specify output tree name (default: weight tree name)",
+     cxxopts::value<string>())
+    ("b,branches", "specify weight branches to carry (default: all Double_t)",
+     cxxopts::value<vector<string>>()->default_value(""))
+    ("run-branch", "specify run number branch",
+     cxxopts::value<string>()->default_value("runNumber"))
+    ("event-branch", "specify event number branch",
+     cxxopts::value<string>()->default_value("eventNumber"))
+    ("miss-value", "specify the value for reco entries without a weight",
+     cxxopts::value<Double_t>()->default_value("-1"))
+  ;
+  // clang-format on
+
+  argopts.parse_positional({"reco", "weight", "output"});
+  auto parsed_args = argopts.parse(argc, argv);
+
+  if (parsed_args.count("help") || !parsed_args.count("output")) {
+    cout << argopts.help() << endl;
+    return parsed_args.count("help") ? 0 : 1;
+  }
+
+  auto weight_tree = parsed_args["weight-tree"].as<string>();
+  auto output_tree = parsed_args.count("output-tree")
+                         ? parsed_args["output-tree"].as<string>()
+                         : weight_tree;
+
+  vector<string> payload{};
+  for (const auto& br : parsed_args["branches"].as<vector<string>>())
+    if (!br.empty()) payload.push_back(br);
+
+  auto reco_path   = parsed_args["reco"].as<string>();
+  auto weight_path = parsed_args["weight"].as<string>();
+  auto output_path = parsed_args["output"].as<string>();
+
+  TFile* reco_file   = new TFile(reco_path.c_str(), "read");
+  TFile* weight_file = new TFile(weight_path.c_str(), "read");
+  TFile* output_file = new TFile(output_path.c_str(), "recreate");
+
+  auto stats = join(reco_file, weight_file, output_file,
+                    parsed_args["reco-tree"].as<string>(), weight_tree,
+                    output_tree, payload,
+                    parsed_args["run-branch"].as<string>(),
+                    parsed_args["event-branch"].as<string>(),
+                    parsed_args["miss-value"].as<Double_t>());
+  print_stats(stats);
+
+  delete reco_file;
+  delete weight_file;
+  delete output_file;
+
+  return 0;
+}
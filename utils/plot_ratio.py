@@ -4,12 +4,16 @@
 # License: GPLv2
 # Based on:
 #   https://github.com/ZishuoYang/my-hammer-reweighting/blob/master/plot_ratio.py
-# Last Change: Wed Oct 28, 2020 at 12:58 AM +0100
+# Last Change: Sun Oct 18, 2026 at 09:38 AM +0200
 
+import ast
+import numpy as np
 import ROOT as rt
 
 from argparse import ArgumentParser
 
+from truth_cache import read_truth_cache
+
 
 #################################
 # Command line arguments parser #
@@ -27,10 +31,15 @@ specify output path for plots.''')
 
     parser.add_argument('-d', '--data-ntuple',
                         nargs='?',
-                        required=True,
                         help='''
 specify path to ntuple that contains fit variables.''')
 
+    parser.add_argument('-c', '--truth-cache',
+                        nargs='?',
+                        help='''
+specify path to a truth cache (see build_truth_cache.u) to compute the true fit
+variables from, instead of a data ntuple.''')
+
     parser.add_argument('-w', '--weight-ntuple',
                         nargs='?',
                         required=True,
@@ -39,7 +48,6 @@ specify path to ntuple that contains FF weights.''')
 
     parser.add_argument('-t', '--data-tree',
                         nargs='?',
-                        required=True,
                         help='''
 specify tree name in fit-variable ntuple.''')
 
@@ -49,6 +57,12 @@ specify tree name in fit-variable ntuple.''')
                         help='''
 specify tree name in weight ntuple.''')
 
+    parser.add_argument('--aligned',
+                        action='store_true',
+                        help='''
+treat the weight tree as a positional friend, i.e. it has the same entry order
+as the data tree (see join_weights.u), so no index is built.''')
+
     parser.add_argument('--ff-weight',
                         nargs='?',
                         default='w_ff',
@@ -95,28 +109,93 @@ specify down plot min y.''')
                         help='''
 specify down plot max y.''')
 
-    return parser.parse_args()
+    args = parser.parse_args()
+    if not args.truth_cache and not (args.data_ntuple and args.data_tree):
+        parser.error('either -c or both -d and -t are required')
+
+    return args
 
 
 ###########
 # Helpers #
 ###########
 
+def four_mom(cols, prefix):
+    return [cols['{}_true_{}'.format(prefix, c)].astype(np.float64)
+            for c in ['pe', 'px', 'py', 'pz']]
+
+
+def mass2(pe, px, py, pz):
+    return pe**2 - (px**2 + py**2 + pz**2)
+
+
+def cache_fit_vars(cols):
+    '''
+    True q2, mm2 (GeV^2) and El (GeV) of every cached event, same as
+    'calc_kinematics' in inc/reweighter.h.
+    '''
+    b = four_mom(cols, 'b')
+    dst = four_mom(cols, 'dst')
+    mu = four_mom(cols, 'mu')
+    nu = [sum(c) for c in zip(*[four_mom(cols, p)
+                                for p in ['nu_tau', 'anu_tau', 'anu_mu']])]
+
+    q2 = mass2(*[x - y for x, y in zip(b, dst)]) / 1e6
+    mm2 = mass2(*nu) / 1e6
+    # Mu energy in the B rest frame
+    el = (b[0]*mu[0] - (b[1]*mu[1] + b[2]*mu[2] + b[3]*mu[3])) / \
+        np.sqrt(mass2(*b)) / 1e3
+
+    return {'q2_true': q2, 'mm2_true': mm2, 'el_true': el}
+
+
+def cache_weights(cols, weight_tree, weight):
+    '''
+    FF weight of every cached event, matched by (runNumber, eventNumber); 0
+    for events without one.
+    '''
+    w_cols = rt.RDataFrame(weight_tree).AsNumpy(
+        ['runNumber', 'eventNumber', weight])
+    lookup = dict(zip(zip(w_cols['runNumber'].tolist(),
+                          w_cols['eventNumber'].tolist()),
+                      w_cols[weight].tolist()))
+
+    return np.array([lookup.get(k, 0.) for k in
+                     zip(cols['runNumber'].tolist(),
+                         cols['eventNumber'].tolist())])
+
+
+def array_histo(name, bin_range, vals, weights=None):
+    nbins, lo, hi = ast.literal_eval(bin_range)
+    histo = rt.TH1D(name, name, nbins, lo, hi)
+    vals = np.ascontiguousarray(vals, dtype=np.float64)
+    weights = np.ones_like(vals) if weights is None else \
+        np.ascontiguousarray(weights, dtype=np.float64)
+    histo.FillN(len(vals), vals, weights)
+    return histo
+
+
 def plot_ratio(tree, output_path,
                var, weight, title,
                bin_range,
                up_y_min, up_y_max,
-               down_y_min, down_y_max):
+               down_y_min, down_y_max,
+               cache_vals=None, cache_w=None, sel=''):
     # rt.gStyle.SetOptStat(0)
     canvas = rt.TCanvas('canvas', 'A ratio plot')
 
-    tree.Draw('{}>>h1{}'.format(var, bin_range), '', 'goff')
-    h1 = rt.gDirectory.Get('h1')
+    if cache_vals is not None:
+        h1 = array_histo('h1', bin_range, cache_vals)
+        h2 = array_histo('h2', bin_range, cache_vals, cache_w)
+    else:
+        tree.Draw('{}>>h1{}'.format(var, bin_range), sel, 'goff')
+        h1 = rt.gDirectory.Get('h1')
+        weighted = '({})*({})'.format(sel, weight) if sel else weight
+        tree.Draw('{}>>h2{}'.format(var, bin_range), weighted, 'goff')
+        h2 = rt.gDirectory.Get('h2')
+
     h1.SetMarkerColor(rt.kBlue)
     h1.SetLineColor(rt.kBlue)
-
-    tree.Draw('{}>>h2{}'.format(var, bin_range), weight, 'goff')
-    h2 = rt.gDirectory.Get('h2')
     h2.SetMarkerColor(rt.kRed)
     h2.SetLineColor(rt.kRed)
 
@@ -133,18 +212,42 @@ def plot_ratio(tree, output_path,
 if __name__ == '__main__':
     args = parse_input()
 
-    data_ntuple = rt.TFile(args.data_ntuple)
     weight_ntuple = rt.TFile(args.weight_ntuple)
-
-    data_tree = data_ntuple.Get(args.data_tree)
     weight_tree = weight_ntuple.Get(args.weight_tree)
 
-    # Add friend to associate events
-    # NOTE: We need to build index first before adding as friend. See
-    #  https://root.cern.ch/doc/master/classTTreeIndex.html
-    # under "TreeIndex and Friend Trees" section for more info.
-    weight_tree.BuildIndex("runNumber", "eventNumber")
-    data_tree.AddFriend(weight_tree)
+    data_tree = None
+    cache_vars = dict()
+    cache_w = None
+    sel = ''
+
+    if args.truth_cache:
+        # The fit variables are computed from the truth momenta instead
+        _, cols = read_truth_cache(args.truth_cache)
+        cache_vars = cache_fit_vars(cols)
+        cache_w = cache_weights(cols, weight_tree, args.ff_weight)
+    else:
+        data_ntuple = rt.TFile(args.data_ntuple)
+        data_tree = data_ntuple.Get(args.data_tree)
+
+        # Add friend to associate events
+        # NOTE: We need to build index first before adding as friend. See
+        #  https://root.cern.ch/doc/master/classTTreeIndex.html
+        # under "TreeIndex and Friend Trees" section for more info.
+        # An aligned weight tree is read sequentially instead, without any
+        # index lookup.
+        if not args.aligned:
+            weight_tree.BuildIndex("runNumber", "eventNumber")
+        data_tree.AddFriend(weight_tree)
+
+        # Entries join_weights.u found no weight for only carry its
+        # '--miss-value', so both histograms leave them out
+        if args.aligned and weight_tree.GetBranch('matched'):
+            sel = '{}.matched'.format(args.weight_tree)
+
+    unknown = [v for v in args.vars if args.truth_cache and v not in cache_vars]
+    if unknown:
+        raise ValueError('Not computable from a truth cache: {}'.format(
+            ', '.join(unknown)))
 
     rt.gROOT.SetBatch(rt.kTRUE)  # Don't output anything on screen
 
@@ -155,4 +258,5 @@ if __name__ == '__main__':
                    var, args.ff_weight, var,
                    bin_range,
                    up_y_min, up_y_max,
-                   down_y_min, down_y_max)
+                   down_y_min, down_y_max,
+                   cache_vars.get(var), cache_w, sel)
@@ -0,0 +1,146 @@
+#!/usr/bin/env python
+#
+# Author: Yipeng Sun
+# License: GPLv2
+# Description: FF weights of truth candidates held in numpy arrays, computed
+#              in-process by librdx-reweight.so (see inc/reweighter.h).
+# Last Change: Sun Oct 18, 2026 at 09:12 AM +0200
+
+import ctypes as ct
+import numpy as np
+
+from argparse import ArgumentParser
+
+from truth_cache import read_truth_cache
+
+
+# Same order as 'truth_part_prefixes' in inc/truth_cache.h
+TRUTH_PARTS = ['b', 'dst', 'd0', 'k', 'pi', 'spi',
+               'mu', 'tau', 'anu_tau', 'nu_tau', 'anu_mu']
+MOM_COMPS = ['pe', 'px', 'py', 'pz']
+
+W_FF_INVALID = -1.
+
+
+class Stats(ct.Structure):
+    _fields_ = [('entries', ct.c_int64),
+                ('hammer_runs', ct.c_int64),
+                ('cache_hits', ct.c_int64),
+                ('presel_rej', ct.c_int64),
+                ('topo_rej', ct.c_int64),
+                ('weights', ct.c_int64),
+                ('sum_w', ct.c_double),
+                ('sum_w2', ct.c_double),
+                ('hammer_time', ct.c_double)]
+
+
+def load_lib(path):
+    lib = ct.CDLL(path)
+    ptrs = ct.POINTER(ct.c_void_p)
+
+    lib.rdx_reweighter_new.restype = ct.c_void_p
+    lib.rdx_reweighter_new.argtypes = [ct.c_double]
+    lib.rdx_reweighter_free.argtypes = [ct.c_void_p]
+    lib.rdx_reweighter_push.restype = ct.c_int64
+    lib.rdx_reweighter_push.argtypes = [ct.c_void_p, ct.c_size_t] + \
+        [ct.c_void_p] * 2 + [ptrs] * 5 + [ct.c_void_p] * 5
+    lib.rdx_reweighter_take_stats.argtypes = [ct.c_void_p, ct.POINTER(Stats)]
+    lib.rdx_reweighter_error.restype = ct.c_char_p
+
+    return lib
+
+
+class Reweighter:
+    '''
+    Set up HAMMER once, then push batches of truth columns, named after the
+    step 1 branches (e.g. 'b_id', 'b_true_pe'), and get the weights back.
+    Truth decays with the same 'runNumber' and 'eventNumber' are only
+    reweighted once, also across batches.
+
+    HAMMER is not known to be thread safe: use Reweighters, even separate
+    ones, from one thread at a time. Calls made while another thread is in
+    HAMMER raise RuntimeError.
+    '''
+    def __init__(self, lib='bin/librdx-reweight.so', topo_tol=1.):
+        self._lib = load_lib(lib)
+        self._rw = self._lib.rdx_reweighter_new(topo_tol)
+        if not self._rw:
+            raise RuntimeError(self._lib.rdx_reweighter_error().decode())
+
+    def __del__(self):
+        if getattr(self, '_rw', None):
+            self._lib.rdx_reweighter_free(self._rw)
+
+    def push(self, cols, selected=None):
+        '''
+        Return {'w_ff', 'q2_true', 'mm2_true', 'el_true'} arrays of the same
+        length as the columns; 'w_ff' is -1 for candidates HAMMER can't process.
+        '''
+        size = len(cols['b_id'])
+        keep = []  # contiguous copies must outlive the call
+
+        def ptr(arr, dtype):
+            arr = np.ascontiguousarray(arr, dtype=dtype)
+            keep.append(arr)
+            return arr.ctypes.data
+
+        def ptr_array(suffix, dtype):
+            return (ct.c_void_p * len(TRUTH_PARTS))(
+                *[ptr(cols[p + suffix], dtype) for p in TRUTH_PARTS])
+
+        has_key = 'runNumber' in cols and 'eventNumber' in cols
+        run = ptr(cols['runNumber'], np.uint32) if has_key else None
+        evt = ptr(cols['eventNumber'], np.uint64) if has_key else None
+        sel = ptr(selected, np.bool_) if selected is not None else None
+
+        out = {name: np.empty(size)
+               for name in ['w_ff', 'q2_true', 'mm2_true', 'el_true']}
+
+        ret = self._lib.rdx_reweighter_push(
+            self._rw, size, run, evt,
+            ptr_array('_id', np.int32),
+            *[ptr_array('_true_' + c, np.float64) for c in MOM_COMPS],
+            sel, *[arr.ctypes.data for arr in out.values()])
+        if ret < 0:
+            raise RuntimeError(self._lib.rdx_reweighter_error().decode())
+
+        return out
+
+    def take_stats(self):
+        '''
+        Counters since the last call, as a dict.
+        '''
+        stats = Stats()
+        self._lib.rdx_reweighter_take_stats(self._rw, ct.byref(stats))
+        return {name: getattr(stats, name) for name, _ in Stats._fields_}
+
+
+if __name__ == '__main__':
+    parser = ArgumentParser(description='''
+Reweight a truth cache in batches, and print the sum of weights.''')
+    parser.add_argument('cache', help='''
+specify path to the truth cache.''')
+    parser.add_argument('-b', '--batch', type=int, default=100000, help='''
+specify the number of candidates per batch.''')
+    parser.add_argument('-l', '--lib', default='bin/librdx-reweight.so',
+                        help='''
+specify path to the reweighting library.''')
+    args = parser.parse_args()
+
+    tree, cols = read_truth_cache(args.cache)
+    size = len(cols['b_id'])
+    rw = Reweighter(args.lib)
+
+    w_ff = np.empty(size)
+    for first in range(0, size, args.batch):
+        batch = {k: v[first:first+args.batch] for k, v in cols.items()}
+        w_ff[first:first+args.batch] = rw.push(batch)['w_ff']
+
+    stats = rw.take_stats()
+    ok = w_ff != W_FF_INVALID
+    print('Tree: {}'.format(tree))
+    print('{} entries, {} HAMMER runs, {} cache hits, {} weights'.format(
+        stats['entries'], stats['hammer_runs'], stats['cache_hits'],
+        np.count_nonzero(ok)))
+    print('Sum of weights: {}, sum of squares: {}'.format(
+        w_ff[ok].sum(), (w_ff[ok]**2).sum()))
@@ -0,0 +1,69 @@
+#!/usr/bin/env python
+#
+# Author: Yipeng Sun
+# License: GPLv2
+# Description: Read truth caches made by build_truth_cache.u as numpy arrays.
+#              See inc/truth_cache.h for the file layout.
+# Last Change: Sat Oct 17, 2026 at 04:44 PM +0200
+
+import numpy as np
+import struct
+
+from argparse import ArgumentParser
+
+
+MAGIC = b'RDXTRUTH'
+VERSION = 1
+
+FILE_HEADER = struct.Struct('<8sIIQ64s')
+COLUMN_HEADER = struct.Struct('<48sIIQ')
+
+COL_TYPES = {
+    0: np.float32,
+    1: np.float64,
+    2: np.int32,
+    3: np.uint32,
+    4: np.uint64,
+}
+
+
+def read_truth_cache(path, columns=None):
+    '''
+    Return (tree name, {column name: numpy array}). The arrays are memory
+    mapped, so only the columns that are actually used are read from disk.
+    '''
+    with open(path, 'rb') as f:
+        magic, version, num_of_cols, num_of_evts, tree = \
+            FILE_HEADER.unpack(f.read(FILE_HEADER.size))
+
+        if magic != MAGIC:
+            raise ValueError('{} is not a truth cache'.format(path))
+        if version != VERSION:
+            raise ValueError('{} has unsupported truth cache version {}'.format(
+                path, version))
+
+        col_hdrs = [COLUMN_HEADER.unpack(f.read(COLUMN_HEADER.size))
+                    for _ in range(num_of_cols)]
+
+    result = dict()
+    for name, col_type, _, offset in col_hdrs:
+        name = name.rstrip(b'\0').decode()
+        if columns is not None and name not in columns:
+            continue
+        result[name] = np.memmap(path, dtype=COL_TYPES[col_type], mode='r',
+                                 offset=offset, shape=(num_of_evts,))
+
+    return tree.rstrip(b'\0').decode(), result
+
+
+if __name__ == '__main__':
+    parser = ArgumentParser(description='''
+Print the schema of a truth cache.''')
+    parser.add_argument('cache', help='''
+specify path to the truth cache.''')
+    args = parser.parse_args()
+
+    tree, cols = read_truth_cache(args.cache)
+    print('Tree: {}'.format(tree))
+    for name, arr in cols.items():
+        print('{:24} {:8} {}'.format(name, str(arr.dtype), arr.shape[0]))
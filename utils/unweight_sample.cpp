@@ -0,0 +1,217 @@
+// Author: Yipeng Sun
+// License: GPLv2
+// Description: Reduce a FF-weighted tree to a smaller sample of equal-weight
+//              events, by accept-reject or systematic resampling.
+// Last Change: Sun Oct 18, 2026 at 08:42 AM +0200
+
+#include <TFile.h>
+#include <TTree.h>
+#include <TTreeReader.h>
+#include <TTreeReaderValue.h>
+
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <cxxopts.hpp>
+
+#include "unweight.h"
+
+using namespace std;
+
+/////////////
+// Helpers //
+/////////////
+
+struct Weights {
+  vector<double>    w;
+  vector<UInt_t>    run;
+  vector<ULong64_t> evt;
+};
+
+// One sequential read of the weight and the event keys
+Weights read_weights(TTree* tree, const string& w_br) {
+  TTreeReader                 reader(tree);
+  TTreeReaderValue<Double_t>  w(reader, w_br.c_str());
+  TTreeReaderValue<UInt_t>    run(reader, "runNumber");
+  TTreeReaderValue<ULong64_t> evt(reader, "eventNumber");
+
+  Weights result{};
+  result.w.reserve(tree->GetEntries());
+  result.run.reserve(tree->GetEntries());
+  result.evt.reserve(tree->GetEntries());
+
+  while (reader.Next()) {
+    result.w.push_back(*w);
+    result.run.push_back(*run);
+    result.evt.push_back(*evt);
+  }
+
+  // NOTE: Don't leave the reader's buffers attached for 'CloneTree'
+  tree->ResetBranchAddresses();
+  return result;
+}
+
+void print_summary(const unweight::Summary& s, const string& method) {
+  auto pct = [](double num, double denom) {
+    return denom > 0 ? 100. * num / denom : 0.;
+  };
+
+  cout << "Input entries:             " << s.entries << endl;
+  cout << "  with a positive weight:  " << s.weighted << endl;
+  cout << "  sum of weights:          " << s.sum_w << endl;
+  cout << "  effective entries:       " << s.n_eff() << endl;
+  if (method == "accept-reject") {
+    cout << "Maximum weight:            " << s.w_max << endl;
+    cout << "  entries above it:        " << s.over_max << " ("
+         << pct(s.over_max, s.weighted) << "%), " << 100. * s.bias()
+         << "% of the sum of weights" << endl;
+  }
+  cout << "Output events:             " << s.kept << " ("
+       << 100. * s.efficiency() << "% of the weighted entries)" << endl;
+  cout << "  distinct entries:        " << s.unique << endl;
+  cout << "  weight of each event:    " << s.unit_weight() << endl;
+  cout << "  effective entries:       " << s.n_eff_out() << endl;
+  cout << "Statistical error grows by a factor " << s.error_inflation()
+       << endl;
+}
+
+int main(int argc, char** argv) {
+  cxxopts::Options argopts("unweight_sample",
+                           "Reduce a FF-weighted tree to a smaller sample of "
+                           "equal-weight events.");
+
+  // clang-format off
+  argopts.add_options()
+    ("h,help", "print help")
+    ("input", "specify FF weight ntuple", cxxopts::value<string>())
+    ("output", "specify output ntuple", cxxopts::value<string>())
+    ("t,tree", "specify input tree name",
+     cxxopts::value<string>()->default_value("mc_dst_tau_ff_w"))
+    ("w,weight", "specify weight branch",
+     cxxopts::value<string>()->default_value("w_ff"))
+    ("m,method", "specify unweighting method: accept-reject or systematic",
+     cxxopts::value<string>()->default_value("accept-reject"))
+    ("w-max", "specify the maximum weight of accept-reject (default: from "
+              "--w-max-quantile)", cxxopts::value<double>())
+    ("q,w-max-quantile", "specify the quantile of the positive weights used "
+                         "as the maximum weight of accept-reject; entries "
+                         "above it are kept once, biasing the output",
+     cxxopts::value<double>()->default_value("1"))
+    ("n,num", "specify the number of output events of systematic "
+              "resampling (default: effective entries of the input)",
+     cxxopts::value<int64_t>())
+    ("s,seed", "specify the random seed",
+     cxxopts::value<uint64_t>()->default_value("42"))
+    ("c,copy", "copy all branches of the surviving entries, instead of only "
+               "their entry numbers and event keys")
+    ("l,event-list", "also write the surviving events to this file, one "
+                     "'runNumber eventNumber' per line and output event",
+     cxxopts::value<string>())
+  ;
+  // clang-format on
+
+  argopts.parse_positional({"input", "output"});
+  auto parsed_args = argopts.parse(argc, argv);
+
+  if (parsed_args.count("help") || !parsed_args.count("output")) {
+    cout << argopts.help() << endl;
+    return parsed_args.count("help") ? 0 : 1;
+  }
+
+  auto method = parsed_args["method"].as<string>();
+  if (method != "accept-reject" && method != "systematic") {
+    cerr << "Unknown unweighting method: " << method << endl;
+    return 1;
+  }
+
+  auto tree_name   = parsed_args["tree"].as<string>();
+  auto input_path  = parsed_args["input"].as<string>();
+  auto output_path = parsed_args["output"].as<string>();
+
+  TFile* input_file = new TFile(input_path.c_str(), "read");
+  auto   input_tree = input_file->Get<TTree>(tree_name.c_str());
+  if (!input_tree) {
+    cerr << "No tree " << tree_name << " in " << input_path << endl;
+    return 1;
+  }
+
+  auto weights = read_weights(input_tree, parsed_args["weight"].as<string>());
+
+  // Choose the surviving entries //////////////////////////////////////////////
+  mt19937_64       rng(parsed_args["seed"].as<uint64_t>());
+  vector<uint32_t> copies{};
+  double           w_max = 0;
+
+  if (method == "accept-reject") {
+    w_max = parsed_args.count("w-max")
+                ? parsed_args["w-max"].as<double>()
+                : unweight::max_weight(
+                      weights.w, parsed_args["w-max-quantile"].as<double>());
+    if (w_max <= 0) {
+      cerr << "No positive weights in " << tree_name << endl;
+      return 1;
+    }
+    copies = unweight::accept_reject(weights.w, w_max, rng);
+  } else {
+    auto num = parsed_args.count("num") ? parsed_args["num"].as<int64_t>()
+                                        : llround(unweight::n_eff(weights.w));
+    if (num <= 0) {
+      cerr << "No output events of systematic resampling from " << tree_name
+           << endl;
+      return 1;
+    }
+    copies = unweight::systematic(weights.w, num, rng);
+  }
+
+  auto summary = unweight::summarize(weights.w, copies, w_max);
+  auto w_unw   = summary.unit_weight();
+
+  // Write the output events, in input order ///////////////////////////////////
+  TFile* output_file = new TFile(output_path.c_str(), "recreate");
+  TTree* output      = nullptr;
+
+  Long64_t  entry_out;
+  UInt_t    run_out;
+  ULong64_t evt_out;
+  if (parsed_args.count("copy"))
+    output = input_tree->CloneTree(0);
+  else {
+    output = new TTree(tree_name.c_str(), tree_name.c_str());
+    output->Branch("entry", &entry_out);
+    output->Branch("runNumber", &run_out);
+    output->Branch("eventNumber", &evt_out);
+  }
+  output->Branch("w_unw", &w_unw);
+
+  ofstream event_list{};
+  if (parsed_args.count("event-list"))
+    event_list.open(parsed_args["event-list"].as<string>());
+
+  for (Long64_t entry = 0; entry < Long64_t(copies.size()); entry++) {
+    if (copies[entry] == 0) continue;
+
+    if (parsed_args.count("copy")) input_tree->GetEntry(entry);
+    entry_out = entry;
+    run_out   = weights.run[entry];
+    evt_out   = weights.evt[entry];
+
+    // NOTE: Systematic resampling repeats heavy entries
+    for (uint32_t i = 0; i < copies[entry]; i++) {
+      output->Fill();
+      if (event_list.is_open())
+        event_list << run_out << ' ' << evt_out << '\n';
+    }
+  }
+
+  output_file->Write("", TObject::kOverwrite);
+  print_summary(summary, method);
+
+  delete input_file;
+  delete output_file;
+
+  return 0;
+}
@@ -0,0 +1,94 @@
+//------------------------------------------------------------------------------
+// File and Version Information:
+//      Cubature of the four-fold B->D*lnu rate
+//
+// Description:
+//    Multi-threaded integration of functions of (q2, ctl, ctv, chi), e.g.
+//    BToDstaunu::Gamma_q2Angular, returning the total integral and any number
+//    of binned 1D/2D marginals in one pass, all with error estimates.
+//
+//    GaussKronrod(make, domain, marginals, panels, points, nThreads)
+//       Tensor product of 7- or 15-point Gauss-Kronrod rules on panels in each
+//       variable; the error is |K - G| of the same points. Bin edges of
+//       the marginals are added to the panel boundaries, so that every bin
+//       is integrated with the full rule. Deterministic.
+//    Vegas(make, domain, marginals, opts, nThreads)
+//       Adaptive Monte Carlo with a separable importance grid (Lepage 1978).
+//       The result only depends on the seed, not on the number of threads.
+//    AngularRate(ff, isCLN, isDgamma, lplus, ml), AngularDomain(ff, ml)
+//       Integrand and phase space of BToDstaunu::Compute(q2, ctl, ctv, chi).
+//
+// Author List:
+//      Yipeng Sun
+//
+// Revision History:
+//      26/10/18 yipengsun -- Created
+//------------------------------------------------------------------------------
+
+#ifndef FF_CUBATURE
+#define FF_CUBATURE
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "ff_dstaunu.hpp"
+
+namespace ff_cubature {
+
+enum Var { Q2 = 0, Ctl, Ctv, Chi, NumOfVars };
+
+// Integrands are called concurrently, one instance per thread
+using Integrand        = std::function<double(const double *x)>;
+using IntegrandFactory = std::function<Integrand()>;
+
+struct Domain {
+  double lo[NumOfVars], hi[NumOfVars];
+};
+
+struct Binning {
+  int    var;
+  int    nbins;
+  double lo, hi;
+};
+
+// 1 or 2 axes; bin (i, j) is at i + j * axes[0].nbins. Points outside of the
+// axes ranges don't contribute.
+struct Marginal {
+  std::vector<Binning> axes;
+  std::vector<double>  value, error;  // filled by the integration
+};
+
+struct Result {
+  double                integral = 0, error = 0;
+  double                chi2_dof = 0;  // VEGAS only
+  size_t                nEval    = 0;
+  std::vector<Marginal> marginals;
+};
+
+struct VegasOptions {
+  size_t   nCalls  = 200000;  // per iteration
+  int      nWarmup = 5;       // iterations that only adapt the grid
+  int      nIter   = 10;      // iterations that are combined
+  int      nGrid   = 50;      // grid bins per variable
+  double   alpha   = 1.5;     // grid damping
+  uint64_t seed    = 42;
+};
+
+// 'nThreads' == 0 uses all cores
+Result GaussKronrod(const IntegrandFactory &make, const Domain &domain,
+                    const std::vector<Marginal> &marginals,
+                    const int panels[NumOfVars], int points = 7,
+                    unsigned nThreads = 0);
+Result Vegas(const IntegrandFactory &make, const Domain &domain,
+             const std::vector<Marginal> &marginals, const VegasOptions &opts,
+             unsigned nThreads = 0);
+
+IntegrandFactory AngularRate(const BToDstaunu &ff, int isCLN, int isDgamma,
+                             bool lplus, double ml);
+Domain           AngularDomain(const BToDstaunu &ff, double ml);
+
+}  // namespace ff_cubature
+
+#endif
@@ -18,12 +18,16 @@
 //       Branching fraction.
 //    Gamma_q2(q2, A1, V, A2, A0, ml)
 //       q2 spectrum.
+//    FromSP8ToBGL(q2, ctl, ctv, chi, isDgamma, lplus, pars, npar, w, n, ml)
+//       Re-weights n SP8 MC events to npar sets of BGL coefficients at once.
 //
 // Author List:
 //      Manuel Franco Sevilla                     Stanford University
 //      Michael Mazur                             INFN Pisa
 //
 /// Revision History:
+//      26/10/18 yipengsun -- Added the BGL FF from hep-ph/1703.06124, and
+//                            weights for arrays of events and BGL coefficients
 //      20/10/27 yipengsun -- Reformatted with clang-format
 //      12/05/10 manuelf   -- Normalization validated with EvtGen, including
 //                            Higgs Added the theta spectrum integrated over q2
@@ -37,8 +41,14 @@
 #ifndef BTODSTAUNU
 #define BTODSTAUNU
 
+#include <algorithm>
+#include <array>
+#include <cstddef>
 #include <fstream>
 #include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
 #include "TMath.h"
 #include "TString.h"
 
@@ -46,6 +56,13 @@ using namespace std;
 using std::cout;
 using std::endl;
 
+// Coefficients of the BGL z-expansions; the order of each expansion is the
+// size of its vector minus 1. a_F1[0] is not free: it is set from the
+// constraint F1(w=1) = (mB - mD*) f(w=1).
+struct BGLParams {
+  std::vector<double> a_g, a_f, a_F1, a_F2;
+};
+
 class BToDstaunu {
  public:
   BToDstaunu(double rho2 = 1.207, double R1 = 1.401, double R2 = 0.854,
@@ -65,11 +82,29 @@ class BToDstaunu {
       4.20;  // [GeV] in the MSbar scheme, evaluated at mb.
   static constexpr double mc_quark = 0.901;  // From Xing, Zhang, Zhou (2008)
 
+  // Values of isCLN
+  static constexpr int SP8 = 0;
+  static constexpr int CLN = 1;
+  static constexpr int BGL = 2;
+
+  // BGL unitarity inputs from hep-ph/1703.06124, in GeV
+  static constexpr double nI         = 2.6;
+  static constexpr double Chi1mT     = 5.131e-4;
+  static constexpr double Chi1pT     = 3.894e-4;
+  static constexpr double Chi0mL     = 19.421e-3;
+  static constexpr double Poles1m[4] = {6.329, 6.920, 7.020, 7.280};  // g
+  static constexpr double Poles1p[4] = {6.739, 6.750, 7.145, 7.150};  // f, F1
+  static constexpr double Poles0m[3] = {6.275, 6.842, 7.250};         // F2
+  // Most coefficients of each z-expansion, so that ComputeBGL doesn't allocate
+  static constexpr size_t BGLMaxCoefs = 6;
+
   // Secondary constants
   double _mB, _mBSP8, _BLifeTime;
   double _mDs, _mDsSP8, _Dsmaxq2;
   double _rho2, _R1, _R2, _R0, _gSR;
   double _isBm;
+  // Fitted to the CLN FF the first time BGL is used, unless set with SetBGL
+  BGLParams _bgl;
 
   void   SetMasses(int isBm);
   void   ComputeCLN(double q2, double &A1, double &V, double &A2, double &A0);
@@ -78,6 +113,9 @@ class BToDstaunu {
                          double &A0);
   void   HadronicAmp(double q2, double A1, double V, double A2, double A0,
                      double &H0, double &Ht, double &Hplus, double &Hminus);
+  void   SetBGL(const BGLParams &pars);
+  const BGLParams &GetBGL();
+  void   ComputeBGL(double q2, double &A1, double &V, double &A2, double &A0);
   double EvtGetas(double massq, double massx);
   double EvtGetGammaji(double z);
 
@@ -89,6 +127,23 @@ class BToDstaunu {
                          double A2, double A0, double ml);
   double FromSP8ToThisModel(double q2, double ctl, double ctv, double chi,
                             int isDgamma, bool lplus, double ml);
+  void   AngularTerms(double ctl, double ctv, double chi, int isDgamma,
+                      bool lplus, double ang[13]);
+  double AngularSum(const double ang[13], double flip, double H0, double Ht,
+                    double Hplus, double Hminus);
+
+  // BGL with the coefficients of SetBGL
+  double FromSP8ToBGL(double q2, double ctl, double ctv, double chi,
+                      int isDgamma, bool lplus, double ml);
+  // The same for n events and npar sets of coefficients at once; the weight
+  // of event i for the set p is w[p * n + i]
+  void   FromSP8ToBGL(const double *q2, const double *ctl, const double *ctv,
+                      const double *chi, int isDgamma, const bool *lplus,
+                      const BGLParams *pars, size_t npar, double *w, size_t n,
+                      double ml);
+  double NormalizationBGL(const BGLParams &pars, double ml);
+  // BGL coefficients closest to the CLN FF of this instance
+  BGLParams FitBGLToCLN(int order = 2);
 
   double Compute(double q2, int isCLN, double ml);
   double Compute(double q2, double ctl, int isCLN, double ml);
@@ -105,6 +160,32 @@ class BToDstaunu {
   double SubPoly(double Coef[3][7], int indexR);
   void   Polynomial(double ml);
   double SumPoly(double Coef[3][7]);
+
+ private:
+  // FF-independent parts of the BGL FF at one q2: z^n / (P(z) phi(z)) for
+  // each coefficient, in the order of BGLParams
+  void   BGLBasis(double q2, const BGLParams &pars, double *basis);
+  void   BGLFF(const double *basis, const BGLParams &layout,
+               const BGLParams &pars, double &g, double &f, double &FF1,
+               double &FF2);
+  double BGLOuter(double z, int ff);
+  BGLParams BGLConstrained(const BGLParams &pars);
+
+  // The integrated BGL rate is a quadratic form in the coefficients, with no
+  // terms mixing different FF. The matrices are integrated once per lepton
+  // mass, B charge, gSR and expansion orders.
+  struct BGLNormEntry {
+    double                           ml, gSR;
+    int                              isBm;
+    size_t                           order[4];
+    double                           RateSP8;
+    std::vector<std::vector<double>> Rate;  // one (order+1)^2 matrix per FF
+  };
+  std::vector<BGLNormEntry> _bgl_norm;
+
+  const BGLNormEntry &BGLNormalizationEntry(const BGLParams &pars, double ml);
+
+  bool _bgl_set = false;
 };
 
 #endif
@@ -0,0 +1,104 @@
+//------------------------------------------------------------------------------
+// File and Version Information:
+//      Companion of ff_dstaunu.hpp for B -> D l nu (pseudoscalar D)
+//
+// Description:
+//    Calculation of the B->DlNu rates in q2 and cos(thetaL) for a lepton of
+//    mass ml, with the CLN FF from hep-ph/9712417 (V1, S1 with the
+//    Delta correction of hep-ph/1005.4306) and the ISGW2 FF from EvtGen.
+//    The angular dependence and the sign conventions are the ones of
+//    BToDstaunu::Gamma_q2tL with H+ = H- = 0.
+//    The New Physics dependence is parameterized in terms of
+//    gSR = -mb (tanBeta/mH)^2 from hep-ph/1203.2654
+//
+//    FromISGW2ToThisModel(q2, ctl, ml)
+//       Re-weights ISGW2 MC to the CLN parameterization.
+//    FromISGW2ToThisModel(q2, ctl, w, n, ml)
+//       The same for n events at once.
+//    SetMasses(isBm)
+//       Sets the masses of the B and D depending on the charge.
+//    Rate(isCLN, ml)
+//       Branching fraction.
+//
+//    The CLN rate is V1^2 times a polynomial of order 2 in rho2, so it is
+//    integrated only for 3 values of rho2 per lepton mass, B charge, Delta
+//    and gSR, and then cached.
+//
+// Author List:
+//      Yipeng Sun
+//
+// Revision History:
+//      26/10/18 yipengsun -- Created off ff_dstaunu by M. Franco Sevilla
+//------------------------------------------------------------------------------
+
+#ifndef BTODTAUNU
+#define BTODTAUNU
+
+#include <cstddef>
+#include <vector>
+
+#include "ff_dstaunu.hpp"
+
+class BToDtaunu {
+ public:
+  // V1 is V1(1) = G(1) from lattice QCD (FNAL/MILC 2015); rho2 from HFAG 2012
+  BToDtaunu(double rho2 = 1.186, double V1 = 1.0541, double Delta = 1.,
+            double gSR = 0);
+  ~BToDtaunu();
+
+  // Primary constants are shared with B->D*lnu
+  static constexpr double mTau     = BToDstaunu::mTau;
+  static constexpr double mMu      = BToDstaunu::mMu;
+  static constexpr double mE       = BToDstaunu::mE;
+  static constexpr double Vcb      = BToDstaunu::Vcb;
+  static constexpr double GF       = BToDstaunu::GF;
+  static constexpr double PI       = BToDstaunu::PI;
+  static constexpr double hbar     = BToDstaunu::hbar;
+  static constexpr double mb_quark = BToDstaunu::mb_quark;
+  static constexpr double mc_quark = BToDstaunu::mc_quark;
+
+  // Secondary constants
+  double _mB, _mBSP8, _BLifeTime;
+  double _mD, _mDSP8, _Dmaxq2;
+  double _rho2, _V1, _Delta, _gSR;
+  int    _isBm;
+
+  void SetMasses(int isBm);
+  void ComputeCLN(double q2, double &fplus, double &fzero);
+  void ComputeISGW2(double q2, double &fplus, double &fzero);
+  void HadronicAmp(double q2, double fplus, double fzero, double &H0,
+                   double &Ht);
+
+  double Compute(double q2, double ctl, int isCLN, double ml);
+  double Compute(double q2, int isCLN, double ml);
+  double Gamma_q2tL(double q2, double ctl, double fplus, double fzero,
+                    double ml);
+  double Normalization(double ml);
+  double FromISGW2ToThisModel(double q2, double ctl, double ml);
+  void   FromISGW2ToThisModel(const double *q2, const double *ctl, double *w,
+                              size_t n, double ml);
+
+  // Functions only used to calculate the Normalization once
+  double IntRate(int isCLN, double ml, int nPoints = 10000);
+  double Gamma_q2(double q2, double fplus, double fzero, double ml);
+  double Rate(int isCLN, double ml);
+
+ private:
+  // q2-independent parts of the ISGW2 FF, set in SetMasses: f+ and f- are
+  // _isgw2_fplus and _isgw2_fminus over (1 + r2 (tm - t) / 12)^2
+  double _isgw2_tm, _isgw2_r2, _isgw2_fplus, _isgw2_fminus;
+
+  // Rates for the normalization, per lepton mass, B charge, Delta and gSR
+  struct NormEntry {
+    double ml, Delta, gSR;
+    int    isBm;
+    double RateISGW2;
+    double Coef[3];  // CLN rate / V1^2 = Coef[0] + Coef[1] rho2 + Coef[2] rho2^2
+  };
+  std::vector<NormEntry> _norm;
+
+  void             SetISGW2Constants();
+  const NormEntry &NormalizationEntry(double ml);
+};
+
+#endif
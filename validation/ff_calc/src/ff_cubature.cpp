@@ -0,0 +1,449 @@
+//------------------------------------------------------------------------------
+// File and Version Information:
+//      Cubature of the four-fold B->D*lnu rate
+//
+// Description:
+//    See ff_cubature.hpp.
+//
+// Author List:
+//      Yipeng Sun
+//
+// Revision History:
+//      26/10/18 yipengsun -- Created
+//------------------------------------------------------------------------------
+
+#include "ff_cubature.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <memory>
+#include <random>
+#include <thread>
+
+namespace ff_cubature {
+
+namespace {
+
+// Gauss-Kronrod rules: Kronrod nodes in [0, 1] (the last one is 0) and
+// weights, and the weights of the embedded Gauss rule, which uses the nodes
+// with odd indices
+struct GKRule {
+  int                 n;  // points per panel
+  std::vector<double> xgk, wgk, wg;
+};
+
+// G3-K7
+const GKRule gk7{7,
+                 {0.960491268708020283423507092629080,
+                  0.774596669241483377035853079956480,
+                  0.434243749346802558002071502844628, 0.},
+                 {0.104656226026467265193823857192073,
+                  0.268488089868333440728569280666710,
+                  0.401397414775962222905051818618432,
+                  0.450916538658474142345110087045571},
+                 {0.555555555555555555555555555555556,
+                  0.888888888888888888888888888888889}};
+
+// G7-K15, as QUADPACK qk15
+const GKRule gk15{15,
+                  {0.991455371120812639206854697526329,
+                   0.949107912342758524526189684047851,
+                   0.864864423359769072789712788640926,
+                   0.741531185599394439863864773280788,
+                   0.586087235467691130294144845693013,
+                   0.405845151377397166906606412076961,
+                   0.207784955007898467600689403773245, 0.},
+                  {0.022935322010529224963732008058970,
+                   0.063092092629978553290700663189204,
+                   0.104790010322250183839876322541518,
+                   0.140653259715525918745189590510238,
+                   0.169004726639267902826583426598550,
+                   0.190350578064785409913256402421014,
+                   0.204432940075298892414161999234649,
+                   0.209482141084727828012999174891714},
+                  {0.129484966168869693270611432679082,
+                   0.279705391489276667901467771423780,
+                   0.381830050505118944950369775488975,
+                   0.417959183673469387755102040816327}};
+
+unsigned NumOfThreads(unsigned nThreads) {
+  if (nThreads > 0) return nThreads;
+  return std::max(1u, std::thread::hardware_concurrency());
+}
+
+// Run 'work(unit)' for units 0..nUnits-1 on 'nThreads' threads, each with its
+// own integrand
+void ParallelFor(const IntegrandFactory &make, size_t nUnits,
+                 unsigned                                           nThreads,
+                 const std::function<void(Integrand &, size_t unit)> &work) {
+  std::atomic<size_t> next{0};
+  auto                worker = [&]() {
+    auto f = make();
+    for (size_t unit = next++; unit < nUnits; unit = next++) work(f, unit);
+  };
+
+  std::vector<std::thread> threads;
+  for (unsigned t = 1; t < std::min<size_t>(nThreads, nUnits); t++)
+    threads.emplace_back(worker);
+  worker();
+  for (auto &t : threads) t.join();
+}
+
+size_t NumOfBins(const Marginal &m) {
+  size_t n = 1;
+  for (const auto &axis : m.axes) n *= axis.nbins;
+  return n;
+}
+
+int BinOf(const Binning &axis, double x) {
+  if (x < axis.lo || x >= axis.hi) return -1;
+  int bin = static_cast<int>((x - axis.lo) / (axis.hi - axis.lo) * axis.nbins);
+  return std::min(bin, axis.nbins - 1);
+}
+
+// Offsets of each marginal in a flat array of all bins
+std::vector<size_t> BinOffsets(const std::vector<Marginal> &marginals) {
+  std::vector<size_t> offsets{0};
+  for (const auto &m : marginals) offsets.push_back(offsets.back() + NumOfBins(m));
+  return offsets;
+}
+
+// Flat bin index of x in marginal m, or -1
+long FlatBin(const Marginal &m, const double *x) {
+  long bin = 0, stride = 1;
+  for (const auto &axis : m.axes) {
+    int b = BinOf(axis, x[axis.var]);
+    if (b < 0) return -1;
+    bin += b * stride;
+    stride *= axis.nbins;
+  }
+  return bin;
+}
+
+Result EmptyResult(const std::vector<Marginal> &marginals) {
+  Result result{};
+  result.marginals = marginals;
+  for (auto &m : result.marginals) {
+    m.value.assign(NumOfBins(m), 0);
+    m.error.assign(NumOfBins(m), 0);
+  }
+  return result;
+}
+
+}  // namespace
+
+//////////////////////////////////
+// Tensor-product Gauss-Kronrod //
+//////////////////////////////////
+
+Result GaussKronrod(const IntegrandFactory &make, const Domain &domain,
+                    const std::vector<Marginal> &marginals,
+                    const int panels[NumOfVars], int points,
+                    unsigned nThreads) {
+  const auto &rule = points == 15 ? gk15 : gk7;
+  int         half = rule.n / 2;
+
+  // Nodes in each variable: Kronrod and Gauss weights (0 at Kronrod-only
+  // nodes), on panels that include all bin edges within the domain
+  std::vector<double> x[NumOfVars], wK[NumOfVars], wG[NumOfVars];
+  for (int v = 0; v < NumOfVars; v++) {
+    double              lo = domain.lo[v], hi = domain.hi[v];
+    std::vector<double> edges;
+    for (int p = 0; p <= panels[v]; p++)
+      edges.push_back(lo + (hi - lo) * p / panels[v]);
+    for (const auto &m : marginals)
+      for (const auto &axis : m.axes)
+        if (axis.var == v)
+          for (int b = 0; b <= axis.nbins; b++) {
+            double e = axis.lo + (axis.hi - axis.lo) * b / axis.nbins;
+            if (e > lo && e < hi) edges.push_back(e);
+          }
+    std::sort(edges.begin(), edges.end());
+    edges.erase(std::unique(edges.begin(), edges.end(),
+                            [&](double a, double b) {
+                              return b - a < 1e-12 * (hi - lo);
+                            }),
+                edges.end());
+
+    for (size_t p = 0; p + 1 < edges.size(); p++) {
+      double center = (edges[p] + edges[p + 1]) / 2;
+      double width  = (edges[p + 1] - edges[p]) / 2;
+      for (int k = 0; k < rule.n; k++) {
+        // Mirrored index into the tables
+        int    i    = k <= half ? k : rule.n - 1 - k;
+        double sign = k < half ? -1 : 1;
+        x[v].push_back(center + sign * width * rule.xgk[i]);
+        wK[v].push_back(width * rule.wgk[i]);
+        wG[v].push_back(i % 2 ? width * rule.wg[i / 2] : 0);
+      }
+    }
+  }
+
+  // Bin of every node, per marginal axis
+  auto offsets = BinOffsets(marginals);
+  std::vector<std::vector<std::vector<int>>> nodeBin(marginals.size());
+  for (size_t m = 0; m < marginals.size(); m++)
+    for (const auto &axis : marginals[m].axes) {
+      std::vector<int> bins;
+      for (double xi : x[axis.var]) bins.push_back(BinOf(axis, xi));
+      nodeBin[m].push_back(bins);
+    }
+
+  // One unit per q2 node; partial sums are kept per unit and summed in order
+  // at the end, so that the result doesn't depend on the thread scheduling
+  size_t              nUnits = x[Q2].size(), nBins = offsets.back();
+  std::vector<double> unitK(nUnits, 0), unitG(nUnits, 0);
+  std::vector<double> unitBinK(nUnits * nBins, 0), unitBinG(nUnits * nBins, 0);
+
+  ParallelFor(make, nUnits, NumOfThreads(nThreads), [&](Integrand &f,
+                                                        size_t      i0) {
+    double *binK = &unitBinK[i0 * nBins], *binG = &unitBinG[i0 * nBins];
+    size_t  idx[NumOfVars];
+    double  pt[NumOfVars];
+    idx[Q2] = i0;
+    pt[Q2]  = x[Q2][i0];
+
+    for (idx[Ctl] = 0; idx[Ctl] < x[Ctl].size(); idx[Ctl]++)
+      for (idx[Ctv] = 0; idx[Ctv] < x[Ctv].size(); idx[Ctv]++)
+        for (idx[Chi] = 0; idx[Chi] < x[Chi].size(); idx[Chi]++) {
+          pt[Ctl] = x[Ctl][idx[Ctl]];
+          pt[Ctv] = x[Ctv][idx[Ctv]];
+          pt[Chi] = x[Chi][idx[Chi]];
+
+          double val = f(pt), k = val, g = val;
+          for (int v = 0; v < NumOfVars; v++) {
+            k *= wK[v][idx[v]];
+            g *= wG[v][idx[v]];
+          }
+          unitK[i0] += k;
+          unitG[i0] += g;
+
+          for (size_t m = 0; m < marginals.size(); m++) {
+            long bin = 0, stride = 1;
+            for (size_t a = 0; a < marginals[m].axes.size() && bin >= 0; a++) {
+              int b = nodeBin[m][a][idx[marginals[m].axes[a].var]];
+              bin   = b < 0 ? -1 : bin + b * stride;
+              stride *= marginals[m].axes[a].nbins;
+            }
+            if (bin < 0) continue;
+            binK[offsets[m] + bin] += k;
+            binG[offsets[m] + bin] += g;
+          }
+        }
+  });
+
+  auto   result = EmptyResult(marginals);
+  double G      = 0;
+  for (size_t u = 0; u < nUnits; u++) {
+    result.integral += unitK[u];
+    G += unitG[u];
+  }
+  result.error = fabs(result.integral - G);
+  result.nEval = nUnits * x[Ctl].size() * x[Ctv].size() * x[Chi].size();
+
+  for (size_t m = 0; m < marginals.size(); m++)
+    for (size_t b = 0; b < NumOfBins(marginals[m]); b++) {
+      double k = 0, g = 0;
+      for (size_t u = 0; u < nUnits; u++) {
+        k += unitBinK[u * nBins + offsets[m] + b];
+        g += unitBinG[u * nBins + offsets[m] + b];
+      }
+      result.marginals[m].value[b] = k;
+      result.marginals[m].error[b] = fabs(k - g);
+    }
+
+  return result;
+}
+
+///////////
+// VEGAS //
+///////////
+
+namespace {
+
+// Lepage's grid refinement in one variable, from the sums of (f J)^2 per bin
+void RefineGrid(std::vector<double> &edges, const std::vector<double> &d,
+                double alpha) {
+  int                 n = d.size();
+  std::vector<double> ds(n), r(n);
+  double              sum = 0;
+  for (int i = 0; i < n; i++) {
+    double prev = d[std::max(i - 1, 0)], next = d[std::min(i + 1, n - 1)];
+    ds[i] = (i == 0 || i == n - 1) ? (d[i] + (i == 0 ? next : prev)) / 2
+                                   : (prev + d[i] + next) / 3;
+    sum += ds[i];
+  }
+  if (sum <= 0) return;
+
+  double rsum = 0;
+  for (int i = 0; i < n; i++) {
+    double frac = ds[i] / sum;
+    r[i] = frac > 0 && frac < 1 ? pow((frac - 1) / log(frac), alpha) : 0;
+    rsum += r[i];
+  }
+  if (rsum <= 0) return;
+
+  std::vector<double> newEdges{edges.front()};
+  double              acc = 0, avg = rsum / n;
+  int                 j   = 0;
+  for (int k = 1; k < n; k++) {
+    double target = k * avg;
+    while (j < n - 1 && acc + r[j] < target) acc += r[j++];
+    double frac = r[j] > 0 ? std::min((target - acc) / r[j], 1.) : 0;
+    newEdges.push_back(edges[j] + frac * (edges[j + 1] - edges[j]));
+  }
+  newEdges.push_back(edges.back());
+  edges = newEdges;
+}
+
+}  // namespace
+
+Result Vegas(const IntegrandFactory &make, const Domain &domain,
+             const std::vector<Marginal> &marginals, const VegasOptions &opts,
+             unsigned nThreads) {
+  // A fixed number of chunks per iteration, each with its own random stream,
+  // so that the result doesn't depend on the number of threads
+  const size_t nChunks = 64;
+  int          nGrid   = opts.nGrid;
+  auto         offsets = BinOffsets(marginals);
+  size_t       nBins   = offsets.back();
+
+  std::vector<double> edges[NumOfVars];
+  for (int v = 0; v < NumOfVars; v++)
+    for (int i = 0; i <= nGrid; i++)
+      edges[v].push_back(domain.lo[v] +
+                         (domain.hi[v] - domain.lo[v]) * i / nGrid);
+
+  struct ChunkSums {
+    double              s1 = 0, s2 = 0;
+    std::vector<double> d, b1, b2;
+  };
+
+  auto   result = EmptyResult(marginals);
+  double sumW = 0, sumWI = 0, sumWI2 = 0;
+  std::vector<double> binWI(nBins, 0), binW2V(nBins, 0);
+  std::vector<double> iterI, iterV;
+
+  for (int it = 0; it < opts.nWarmup + opts.nIter; it++) {
+    std::vector<ChunkSums> chunks(nChunks);
+
+    ParallelFor(make, nChunks, NumOfThreads(nThreads), [&](Integrand &f,
+                                                           size_t      c) {
+      auto &sums = chunks[c];
+      sums.d.assign(NumOfVars * nGrid, 0);
+      sums.b1.assign(nBins, 0);
+      sums.b2.assign(nBins, 0);
+
+      std::seed_seq seq{opts.seed, static_cast<uint64_t>(it),
+                        static_cast<uint64_t>(c)};
+      std::mt19937_64                        rng(seq);
+      std::uniform_real_distribution<double> uni(0, 1);
+
+      size_t nSamples = opts.nCalls / nChunks + (c < opts.nCalls % nChunks);
+      double pt[NumOfVars];
+      int    gridBin[NumOfVars];
+      for (size_t s = 0; s < nSamples; s++) {
+        double jac = 1;
+        for (int v = 0; v < NumOfVars; v++) {
+          double y   = uni(rng) * nGrid;
+          int    j   = std::min(static_cast<int>(y), nGrid - 1);
+          double wid = edges[v][j + 1] - edges[v][j];
+          pt[v]      = edges[v][j] + (y - j) * wid;
+          jac *= nGrid * wid;
+          gridBin[v] = j;
+        }
+
+        double fj = f(pt) * jac;
+        sums.s1 += fj;
+        sums.s2 += fj * fj;
+        for (int v = 0; v < NumOfVars; v++)
+          sums.d[v * nGrid + gridBin[v]] += fj * fj;
+
+        for (size_t m = 0; m < marginals.size(); m++) {
+          long bin = FlatBin(marginals[m], pt);
+          if (bin < 0) continue;
+          sums.b1[offsets[m] + bin] += fj;
+          sums.b2[offsets[m] + bin] += fj * fj;
+        }
+      }
+    });
+
+    // Sum the chunks in order
+    double              s1 = 0, s2 = 0, n = opts.nCalls;
+    std::vector<double> d(NumOfVars * nGrid, 0), b1(nBins, 0), b2(nBins, 0);
+    for (const auto &sums : chunks) {
+      s1 += sums.s1;
+      s2 += sums.s2;
+      for (size_t i = 0; i < d.size(); i++) d[i] += sums.d[i];
+      for (size_t i = 0; i < nBins; i++) {
+        b1[i] += sums.b1[i];
+        b2[i] += sums.b2[i];
+      }
+    }
+    result.nEval += opts.nCalls;
+
+    if (it >= opts.nWarmup) {
+      double I = s1 / n, var = std::max((s2 / n - I * I) / (n - 1), 0.);
+      double w = 1 / (var + 1e-300);
+      iterI.push_back(I);
+      iterV.push_back(var);
+      sumW += w;
+      sumWI += w * I;
+      sumWI2 += w * w * var;
+      for (size_t i = 0; i < nBins; i++) {
+        double bI = b1[i] / n, bV = std::max((b2[i] / n - bI * bI) / (n - 1), 0.);
+        binWI[i] += w * bI;
+        binW2V[i] += w * w * bV;
+      }
+    }
+
+    for (int v = 0; v < NumOfVars; v++)
+      RefineGrid(edges[v],
+                 std::vector<double>(d.begin() + v * nGrid,
+                                     d.begin() + (v + 1) * nGrid),
+                 opts.alpha);
+  }
+
+  if (sumW > 0) {
+    result.integral = sumWI / sumW;
+    result.error    = sqrt(sumWI2) / sumW;
+    for (size_t i = 0; i < iterI.size(); i++)
+      result.chi2_dof += pow(iterI[i] - result.integral, 2) /
+                         (iterV[i] + 1e-300) /
+                         std::max<size_t>(iterI.size() - 1, 1);
+
+    for (size_t m = 0; m < marginals.size(); m++)
+      for (size_t b = 0; b < NumOfBins(marginals[m]); b++) {
+        result.marginals[m].value[b] = binWI[offsets[m] + b] / sumW;
+        result.marginals[m].error[b] = sqrt(binW2V[offsets[m] + b]) / sumW;
+      }
+  }
+
+  return result;
+}
+
+////////////////////////
+// B->D*lnu integrand //
+////////////////////////
+
+IntegrandFactory AngularRate(const BToDstaunu &ff, int isCLN, int isDgamma,
+                             bool lplus, double ml) {
+  // Every thread gets its own copy, as BToDstaunu isn't const-correct; the
+  // BGL coefficients are fitted once, before copying
+  BToDstaunu base = ff;
+  if (isCLN == BToDstaunu::BGL) base.GetBGL();
+  return [=]() -> Integrand {
+    auto copy = std::make_shared<BToDstaunu>(base);
+    return [=](const double *x) {
+      return copy->Compute(x[Q2], x[Ctl], x[Ctv], x[Chi], isDgamma, lplus,
+                           isCLN, ml);
+    };
+  };
+}
+
+Domain AngularDomain(const BToDstaunu &ff, double ml) {
+  return Domain{{ml * ml, -1, -1, 0}, {ff._Dsmaxq2, 1, 1, 2 * BToDstaunu::PI}};
+}
+
+}  // namespace ff_cubature
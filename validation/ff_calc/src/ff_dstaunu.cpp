@@ -36,6 +36,53 @@
 
 #include "ff_dstaunu.hpp"
 
+namespace {
+
+// Least squares solution of X a = y via the normal equations, with the columns
+// of X scaled to 1 first
+std::vector<double> LeastSquares(const std::vector<std::vector<double>> &X,
+                                 const std::vector<double>              &y) {
+  size_t              nrow = X.size(), ncol = nrow ? X[0].size() : 0;
+  std::vector<double> scale(ncol, 0), a(ncol, 0);
+  for (size_t i = 0; i < nrow; i++)
+    for (size_t j = 0; j < ncol; j++)
+      scale[j] = std::max(scale[j], fabs(X[i][j]));
+  for (auto &s : scale)
+    if (s == 0) s = 1;
+
+  // Augmented matrix of the normal equations
+  std::vector<std::vector<double>> M(ncol, std::vector<double>(ncol + 1, 0));
+  for (size_t i = 0; i < nrow; i++)
+    for (size_t j = 0; j < ncol; j++) {
+      for (size_t k = 0; k < ncol; k++)
+        M[j][k] += X[i][j] / scale[j] * X[i][k] / scale[k];
+      M[j][ncol] += X[i][j] / scale[j] * y[i];
+    }
+
+  // Gaussian elimination with partial pivoting
+  for (size_t j = 0; j < ncol; j++) {
+    size_t piv = j;
+    for (size_t k = j + 1; k < ncol; k++)
+      if (fabs(M[k][j]) > fabs(M[piv][j])) piv = k;
+    std::swap(M[j], M[piv]);
+    if (M[j][j] == 0) continue;
+    for (size_t k = j + 1; k < ncol; k++) {
+      double c = M[k][j] / M[j][j];
+      for (size_t l = j; l <= ncol; l++) M[k][l] -= c * M[j][l];
+    }
+  }
+  for (size_t j = ncol; j-- > 0;) {
+    double sum = M[j][ncol];
+    for (size_t k = j + 1; k < ncol; k++) sum -= M[j][k] * a[k];
+    a[j] = M[j][j] != 0 ? sum / M[j][j] : 0;
+  }
+
+  for (size_t j = 0; j < ncol; j++) a[j] /= scale[j];
+  return a;
+}
+
+}  // namespace
+
 BToDstaunu::BToDstaunu(double rho2, double R1, double R2, double R0,
                        double gSR) {
   _rho2 = rho2;
@@ -62,6 +109,8 @@ void BToDstaunu::SetMasses(int isBm) {
   }
   _Dsmaxq2 = pow(_mB - _mDs, 2);
   _isBm    = isBm;
+  // The F1 constraint depends on the masses
+  if (_bgl_set) _bgl = BGLConstrained(_bgl);
 }
 
 double BToDstaunu::FromSP8ToThisModel(double q2, double ctl, double ctv,
@@ -81,7 +130,9 @@ double BToDstaunu::Compute(double q2, double ctl, double ctv, double chi,
                            int isDgamma, bool lplus, int isCLN, double ml) {
   if (q2 <= ml * ml || q2 >= pow(_mB - _mDs, 2)) return 0;
   double A1, V, A2, A0;
-  if (isCLN)
+  if (isCLN == BGL)
+    ComputeBGL(q2, A1, V, A2, A0);
+  else if (isCLN)
     ComputeCLN(q2, A1, V, A2, A0);
   else {
     if (ml < mTau)
@@ -109,6 +160,18 @@ double BToDstaunu::Gamma_q2Angular(double q2, double ctl, double ctv,
 
   // flip represents the spin flip term in Eq 24
   double flip = ml * ml / (2.0 * q2);
+  double ang[13];
+  AngularTerms(ctl, ctv, chi, isDgamma, lplus, ang);
+  double gamma = AngularSum(ang, flip, H0, Ht, Hplus, Hminus);
+
+  return GF * GF / pow(2 * PI, 3) * Vcb * Vcb / 12. / pow(_mB, 2) * gamma *
+         pow(q2 - ml * ml, 2) * pDs / q2;
+}
+
+// The angular terms don't depend on the FF, so they can be shared by several
+// models at the same point
+void BToDstaunu::AngularTerms(double ctl, double ctv, double chi, int isDgamma,
+                              bool lplus, double ang[13]) {
   // these are just time-saving macros for sin(2*theta)
   double sin2tl = 2. * ctl * sqrt(1. - ctl * ctl);
   double sin2tv = 2. * ctv * sqrt(1. - ctv * ctv);
@@ -164,22 +227,26 @@ double BToDstaunu::Gamma_q2Angular(double q2, double ctl, double ctv,
     ang6 *= -1.0;
   }  // tau+ parity flip
 
-  double Hu    = Hplus * Hplus + Hminus * Hminus;
-  double Hl    = H0 * H0;
-  double Hp    = Hplus * Hplus - Hminus * Hminus;
-  double Hs    = 3.0 * Ht * Ht;
-  double Hsl   = Ht * H0;
-  double Hti   = Hplus * Hminus;
-  double Hi    = 0.5 * (Hplus * H0 + Hminus * H0);
-  double Ha    = 0.5 * (Hplus * H0 - Hminus * H0);
-  double Hst   = 0.5 * (Hplus * Ht + Hminus * Ht);
-  double gamma = ang1 * Hu + ang2 * Hl + ang3 * Hti + ang4 * Hi + ang5 * Hp +
-                 ang6 * Ha + ang7 * flip * Hu + ang8 * flip * Hl +
-                 ang9 * flip * Hti + ang10 * flip * Hi + ang11 * flip * Hs +
-                 ang12 * flip * Hsl + ang13 * flip * Hst;
+  double terms[13] = {ang1, ang2, ang3,  ang4,  ang5,  ang6, ang7,
+                      ang8, ang9, ang10, ang11, ang12, ang13};
+  for (int i = 0; i < 13; i++) ang[i] = terms[i];
+}
 
-  return GF * GF / pow(2 * PI, 3) * Vcb * Vcb / 12. / pow(_mB, 2) * gamma *
-         pow(q2 - ml * ml, 2) * pDs / q2;
+double BToDstaunu::AngularSum(const double ang[13], double flip, double H0,
+                              double Ht, double Hplus, double Hminus) {
+  double Hu  = Hplus * Hplus + Hminus * Hminus;
+  double Hl  = H0 * H0;
+  double Hp  = Hplus * Hplus - Hminus * Hminus;
+  double Hs  = 3.0 * Ht * Ht;
+  double Hsl = Ht * H0;
+  double Hti = Hplus * Hminus;
+  double Hi  = 0.5 * (Hplus * H0 + Hminus * H0);
+  double Ha  = 0.5 * (Hplus * H0 - Hminus * H0);
+  double Hst = 0.5 * (Hplus * Ht + Hminus * Ht);
+  return ang[0] * Hu + ang[1] * Hl + ang[2] * Hti + ang[3] * Hi + ang[4] * Hp +
+         ang[5] * Ha + ang[6] * flip * Hu + ang[7] * flip * Hl +
+         ang[8] * flip * Hti + ang[9] * flip * Hi + ang[10] * flip * Hs +
+         ang[11] * flip * Hsl + ang[12] * flip * Hst;
 }
 
 void BToDstaunu::ComputeCLN(double q2, double &A1, double &V, double &A2,
@@ -384,7 +451,9 @@ double BToDstaunu::Normalization(double ml) {
 double BToDstaunu::Compute(double q2, int isCLN, double ml) {
   if (q2 <= ml * ml || q2 >= pow(_mB - _mDs, 2)) return 0;
   double A1, V, A2, A0;
-  if (isCLN)
+  if (isCLN == BGL)
+    ComputeBGL(q2, A1, V, A2, A0);
+  else if (isCLN)
     ComputeCLN(q2, A1, V, A2, A0);
   else {
     if (ml < mTau)
@@ -448,7 +517,9 @@ double BToDstaunu::ComputetL(double ctl, int isCLN, double ml) {
 double BToDstaunu::Compute(double q2, double ctl, int isCLN, double ml) {
   if (q2 <= ml * ml || q2 >= pow(_mB - _mDs, 2)) return 0;
   double A1, V, A2, A0;
-  if (isCLN)
+  if (isCLN == BGL)
+    ComputeBGL(q2, A1, V, A2, A0);
+  else if (isCLN)
     ComputeCLN(q2, A1, V, A2, A0);
   else {
     if (ml < mTau)
@@ -679,4 +750,339 @@ double BToDstaunu::SubPoly(double C[3][7], int indexR) {
   return 0;
 }
 
+// BGL FF from hep-ph/1703.06124, with f = (mB + mD*) A1, g = 2 V / (mB + mD*),
+// F1 = sqrt(q2) H0 and F2 = 2 A0
+
+void BToDstaunu::SetBGL(const BGLParams &pars) {
+  for (auto size : {pars.a_g.size(), pars.a_f.size(), pars.a_F1.size(),
+                    pars.a_F2.size()})
+    if (size > BGLMaxCoefs)
+      throw std::length_error("SetBGL: more than " +
+                              std::to_string(BGLMaxCoefs) +
+                              " coefficients in a z-expansion");
+  _bgl     = BGLConstrained(pars);
+  _bgl_set = true;
+}
+
+// NOTE: The fit is skipped by users of the other FFs, and uses the masses at
+//       the time of the first BGL rate
+const BGLParams &BToDstaunu::GetBGL() {
+  if (!_bgl_set) SetBGL(FitBGLToCLN());
+  return _bgl;
+}
+
+BGLParams BToDstaunu::BGLConstrained(const BGLParams &pars) {
+  BGLParams result = pars;
+  if (!result.a_F1.empty() && !result.a_f.empty())
+    result.a_F1[0] =
+        (_mB - _mDs) * BGLOuter(0, 2) / BGLOuter(0, 1) * result.a_f[0];
+  return result;
+}
+
+// Blaschke factor times outer function, for g (ff = 0), f, F1 and F2 (ff = 3)
+double BToDstaunu::BGLOuter(double z, int ff) {
+  double r  = _mDs / _mB;
+  double tp = pow(_mB + _mDs, 2), tm = pow(_mB - _mDs, 2);
+  double D  = (1 + r) * (1 - z) + 2 * sqrt(r) * (1 + z);
+
+  double        phi;
+  const double *poles;
+  int           nPoles;
+  if (ff == 0) {
+    phi = 16 * r * r * sqrt(nI / (3 * PI * Chi1mT)) * (1 + z) * (1 + z) /
+          (sqrt(1 - z) * pow(D, 4));
+    poles  = Poles1m;
+    nPoles = 4;
+  } else if (ff == 1) {
+    phi = 4 * r / (_mB * _mB) * sqrt(nI / (3 * PI * Chi1pT)) * (1 + z) *
+          pow(1 - z, 1.5) / pow(D, 4);
+    poles  = Poles1p;
+    nPoles = 4;
+  } else if (ff == 2) {
+    phi = 4 * r / pow(_mB, 3) * sqrt(nI / (6 * PI * Chi1pT)) * (1 + z) *
+          pow(1 - z, 2.5) / pow(D, 5);
+    poles  = Poles1p;
+    nPoles = 4;
+  } else {
+    phi = 8 * sqrt(2.) * r * r * sqrt(nI / (PI * Chi0mL)) * (1 + z) * (1 + z) /
+          (sqrt(1 - z) * pow(D, 4));
+    poles  = Poles0m;
+    nPoles = 3;
+  }
+
+  double P = 1;
+  for (int i = 0; i < nPoles; i++) {
+    double a  = sqrt(tp - poles[i] * poles[i]), b = sqrt(tp - tm);
+    double zP = (a - b) / (a + b);
+    P *= (z - zP) / (1 - z * zP);
+  }
+  return P * phi;
+}
+
+void BToDstaunu::BGLBasis(double q2, const BGLParams &pars, double *basis) {
+  double w = (_mB * _mB + _mDs * _mDs - q2) / (2. * _mB * _mDs);
+  double z = (sqrt(w + 1.) - sqrt(2.)) / (sqrt(w + 1.) + sqrt(2.));
+
+  const std::vector<double> *coefs[4] = {&pars.a_g, &pars.a_f, &pars.a_F1,
+                                         &pars.a_F2};
+  for (int ff = 0; ff < 4; ff++) {
+    double denom = BGLOuter(z, ff), zn = 1;
+    for (size_t n = 0; n < coefs[ff]->size(); n++) {
+      *basis++ = zn / denom;
+      zn *= z;
+    }
+  }
+}
+
+// 'layout' gives the size of each block of 'basis'; 'pars' may have fewer
+// coefficients
+void BToDstaunu::BGLFF(const double *basis, const BGLParams &layout,
+                       const BGLParams &pars, double &g, double &f,
+                       double &FF1, double &FF2) {
+  const std::vector<double> *blocks[4] = {&layout.a_g, &layout.a_f,
+                                          &layout.a_F1, &layout.a_F2};
+  const std::vector<double> *coefs[4]  = {&pars.a_g, &pars.a_f, &pars.a_F1,
+                                         &pars.a_F2};
+  double                     ff[4]     = {0, 0, 0, 0};
+  for (int k = 0; k < 4; k++) {
+    for (size_t n = 0; n < coefs[k]->size(); n++)
+      ff[k] += (*coefs[k])[n] * basis[n];
+    basis += blocks[k]->size();
+  }
+
+  g   = ff[0];
+  f   = ff[1];
+  FF1 = ff[2];
+  FF2 = ff[3];
+}
+
+void BToDstaunu::ComputeBGL(double q2, double &A1, double &V, double &A2,
+                            double &A0) {
+  const auto &pars = GetBGL();
+  std::array<double, 4 * BGLMaxCoefs> basis;
+  BGLBasis(q2, pars, basis.data());
+
+  double g, f, FF1, FF2;
+  BGLFF(basis.data(), pars, pars, g, f, FF1, FF2);
+
+  double pDs2 = (_mB * _mB * _mB * _mB + _mDs * _mDs * _mDs * _mDs + q2 * q2 -
+                 2. * _mB * _mB * _mDs * _mDs - 2. * _mB * _mB * q2 -
+                 2. * _mDs * _mDs * q2) /
+                (4. * _mB * _mB);
+
+  A1 = f / (_mB + _mDs);
+  V  = g * (_mB + _mDs) / 2.;
+  A0 = FF2 / 2.;
+  // Inverse of H0 in HadronicAmp; A2 doesn't contribute at zero recoil
+  if (pDs2 > 0)
+    A2 = (_mB + _mDs) / (4. * _mB * _mB * pDs2) *
+         ((_mB * _mB - _mDs * _mDs - q2) * f - 2. * _mDs * FF1);
+  else
+    A2 = 0;
+}
+
+BGLParams BToDstaunu::FitBGLToCLN(int order) {
+  BGLParams layout;
+  layout.a_g.assign(order + 1, 0);
+  layout.a_f  = layout.a_g;
+  layout.a_F1 = layout.a_g;
+  layout.a_F2 = layout.a_g;
+
+  int                              nPoints = 200;
+  std::vector<std::vector<double>> X[4];
+  std::vector<double>              y[4], basis(4 * (order + 1));
+  for (int i = 0; i < nPoints; i++) {
+    double q2 = (i + 0.5) / nPoints * _Dsmaxq2;
+    double A1, V, A2, A0;
+    ComputeCLN(q2, A1, V, A2, A0);
+    BGLBasis(q2, layout, basis.data());
+
+    double pDs2 = (_mB * _mB * _mB * _mB + _mDs * _mDs * _mDs * _mDs +
+                   q2 * q2 - 2. * _mB * _mB * _mDs * _mDs -
+                   2. * _mB * _mB * q2 - 2. * _mDs * _mDs * q2) /
+                  (4. * _mB * _mB);
+    double f   = (_mB + _mDs) * A1;
+    double ffs[4] = {2. * V / (_mB + _mDs), f,
+                     ((_mB * _mB - _mDs * _mDs - q2) * f -
+                      4. * _mB * _mB * pDs2 * A2 / (_mB + _mDs)) /
+                         (2. * _mDs),
+                     2. * A0};
+    for (int k = 0; k < 4; k++) {
+      X[k].emplace_back(basis.begin() + k * (order + 1),
+                        basis.begin() + (k + 1) * (order + 1));
+      y[k].push_back(ffs[k]);
+    }
+  }
+
+  BGLParams result;
+  result.a_g  = LeastSquares(X[0], y[0]);
+  result.a_f  = LeastSquares(X[1], y[1]);
+  result.a_F2 = LeastSquares(X[3], y[3]);
+
+  // a_F1[0] is fixed by the constraint, so only the others are fitted
+  result.a_F1.assign(1, 0);
+  result.a_F1 = BGLConstrained(result).a_F1;
+  for (int i = 0; i < nPoints; i++) {
+    y[2][i] -= result.a_F1[0] * X[2][i][0];
+    X[2][i].erase(X[2][i].begin());
+  }
+  auto higher = LeastSquares(X[2], y[2]);
+  result.a_F1.insert(result.a_F1.end(), higher.begin(), higher.end());
+
+  return result;
+}
+
+double BToDstaunu::FromSP8ToBGL(double q2, double ctl, double ctv, double chi,
+                                int isDgamma, bool lplus, double ml) {
+  double fix_gSR = _gSR;
+  _gSR           = 0;
+  double SP8     = Compute(q2, ctl, ctv, chi, isDgamma, lplus, 0, ml);
+  _gSR           = fix_gSR;
+
+  double bgl = Compute(q2, ctl, ctv, chi, isDgamma, lplus, BGL, ml);
+
+  return bgl / SP8 / NormalizationBGL(GetBGL(), ml);
+}
+
+// All the FF-independent parts (SP8 rate, angular terms and the BGL basis) are
+// computed once per event, so each additional set of coefficients only costs
+// a few dot products. Factors common to both rates cancel and are left out.
+void BToDstaunu::FromSP8ToBGL(const double *q2, const double *ctl,
+                              const double *ctv, const double *chi,
+                              int isDgamma, const bool *lplus,
+                              const BGLParams *pars, size_t npar, double *w,
+                              size_t n, double ml) {
+  std::vector<BGLParams> cpars;
+  std::vector<double>    norms;
+  BGLParams              layout;
+  for (size_t p = 0; p < npar; p++) {
+    cpars.push_back(BGLConstrained(pars[p]));
+    norms.push_back(NormalizationBGL(pars[p], ml));
+    if (pars[p].a_g.size() > layout.a_g.size()) layout.a_g = pars[p].a_g;
+    if (pars[p].a_f.size() > layout.a_f.size()) layout.a_f = pars[p].a_f;
+    if (pars[p].a_F1.size() > layout.a_F1.size()) layout.a_F1 = pars[p].a_F1;
+    if (pars[p].a_F2.size() > layout.a_F2.size()) layout.a_F2 = pars[p].a_F2;
+  }
+  std::vector<double> basis(layout.a_g.size() + layout.a_f.size() +
+                            layout.a_F1.size() + layout.a_F2.size());
+
+  double fix_gSR = _gSR;
+  for (size_t i = 0; i < n; i++) {
+    double q2i = q2[i];
+    if (q2i <= ml * ml || q2i >= _Dsmaxq2) {
+      for (size_t p = 0; p < npar; p++) w[p * n + i] = 0;
+      continue;
+    }
+
+    double A1, V, A2, A0, H0, Ht, Hplus, Hminus;
+    if (ml < mTau)
+      ComputeLinearQ2(q2i, A1, V, A2, A0);
+    else
+      ComputeISGW2(q2i, A1, V, A2, A0);
+    _gSR = 0;
+    HadronicAmp(q2i, A1, V, A2, A0, H0, Ht, Hplus, Hminus);
+    _gSR = fix_gSR;
+
+    double ang[13], flip = ml * ml / (2.0 * q2i);
+    AngularTerms(ctl[i], ctv[i], chi[i], isDgamma, lplus[i], ang);
+    double SP8 = AngularSum(ang, flip, H0, Ht, Hplus, Hminus);
+
+    BGLBasis(q2i, layout, basis.data());
+    double pDs = _mB * _mB * _mB * _mB + _mDs * _mDs * _mDs * _mDs +
+                 q2i * q2i - 2. * _mB * _mB * _mDs * _mDs -
+                 2. * _mB * _mB * q2i - 2. * _mDs * _mDs * q2i;
+    pDs = pDs > 0 ? sqrt(pDs) / (2. * _mB) : 0;
+    double mBp = _mB * pDs, sqrtq2 = sqrt(q2i);
+    double NP  = 1 + _gSR * q2i / (mb_quark + mc_quark);
+
+    for (size_t p = 0; p < npar; p++) {
+      double g, f, FF1, FF2;
+      BGLFF(basis.data(), layout, cpars[p], g, f, FF1, FF2);
+      double bgl = AngularSum(ang, flip, FF1 / sqrtq2, mBp * FF2 / sqrtq2 * NP,
+                              f + mBp * g, f - mBp * g);
+      w[p * n + i] = bgl / SP8 / norms[p];
+    }
+  }
+}
+
+double BToDstaunu::NormalizationBGL(const BGLParams &pars, double ml) {
+  const auto &entry = BGLNormalizationEntry(pars, ml);
+  auto        cpars = BGLConstrained(pars);
+
+  const std::vector<double> *coefs[4] = {&cpars.a_g, &cpars.a_f, &cpars.a_F1,
+                                         &cpars.a_F2};
+  double                     RateBGL  = 0;
+  for (int k = 0; k < 4; k++) {
+    size_t size = coefs[k]->size();
+    for (size_t i = 0; i < size; i++)
+      for (size_t j = 0; j < size; j++)
+        RateBGL += entry.Rate[k][i * size + j] * (*coefs[k])[i] *
+                   (*coefs[k])[j];
+  }
+  return RateBGL / entry.RateSP8;
+}
+
+// Simpson integration of Gamma_q2, split into the products of basis functions
+const BToDstaunu::BGLNormEntry &BToDstaunu::BGLNormalizationEntry(
+    const BGLParams &pars, double ml) {
+  size_t order[4] = {pars.a_g.size(), pars.a_f.size(), pars.a_F1.size(),
+                     pars.a_F2.size()};
+  for (const auto &entry : _bgl_norm)
+    if (entry.ml == ml && entry.gSR == _gSR && entry.isBm == _isBm &&
+        std::equal(order, order + 4, entry.order))
+      return entry;
+
+  BGLNormEntry entry{ml, _gSR, static_cast<int>(_isBm), {}, 0, {}};
+  std::copy(order, order + 4, entry.order);
+  for (int k = 0; k < 4; k++) entry.Rate.emplace_back(order[k] * order[k], 0.);
+
+  std::vector<double> basis(order[0] + order[1] + order[2] + order[3]);
+  int                 nPoints = 10000;
+  double              minX = ml * ml, maxX = _Dsmaxq2;
+  double              dx = (maxX - minX) / static_cast<double>(nPoints);
+  for (int node = 0; node <= 2 * nPoints; node++) {
+    double q2 = minX + node * dx / 2;
+    if (q2 <= ml * ml || q2 >= _Dsmaxq2) continue;
+    double simpson = node % 2 ? 4 : (node == 0 || node == 2 * nPoints ? 1 : 2);
+
+    double pDs = _mB * _mB * _mB * _mB + _mDs * _mDs * _mDs * _mDs + q2 * q2 -
+                 2. * _mB * _mB * _mDs * _mDs - 2. * _mB * _mB * q2 -
+                 2. * _mDs * _mDs * q2;
+    pDs = pDs > 0 ? sqrt(pDs) / (2. * _mB) : 0;
+    double Factor = GF * GF * Vcb * Vcb * pDs * q2 /
+                    (96 * pow(PI, 3) * _mB * _mB) * pow(1 - ml * ml / q2, 2);
+    double lep = 1 + ml * ml / (2 * q2);
+    double NP  = 1 + _gSR * q2 / (mb_quark + mc_quark);
+
+    // Gamma_q2 with H+^2 + H-^2 = 2 f^2 + 2 (mB pD g)^2, H0 = F1 / sqrt(q2)
+    // and Ht = mB pD F2 / sqrt(q2)
+    double weight[4] = {
+        Factor * lep * 2 * _mB * _mB * pDs * pDs, Factor * lep * 2,
+        Factor * lep / q2,
+        Factor * 3 * ml * ml / (2 * q2) * _mB * _mB * pDs * pDs / q2 * NP * NP};
+
+    BGLBasis(q2, pars, basis.data());
+    const double *b = basis.data();
+    for (int k = 0; k < 4; k++) {
+      double c = dx / 6. * simpson * weight[k];
+      for (size_t i = 0; i < order[k]; i++)
+        for (size_t j = 0; j < order[k]; j++)
+          entry.Rate[k][i * order[k] + j] += c * b[i] * b[j];
+      b += order[k];
+    }
+  }
+
+  double totalRate = hbar / _BLifeTime;
+  for (auto &rate : entry.Rate)
+    for (auto &r : rate) r /= totalRate;
+
+  double fix_gSR = _gSR;
+  _gSR           = 0;
+  entry.RateSP8  = Rate(0, ml);
+  _gSR           = fix_gSR;
+
+  _bgl_norm.push_back(entry);
+  return _bgl_norm.back();
+}
+
 BToDstaunu::~BToDstaunu() {}
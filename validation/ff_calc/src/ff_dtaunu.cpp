@@ -0,0 +1,342 @@
+//------------------------------------------------------------------------------
+// File and Version Information:
+//      Companion of ff_dstaunu.cpp for B -> D l nu (pseudoscalar D)
+//
+// Description:
+//    Calculation of the B->DlNu rates in q2 and cos(thetaL) for a lepton of
+//    mass ml, with CLN and ISGW2 FF. See ff_dtaunu.hpp.
+//
+// Author List:
+//      Yipeng Sun
+//
+// Revision History:
+//      26/10/18 yipengsun -- Created off ff_dstaunu by M. Franco Sevilla
+//------------------------------------------------------------------------------
+
+#include "ff_dtaunu.hpp"
+
+namespace {
+
+// Same as BToDstaunu::EvtGetas and BToDstaunu::EvtGetGammaji
+double EvtGetas(double massq, double massx) {
+  double lqcd2 = 0.04;
+  double nflav = 4;
+  double temp  = 0.6;
+  if (massx > 0.6) {
+    if (massq < 1.85) {
+      nflav = 3.0;
+    }
+    temp = 12.0 * BToDtaunu::PI / (33.0 - 2.0 * nflav) /
+           log(massx * massx / lqcd2);
+  }
+  return temp;
+}
+
+double EvtGetGammaji(double z) {
+  double temp;
+  temp = 2 + ((2.0 * z) / (1 - z)) * log(z);
+  temp = -1.0 * temp;
+  return temp;
+}
+
+}  // namespace
+
+BToDtaunu::BToDtaunu(double rho2, double V1, double Delta, double gSR) {
+  _rho2  = rho2;
+  _V1    = V1;
+  _Delta = Delta;
+  _gSR   = gSR;
+  SetMasses(1);  // Charged B
+}
+
+void BToDtaunu::SetMasses(int isBm) {
+  if (isBm) {  // Charged B, to D0
+    _mB        = 5.2792;
+    _mBSP8     = 5.2791;
+    _mD        = 1.86484;
+    _mDSP8     = 1.8645;
+    _BLifeTime = 1.638e-12;
+  } else {  // Neutral B, to D+
+    _mB        = 5.2795;
+    _mBSP8     = 5.2794;
+    _mD        = 1.86966;
+    _mDSP8     = 1.8693;
+    _BLifeTime = 1.525e-12;
+  }
+  _Dmaxq2 = pow(_mB - _mD, 2);
+  _isBm   = isBm;
+  SetISGW2Constants();
+}
+
+double BToDtaunu::FromISGW2ToThisModel(double q2, double ctl, double ml) {
+  double fix_gSR = _gSR;
+  _gSR           = 0;
+  double ISGW2   = Compute(q2, ctl, 0, ml);
+  _gSR           = fix_gSR;
+
+  double cln = Compute(q2, ctl, 1, ml);
+
+  return cln / ISGW2 / Normalization(ml);
+}
+
+// Same as above for n events. All factors common to both models (phase space,
+// GF^2 Vcb^2, 1/q2) cancel in the ratio and are left out, and the ISGW2
+// constants are taken from SetMasses, so that the loop has no calls but sqrt.
+void BToDtaunu::FromISGW2ToThisModel(const double *q2, const double *ctl,
+                                     double *w, size_t n, double ml) {
+  double norm = Normalization(ml), ml2 = ml * ml;
+  double mB2 = _mB * _mB, mD2 = _mD * _mD, mBmD2 = 2 * _mB * _mD;
+  double sqrt2 = sqrt(2.), r = _mD / _mB;
+  double cln_p = _V1 * (1 + r) / (2 * sqrt(r)), cln_0 = _V1 * sqrt(r) / (1 + r);
+  double z1 = 8 * _rho2, z2 = 51 * _rho2 - 10, z3 = 252 * _rho2 - 84;
+  double np    = _gSR / (mb_quark - mc_quark);
+  double mSP82 = _mBSP8 * _mBSP8 - _mDSP8 * _mDSP8;
+
+  for (size_t i = 0; i < n; i++) {
+    double t = q2[i], c = ctl[i];
+
+    // (2 mB pD)^2
+    double lambda = mB2 * mB2 + mD2 * mD2 + t * t - 2 * mB2 * mD2 -
+                    2 * mB2 * t - 2 * mD2 * t;
+    double sqrtl = sqrt(lambda > 0 ? lambda : 0);
+
+    double wv  = (mB2 + mD2 - t) / mBmD2;
+    double wm1 = wv - 1;
+    double sw  = sqrt(wv + 1);
+    double z   = (sw - sqrt2) / (sw + sqrt2);
+    double v1  = 1 - z1 * z + z2 * z * z - z3 * z * z * z;
+    double s1 =
+        v1 * (1 + _Delta * (-0.019 + 0.041 * wm1 - 0.015 * wm1 * wm1));
+    double Acln = sqrtl * cln_p * v1;
+    double Bcln = (mB2 - mD2) * cln_0 * (wv + 1) * s1 * (1 + np * t);
+
+    double tc  = t > _isgw2_tm ? 0.99 * _isgw2_tm : t;
+    double f3  = 1 + _isgw2_r2 * (_isgw2_tm - tc) / 12;
+    double fp  = _isgw2_fplus / (f3 * f3);
+    double f0  = _isgw2_fminus / (f3 * f3) * t / mSP82 + fp;
+    double Ai  = sqrtl * fp;
+    double Bi  = (mB2 - mD2) * f0;
+
+    double Hcln  = Bcln + Acln * c;
+    double Hi    = Bi + Ai * c;
+    double cln   = (1 - c * c) * Acln * Acln + ml2 / t * Hcln * Hcln;
+    double isgw2 = (1 - c * c) * Ai * Ai + ml2 / t * Hi * Hi;
+
+    w[i] = (t > ml2 && t < _Dmaxq2) ? cln / isgw2 / norm : 0.;
+  }
+}
+
+double BToDtaunu::Compute(double q2, double ctl, int isCLN, double ml) {
+  if (q2 <= ml * ml || q2 >= _Dmaxq2) return 0;
+  double fplus, fzero;
+  if (isCLN)
+    ComputeCLN(q2, fplus, fzero);
+  else
+    ComputeISGW2(q2, fplus, fzero);
+
+  return Gamma_q2tL(q2, ctl, fplus, fzero, ml);
+}
+
+double BToDtaunu::Compute(double q2, int isCLN, double ml) {
+  if (q2 <= ml * ml || q2 >= _Dmaxq2) return 0;
+  double fplus, fzero;
+  if (isCLN)
+    ComputeCLN(q2, fplus, fzero);
+  else
+    ComputeISGW2(q2, fplus, fzero);
+
+  return Gamma_q2(q2, fplus, fzero, ml);
+}
+
+// V1 and S1 from hep-ph/9712417, with S1/V1 from hep-ph/1005.4306
+void BToDtaunu::ComputeCLN(double q2, double &fplus, double &fzero) {
+  double w   = (_mB * _mB + _mD * _mD - q2) / (2. * _mB * _mD);
+  double z   = (sqrt(w + 1.) - sqrt(2.)) / (sqrt(w + 1.) + sqrt(2.));
+  double V1w = _V1 * (1. - 8. * _rho2 * z + (51. * _rho2 - 10.) * z * z -
+                      (252. * _rho2 - 84.) * z * z * z);
+  double wm1 = w - 1.0;
+  double S1w = V1w * (1. + _Delta * (-0.019 + 0.041 * wm1 - 0.015 * wm1 * wm1));
+  double r   = _mD / _mB;
+
+  fplus = (1. + r) / (2. * sqrt(r)) * V1w;
+  fzero = sqrt(r) * (w + 1.) / (1. + r) * S1w;
+}
+
+// This code liberally stolen from EvtGenModels/EvtISGW2FF.cc (EvtISGW2FF1S0)
+void BToDtaunu::SetISGW2Constants() {
+  double msb  = 5.2;
+  double msd  = 0.33;
+  double bb2  = 0.431 * 0.431;
+  double mbb  = 5.31;
+  double nf   = 4.0;
+  double msq  = 1.82;
+  double bx2  = 0.45 * 0.45;
+  double mbx  = 0.75 * 2.01 + 0.25 * 1.87;
+  double nfp  = 3.0;
+  double mtb  = msb + msd;
+  double mtx  = msq + msd;
+  double mup  = 1.0 / (1.0 / msq + 1.0 / msb);
+  double bbx2 = 0.5 * (bb2 + bx2);
+  double mb   = _mBSP8;
+  double mx   = _mDSP8;
+  double mqm  = 0.1;
+
+  _isgw2_tm = (mb - mx) * (mb - mx);
+  _isgw2_r2 = 3.0 / (4.0 * msb * msq) + 3 * msd * msd / (2 * mbb * mbx * bbx2) +
+              (16.0 / (mbb * mbx * (33.0 - 2.0 * nfp))) *
+                  log(EvtGetas(mqm, mqm) / EvtGetas(msq, msq));
+
+  // f3 without its q2 dependence
+  double f3      = sqrt(mtx / mtb) * pow(sqrt(bx2 * bb2) / bbx2, 1.5);
+  double ai      = -1.0 * (6.0 / (33.0 - 2.0 * nf));
+  double cji     = pow((EvtGetas(msb, msb) / EvtGetas(msq, msq)), ai);
+  double zji     = msq / msb;
+  double gammaji = EvtGetGammaji(zji);
+  double chiji   = -1.0 - (gammaji / (1 - zji));
+  double betaji_fppfm = gammaji - (2.0 / 3.0) * chiji;
+  double betaji_fpmfm = gammaji + (2.0 / 3.0) * chiji;
+  double rfppfm =
+      cji * (1.0 + betaji_fppfm * EvtGetas(msq, sqrt(msb * msq)) / PI);
+  double rfpmfm =
+      cji * (1.0 + betaji_fpmfm * EvtGetas(msq, sqrt(msb * msq)) / PI);
+  double f3fppfm = f3 * pow((mbb / mtb), -0.5) * pow((mbx / mtx), 0.5);
+  double f3fpmfm = f3 * pow((mbb / mtb), 0.5) * pow((mbx / mtx), -0.5);
+  double fppfm   = f3fppfm * rfppfm *
+                 (2.0 - ((mtx / msq) *
+                         (1 - ((msd * msq * bb2) / (2.0 * mup * mtx * bbx2)))));
+  double fpmfm = f3fpmfm * rfpmfm * (mtb / msq) *
+                 (1 - ((msd * msq * bb2) / (2.0 * mup * mtx * bbx2)));
+
+  _isgw2_fplus  = (fppfm + fpmfm) / 2.0;
+  _isgw2_fminus = (fppfm - fpmfm) / 2.0;
+}
+
+void BToDtaunu::ComputeISGW2(double q2, double &fplus, double &fzero) {
+  double t = q2;
+  if (t > _isgw2_tm) t = 0.99 * _isgw2_tm;
+  double f3 = 1.0 + _isgw2_r2 * (_isgw2_tm - t) / 12.0;
+
+  fplus        = _isgw2_fplus / (f3 * f3);
+  double fminus = _isgw2_fminus / (f3 * f3);
+  // As in EvtISGW2FF::getscalarff, with the q2 before the cutoff
+  fzero = fminus / ((_mBSP8 * _mBSP8 - _mDSP8 * _mDSP8) / q2) + fplus;
+}
+
+void BToDtaunu::HadronicAmp(double q2, double fplus, double fzero, double &H0,
+                            double &Ht) {
+  double pD = _mB * _mB * _mB * _mB + _mD * _mD * _mD * _mD + q2 * q2 -
+              2. * _mB * _mB * _mD * _mD - 2. * _mB * _mB * q2 -
+              2. * _mD * _mD * q2;
+  if (pD < 0)
+    pD = 0;
+  else
+    pD = sqrt(pD) / (2. * _mB);
+
+  H0 = 2 * _mB * pD * fplus / sqrt(q2);
+  Ht = (_mB * _mB - _mD * _mD) * fzero / sqrt(q2) *
+       (1 + _gSR * q2 / (mb_quark - mc_quark));
+}
+
+// BToDstaunu::Gamma_q2tL with H+ = H- = 0
+double BToDtaunu::Gamma_q2tL(double q2, double ctl, double fplus, double fzero,
+                             double ml) {
+  double pD = _mB * _mB * _mB * _mB + _mD * _mD * _mD * _mD + q2 * q2 -
+              2. * _mB * _mB * _mD * _mD - 2. * _mB * _mB * q2 -
+              2. * _mD * _mD * q2;
+  if (pD < 0)
+    pD = 0;
+  else
+    pD = sqrt(pD) / (2. * _mB);
+
+  double H0, Ht, stl = sqrt(1 - ctl * ctl);
+  HadronicAmp(q2, fplus, fzero, H0, Ht);
+
+  double Term1  = 2 * stl * stl * H0 * H0;
+  double Term2  = ml * ml / q2 * 2 * pow(Ht + H0 * ctl, 2);
+  double Factor = GF * GF * Vcb * Vcb * pD * q2 /
+                  (256 * pow(PI, 3) * _mB * _mB) * pow(1 - ml * ml / q2, 2);
+  return Factor * (Term1 + Term2);
+}
+
+// The q2 spectrum (no thetaL) is only used to integrate the rates
+double BToDtaunu::Gamma_q2(double q2, double fplus, double fzero, double ml) {
+  double pD = _mB * _mB * _mB * _mB + _mD * _mD * _mD * _mD + q2 * q2 -
+              2. * _mB * _mB * _mD * _mD - 2. * _mB * _mB * q2 -
+              2. * _mD * _mD * q2;
+  if (pD < 0)
+    pD = 0;
+  else
+    pD = sqrt(pD) / (2. * _mB);
+
+  double H0, Ht;
+  HadronicAmp(q2, fplus, fzero, H0, Ht);
+
+  double Term1  = H0 * H0 * (1 + ml * ml / (2 * q2));
+  double Term2  = 3 * ml * ml / (2 * q2) * Ht * Ht;
+  double Factor = GF * GF * Vcb * Vcb * pD * q2 /
+                  (96 * pow(PI, 3) * _mB * _mB) * pow(1 - ml * ml / q2, 2);
+  return Factor * (Term1 + Term2);
+}
+
+// Simpson integration over q2
+double BToDtaunu::IntRate(int isCLN, double ml, int nPoints) {
+  double minX = ml * ml, maxX = _Dmaxq2;
+  double intF = 0, x = minX, dx = (maxX - minX) / static_cast<double>(nPoints);
+  double Fmin = Compute(x, isCLN, ml), Fval;
+  for (int step = 0; step < nPoints; step++) {
+    Fval = Compute(x + dx / 2, isCLN, ml);
+    intF += dx / 6. * (Fmin + 4 * Fval);
+    x += dx;
+    Fmin = Compute(x, isCLN, ml);
+    intF += dx / 6. * Fmin;
+  }
+
+  return intF;
+}
+
+// Decay rate of B->Dlnu with respect to the total rate
+double BToDtaunu::Rate(int isCLN, double ml) {
+  double totalRate = hbar / _BLifeTime;
+  return IntRate(isCLN, ml) / totalRate;
+}
+
+// The CLN rate is exactly V1^2 times a polynomial of order 2 in rho2, so 3
+// integrations are enough for any V1 and rho2
+const BToDtaunu::NormEntry &BToDtaunu::NormalizationEntry(double ml) {
+  for (const auto &entry : _norm)
+    if (entry.ml == ml && entry.isBm == _isBm && entry.Delta == _Delta &&
+        entry.gSR == _gSR)
+      return entry;
+
+  double    fixRho2 = _rho2, fixV1 = _V1, fixgSR = _gSR, F[3];
+  NormEntry entry{ml, _Delta, _gSR, _isBm, 0, {}};
+
+  _V1 = 1;
+  for (int i = 0; i < 3; i++) {
+    _rho2 = i;
+    F[i]  = Rate(1, ml);
+  }
+  entry.Coef[0] = F[0];
+  entry.Coef[2] = (F[2] - 2 * F[1] + F[0]) / 2;
+  entry.Coef[1] = F[1] - F[0] - entry.Coef[2];
+
+  _gSR            = 0;
+  entry.RateISGW2 = Rate(0, ml);
+
+  _rho2 = fixRho2;
+  _V1   = fixV1;
+  _gSR  = fixgSR;
+
+  _norm.push_back(entry);
+  return _norm.back();
+}
+
+double BToDtaunu::Normalization(double ml) {
+  const auto &entry = NormalizationEntry(ml);
+  double      RateCLN =
+      _V1 * _V1 *
+      (entry.Coef[0] + entry.Coef[1] * _rho2 + entry.Coef[2] * _rho2 * _rho2);
+  return RateCLN / entry.RateISGW2;
+}
+
+BToDtaunu::~BToDtaunu() {}
@@ -0,0 +1,321 @@
+// Author: Yipeng Sun
+// License: GPLv2
+// Description: Approximate ISGW2 -> CLN FF weights with an interpolated lookup
+//              table over (q2, cos(theta_l), cos(theta_D), chi), built once
+//              with BToDstaunu as the oracle. No HAMMER in the loop.
+// Last Change: Sat Oct 17, 2026 at 10:06 PM +0200
+
+#include <TFile.h>
+#include <TLorentzVector.h>
+#include <TTree.h>
+#include <TTreeReader.h>
+#include <TTreeReaderValue.h>
+#include <TVector3.h>
+
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <unordered_map>
+
+#include <cxxopts.hpp>
+#include <ff_dstaunu.hpp>
+
+#include "truth_source.h"
+#include "weight_table.h"
+
+using namespace std;
+
+// Keep away from the phase space boundaries, where both rates vanish
+const double q2_margin = 1e-4;  // in GeV^2
+
+//////////////////////
+// Decay kinematics //
+//////////////////////
+
+struct Angles {
+  double q2, ctl, ctv, chi;
+};
+
+TLorentzVector lorentz_vec_gev(const TruthEvent& evt, TruthPart p) {
+  TLorentzVector mom;
+  mom.SetPxPyPzE(evt.px[p] / 1e3, evt.py[p] / 1e3, evt.pz[p] / 1e3,
+                 evt.pe[p] / 1e3);
+  return mom;
+}
+
+// NOTE: theta_l is the angle between the tau in the W rest frame and the W
+//       direction in the B rest frame; theta_D is the angle between the D0 in
+//       the D* rest frame and the D* direction in the B rest frame; chi is the
+//       angle between the two decay planes. The rate only depends on
+//       cos(chi) and cos(2 chi), so chi is folded into [0, pi].
+Angles calc_angles(const TruthEvent& evt) {
+  auto b   = lorentz_vec_gev(evt, B0);
+  auto dst = lorentz_vec_gev(evt, Dst);
+  auto d0  = lorentz_vec_gev(evt, D0);
+  auto tau = lorentz_vec_gev(evt, Tau);
+  auto nu  = lorentz_vec_gev(evt, AntiNuTau);
+
+  // Go to the B rest frame
+  auto b_boost = -b.BoostVector();
+  for (auto mom : {&dst, &d0, &tau, &nu}) mom->Boost(b_boost);
+  auto w = tau + nu;
+
+  Angles result{};
+  result.q2 = w.M2();
+
+  auto tau_w = tau;
+  tau_w.Boost(-w.BoostVector());
+  result.ctl = cos(tau_w.Vect().Angle(w.Vect()));
+
+  auto d0_dst = d0;
+  d0_dst.Boost(-dst.BoostVector());
+  result.ctv = cos(d0_dst.Vect().Angle(dst.Vect()));
+
+  auto n_had = dst.Vect().Cross(d0.Vect());
+  auto n_lep = w.Vect().Cross(tau.Vect());
+  result.chi = n_had.Angle(n_lep);
+
+  return result;
+}
+
+//////////////////
+// Table oracle //
+//////////////////
+
+// Table axes: q2, cos(theta_l), cos(theta_D), chi, and the tau charge
+vector<weight_table::Axis> table_axes(const BToDstaunu& ff, int init_nodes) {
+  auto q2_min = pow(BToDstaunu::mTau, 2) + q2_margin;
+  auto q2_max = pow(ff._mB - ff._mDs, 2) - q2_margin;
+
+  return {weight_table::uniform_axis("q2", q2_min, q2_max, init_nodes),
+          weight_table::uniform_axis("ctl", -1, 1, init_nodes),
+          weight_table::uniform_axis("ctv", -1, 1, init_nodes),
+          weight_table::uniform_axis("chi", 0, M_PI, init_nodes),
+          weight_table::Axis{"lplus", {0, 1}, true}};
+}
+
+void print_report(const string& title, const weight_table::Report& rep) {
+  cout << title << ": " << rep.num_points << " points, " << rep.num_nodes
+       << " nodes; |table - oracle| max " << rep.max_err << ", mean "
+       << rep.mean_err << ", 99% quantile " << rep.p99_err << endl;
+}
+
+int build(const string& table_path, double target, size_t max_nodes,
+          size_t num_points, int init_nodes, uint64_t seed) {
+  BToDstaunu ff{};
+  ff.SetMasses(0);  // B0
+
+  auto oracle = [&](const double* x) {
+    return ff.FromSP8ToThisModel(x[0], x[1], x[2], x[3], 0, x[4] > 0.5,
+                                 BToDstaunu::mTau);
+  };
+
+  mt19937_64 rng(seed);
+  auto       start = chrono::steady_clock::now();
+
+  weight_table::Report report{};
+  auto table = weight_table::build(table_axes(ff, init_nodes), oracle, target,
+                                   max_nodes, num_points, rng, report);
+  chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+
+  cout << (report.converged ? "Converged" : "NOT converged (node limit hit)")
+       << " after " << report.iterations << " refinements in "
+       << elapsed.count() << " s" << endl;
+  for (const auto& axis : table.axes())
+    cout << "  " << left << setw(8) << axis.name << right << setw(6)
+         << axis.nodes.size() << " nodes" << endl;
+  cout << "  table size: " << table.num_nodes() * sizeof(double) / 1048576.
+       << " MiB" << endl;
+
+  // Independent points, so that the report isn't biased by the refinement
+  auto points = weight_table::random_points(table.axes(), num_points, rng);
+  print_report("Validation", weight_table::validate(table, oracle, points));
+
+  table.save(table_path);
+  return report.converged ? 0 : 2;
+}
+
+/////////////////////
+// Apply the table //
+/////////////////////
+
+struct EventKeyHash {
+  size_t operator()(const pair<UInt_t, ULong64_t>& key) const {
+    return hash<ULong64_t>{}(key.second) ^ (hash<UInt_t>{}(key.first) << 1);
+  }
+};
+
+using RefWeights =
+    unordered_map<pair<UInt_t, ULong64_t>, Double_t, EventKeyHash>;
+
+RefWeights load_ref_weights(const string& path, const string& tree,
+                            const string& branch) {
+  RefWeights  result{};
+  TFile       file(path.c_str(), "read");
+  TTreeReader reader(tree.c_str(), &file);
+
+  TTreeReaderValue<UInt_t>    run(reader, "runNumber");
+  TTreeReaderValue<ULong64_t> evt(reader, "eventNumber");
+  TTreeReaderValue<Double_t>  w(reader, branch.c_str());
+  while (reader.Next()) result.emplace(make_pair(*run, *evt), *w);
+
+  return result;
+}
+
+int apply(const string& table_path, const string& input_path,
+          const string& output_path, const string& tree,
+          const string& output_tree, const RefWeights& ref) {
+  auto table = weight_table::Table::load(table_path);
+
+  TFile           input_file(input_path.c_str(), "read");
+  TFile           output_file(output_path.c_str(), "recreate");
+  TreeTruthSource truth(tree.c_str(), &input_file);
+
+  output_file.cd();
+  auto output = new TTree(output_tree.c_str(), output_tree.c_str());
+
+  UInt_t    runNumber;
+  ULong64_t eventNumber;
+  Double_t  w_ff_lut, q2, ctl, ctv, chi;
+  output->Branch("runNumber", &runNumber);
+  output->Branch("eventNumber", &eventNumber);
+  output->Branch("w_ff_lut", &w_ff_lut);
+  output->Branch("q2_true", &q2);
+  output->Branch("ctl_true", &ctl);
+  output->Branch("ctv_true", &ctv);
+  output->Branch("chi_true", &chi);
+
+  // Comparison with reference (e.g. HAMMER) weights
+  Long64_t num_matched = 0;
+  double   sum_diff = 0, sum_diff2 = 0, max_diff = 0;
+  double   sum_x = 0, sum_y = 0, sum_xx = 0, sum_yy = 0, sum_xy = 0;
+
+  double     lookup_time = 0;
+  Long64_t   num_of_evt  = 0;
+  TruthEvent evt;
+  while (truth.next(evt)) {
+    auto start = chrono::steady_clock::now();
+
+    auto   ang   = calc_angles(evt);
+    double x[5]  = {ang.q2, ang.ctl, ang.ctv, ang.chi,
+                   evt.id[Tau] < 0 ? 1. : 0.};  // tau+ has a negative ID
+    w_ff_lut     = table(x);
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+    lookup_time += elapsed.count();
+
+    runNumber   = evt.runNumber;
+    eventNumber = evt.eventNumber;
+    q2          = ang.q2;
+    ctl         = ang.ctl;
+    ctv         = ang.ctv;
+    chi         = ang.chi;
+    output->Fill();
+    num_of_evt++;
+
+    auto itr = ref.find(make_pair(evt.runNumber, evt.eventNumber));
+    if (itr == ref.end()) continue;
+
+    auto w_ref = itr->second;
+    auto diff  = w_ff_lut - w_ref;
+    num_matched++;
+    sum_diff += diff;
+    sum_diff2 += diff * diff;
+    max_diff = max(max_diff, fabs(diff));
+    sum_x += w_ff_lut;
+    sum_y += w_ref;
+    sum_xx += w_ff_lut * w_ff_lut;
+    sum_yy += w_ref * w_ref;
+    sum_xy += w_ff_lut * w_ref;
+  }
+
+  output_file.Write("", TObject::kOverwrite);
+
+  cout << "Applied the table to " << num_of_evt << " entries; angles and "
+       << "lookup took " << lookup_time << " s ("
+       << num_of_evt / lookup_time << " entries/s)" << endl;
+
+  if (num_matched > 0) {
+    auto n    = static_cast<double>(num_matched);
+    auto corr = (sum_xy / n - sum_x * sum_y / n / n) /
+                sqrt((sum_xx / n - pow(sum_x / n, 2)) *
+                     (sum_yy / n - pow(sum_y / n, 2)));
+    cout << "Compared with " << num_matched << " reference weights: "
+         << "mean(table - ref) " << sum_diff / n << ", RMS "
+         << sqrt(sum_diff2 / n) << ", max |diff| " << max_diff
+         << ", correlation " << corr << "; mean weight " << sum_x / n
+         << " vs. " << sum_y / n << endl;
+  }
+
+  return 0;
+}
+
+int main(int argc, char** argv) {
+  cxxopts::Options argopts(
+      "ff_weight_table",
+      "Build ('build <table>') or apply ('apply <table> <input> <output>') an "
+      "interpolated ISGW2 -> CLN FF weight table.");
+
+  // clang-format off
+  argopts.add_options()
+    ("h,help", "print help")
+    ("mode", "build or apply", cxxopts::value<string>())
+    ("table", "specify weight table file", cxxopts::value<string>())
+    ("input", "specify input ntuple", cxxopts::value<string>())
+    ("output", "specify output ntuple", cxxopts::value<string>())
+    ("a,accuracy", "specify the target max absolute error of the weights",
+     cxxopts::value<double>()->default_value("0.02"))
+    ("max-nodes", "specify the maximum number of table nodes",
+     cxxopts::value<size_t>()->default_value("20000000"))
+    ("points", "specify the number of random points to check the table",
+     cxxopts::value<size_t>()->default_value("100000"))
+    ("init-nodes", "specify the initial number of nodes per axis",
+     cxxopts::value<int>()->default_value("5"))
+    ("seed", "specify the random seed",
+     cxxopts::value<uint64_t>()->default_value("42"))
+    ("t,tree", "specify input tree",
+     cxxopts::value<string>()->default_value("mc_dst_tau_aux"))
+    ("O,output-tree", "specify output tree",
+     cxxopts::value<string>()->default_value("mc_dst_tau_ff_w_lut"))
+    ("ref", "specify a weight ntuple (e.g. from rdx-run1-sample.w) to compare "
+            "with", cxxopts::value<string>())
+    ("ref-tree", "specify the tree of the reference weights",
+     cxxopts::value<string>()->default_value("mc_dst_tau_ff_w"))
+    ("ref-branch", "specify the branch of the reference weights",
+     cxxopts::value<string>()->default_value("w_ff"))
+  ;
+  // clang-format on
+
+  argopts.parse_positional({"mode", "table", "input", "output"});
+  auto parsed_args = argopts.parse(argc, argv);
+
+  auto mode = parsed_args.count("mode") ? parsed_args["mode"].as<string>() : "";
+  auto ok_args = (mode == "build" && parsed_args.count("table")) ||
+                 (mode == "apply" && parsed_args.count("output"));
+  if (parsed_args.count("help") || !ok_args) {
+    cout << argopts.help() << endl;
+    return parsed_args.count("help") ? 0 : 1;
+  }
+
+  auto table_path = parsed_args["table"].as<string>();
+
+  if (mode == "build")
+    return build(table_path, parsed_args["accuracy"].as<double>(),
+                 parsed_args["max-nodes"].as<size_t>(),
+                 parsed_args["points"].as<size_t>(),
+                 parsed_args["init-nodes"].as<int>(),
+                 parsed_args["seed"].as<uint64_t>());
+
+  RefWeights ref{};
+  if (parsed_args.count("ref"))
+    ref = load_ref_weights(parsed_args["ref"].as<string>(),
+                           parsed_args["ref-tree"].as<string>(),
+                           parsed_args["ref-branch"].as<string>());
+
+  return apply(table_path, parsed_args["input"].as<string>(),
+               parsed_args["output"].as<string>(),
+               parsed_args["tree"].as<string>(),
+               parsed_args["output-tree"].as<string>(), ref);
+}
@@ -1,10 +1,12 @@
 // Author: Yipeng Sun
 // License: GPLv2
 // Description: Validation of FF reweighting from ISGW2 -> CLN
-// Last Change: Mon Nov 09, 2020 at 01:36 AM +0100
+// Last Change: Sun Oct 18, 2026 at 06:20 AM +0200
 
 #include <iostream>
+#include <map>
 #include <string>
+#include <utility>
 
 #include <TCanvas.h>
 #include <TFile.h>
@@ -16,6 +18,8 @@
 
 #include <ff_dstaunu.hpp>
 
+#include "truth_cache.h"
+
 using namespace std;
 
 enum BMeson { Charged = 1, Neutral = 0 };
@@ -83,6 +87,41 @@ TH1D fill_histo(TTree* tree, const char* branch, const char* weight,
   return histo;
 }
 
+// Same, with the true q2 computed from the truth momenta of a cache instead,
+// and the weights matched by (runNumber, eventNumber); cached events without a
+// weight are left out of the reweighted histogram
+void fill_histos_from_cache(const string& path, TTree* weight_tree,
+                            TH1D& histo_orig, TH1D& histo_reweighted) {
+  map<pair<UInt_t, ULong64_t>, Double_t> weights{};
+
+  UInt_t    run;
+  ULong64_t evt;
+  Double_t  w_ff;
+  weight_tree->SetBranchAddress("runNumber", &run);
+  weight_tree->SetBranchAddress("eventNumber", &evt);
+  weight_tree->SetBranchAddress("w_ff", &w_ff);
+  for (Long64_t i = 0; i < weight_tree->GetEntries(); i++) {
+    weight_tree->GetEntry(i);
+    weights.emplace(make_pair(run, evt), w_ff);
+  }
+
+  truth_cache::Reader cache(path);
+  TruthEvent          truth;
+  for (uint64_t i = 0; i < cache.num_events(); i++) {
+    cache.load(i, truth);
+
+    auto pe = truth.pe[B0] - truth.pe[Dst];
+    auto px = truth.px[B0] - truth.px[Dst];
+    auto py = truth.py[B0] - truth.py[Dst];
+    auto pz = truth.pz[B0] - truth.pz[Dst];
+    auto q2 = (pe * pe - (px * px + py * py + pz * pz)) / 1E6;
+
+    histo_orig.Fill(q2);
+    auto w = weights.find(make_pair(truth.runNumber, truth.eventNumber));
+    if (w != weights.end()) histo_reweighted.Fill(q2, w->second);
+  }
+}
+
 template <class T>
 void debug_histo(T histo, Option_t* scale_opt = "") {
   cout << "Histogram " << histo->GetName() << "has an integral of "
@@ -98,19 +137,27 @@ Double_t rescale_histos(T histo1, T histo2) {
   return ratio;
 }
 
+// The first argument is either a step 1 ntuple or a truth cache of it (see
+// build_truth_cache.u)
 int main(int, char** argv) {
-  TFile* data_file   = new TFile(argv[1], "read");
+  string data_path   = argv[1];
   TFile* weight_file = new TFile(argv[2], "read");
   string output_dir  = argv[3];
+  auto   from_cache  = truth_cache::is_truth_cache(data_path);
 
   gROOT->SetBatch(kTRUE);
   gStyle->SetOptStat(0);
 
-  TTree* data_tree   = data_file->Get<TTree>("dst_iso");
+  TFile* data_file   = nullptr;
+  TTree* data_tree   = nullptr;
   TTree* weight_tree = weight_file->Get<TTree>("mc_dst_tau_ff_w");
 
-  weight_tree->BuildIndex("runNumber", "eventNumber");
-  data_tree->AddFriend(weight_tree);
+  if (!from_cache) {
+    data_file = new TFile(data_path.c_str(), "read");
+    data_tree = data_file->Get<TTree>("dst_iso");
+    weight_tree->BuildIndex("runNumber", "eventNumber");
+    data_tree->AddFriend(weight_tree);
+  }
 
   // Reference CLN
   auto histo_ref_cln_B0ToDstTauNu =
@@ -128,19 +175,25 @@ int main(int, char** argv) {
   histo_ref_isgw2_B0ToDstTauNu.SetLineWidth(2);
   histo_ref_isgw2_B0ToDstTauNu.SetLineColor(kBlue);
 
-  // Original ISGW2
-  auto histo_orig =
-      fill_histo(data_tree, "q2_true", "q2_orig", "q2 original", 50, 2.5, 12);
+  // Original ISGW2 and reweighted CLN
+  auto histo_orig       = TH1D("q2_orig", "q2 original", 50, 2.5, 12);
+  auto histo_reweighted = TH1D("q2_reweighted", "q2 reweighted", 50, 2.5, 12);
+  if (from_cache)
+    fill_histos_from_cache(data_path, weight_tree, histo_orig,
+                           histo_reweighted);
+  else {
+    histo_orig =
+        fill_histo(data_tree, "q2_true", "q2_orig", "q2 original", 50, 2.5, 12);
+    histo_reweighted = fill_histo(data_tree, "q2_true", "w_ff", "q2_reweighted",
+                                  "q2 reweighted", 50, 2.5, 12);
+  }
+
   histo_orig.Scale(1 / histo_orig.Integral("width"));
   debug_histo(&histo_orig, "width");
 
   histo_orig.SetLineWidth(4);
   histo_orig.SetLineColor(kGreen);
 
-  // Reweighted CLN
-  auto histo_reweighted =
-      fill_histo(data_tree, "q2_true", "w_ff", "q2_reweighted", "q2 reweighted",
-                 50, 2.5, 12);
   histo_reweighted.Scale(1 / histo_reweighted.Integral("width"));
   debug_histo(&histo_reweighted, "width");
 
@@ -165,9 +218,9 @@ int main(int, char** argv) {
 
   delete canvas;
 
-  delete data_tree;
+  if (data_tree) delete data_tree;
   delete weight_tree;
 
-  delete data_file;
+  if (data_file) delete data_file;
   delete weight_file;
 }
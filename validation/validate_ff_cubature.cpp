@@ -0,0 +1,124 @@
+// Author: Yipeng Sun
+// License: GPLv2
+// Description: Total B -> D* tau nu rate and its marginals from the 4D
+//              cubature of ff_cubature, compared with BToDstaunu::IntRate.
+// Last Change: Sun Oct 18, 2026 at 08:31 AM +0200
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <cxxopts.hpp>
+#include <ff_cubature.hpp>
+
+using namespace std;
+using namespace ff_cubature;
+
+const char* var_names[NumOfVars] = {"q2", "cos(theta_l)", "cos(theta_v)",
+                                    "chi"};
+
+vector<Marginal> make_marginals(const Domain& dom, int nbins) {
+  vector<Marginal> result{};
+  for (auto v = 0; v < NumOfVars; v++)
+    result.push_back({{{v, nbins, dom.lo[v], dom.hi[v]}}, {}, {}});
+  // The angular correlation used to fit the FF parameters
+  result.push_back({{{Ctl, nbins, -1, 1}, {Ctv, nbins, -1, 1}}, {}, {}});
+  return result;
+}
+
+void print_result(const string& title, const Result& r, double ref,
+                  double elapsed) {
+  cout << title << ": " << r.integral << " +- " << r.error
+       << ", ratio to IntRate " << r.integral / ref << ", " << r.nEval
+       << " evaluations in " << elapsed << " s";
+  if (r.chi2_dof > 0) cout << ", chi2/dof " << r.chi2_dof;
+  cout << endl;
+
+  for (auto v = 0; v < NumOfVars; v++) {
+    auto& m = r.marginals[v];
+    cout << "  " << var_names[v] << ":";
+    for (auto b = 0ul; b < m.value.size(); b++)
+      cout << " " << m.value[b] / r.integral << "(" << m.error[b] / r.integral
+           << ")";
+    cout << endl;
+  }
+}
+
+//////////
+// Main //
+//////////
+
+int main(int argc, char** argv) {
+  cxxopts::Options argopts(
+      "validate_ff_cubature",
+      "Integrate the B -> D* tau nu angular rate and its marginals.");
+
+  // clang-format off
+  argopts.add_options()
+    ("h,help", "print help")
+    ("j,jobs", "specify the number of threads (0: all cores)",
+     cxxopts::value<unsigned>()->default_value("0"))
+    ("b,bins", "specify the number of bins of each marginal",
+     cxxopts::value<int>()->default_value("5"))
+    ("points", "specify the Gauss-Kronrod rule (7 or 15)",
+     cxxopts::value<int>()->default_value("7"))
+    ("q2-panels", "specify the number of Gauss-Kronrod panels in q2",
+     cxxopts::value<int>()->default_value("16"))
+    ("calls", "specify the VEGAS calls per iteration",
+     cxxopts::value<size_t>()->default_value("200000"))
+    ("ff", "specify the FF (0: ISGW2, 1: CLN, 2: BGL)",
+     cxxopts::value<int>()->default_value("1"))
+    ("charged", "B- -> D*0 instead of B0 -> D*+")
+  ;
+  // clang-format on
+
+  auto parsed_args = argopts.parse(argc, argv);
+  if (parsed_args.count("help")) {
+    cout << argopts.help() << endl;
+    return 0;
+  }
+
+  auto nthreads = parsed_args["jobs"].as<unsigned>();
+  auto nbins    = parsed_args["bins"].as<int>();
+  auto is_cln   = parsed_args["ff"].as<int>();
+  auto ml       = BToDstaunu::mTau;
+
+  BToDstaunu ff{};
+  ff.SetMasses(parsed_args.count("charged") ? 1 : 0);
+
+  // IntRate averages over chi, while the cubature integrates over it
+  auto start = chrono::steady_clock::now();
+  auto ref   =
+      2 * BToDstaunu::PI * ff.IntRate(ml * ml, ff._Dsmaxq2, is_cln, -99, ml);
+  chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+  cout << "IntRate: " << ref << " in " << elapsed.count() << " s" << endl;
+
+  auto dom       = AngularDomain(ff, ml);
+  auto marginals = make_marginals(dom, nbins);
+  auto integrand = AngularRate(ff, is_cln, 0, false, ml);
+  if (nthreads == 0) nthreads = thread::hardware_concurrency();
+
+  // NOTE: The rate is steep near both ends of q2, so the total only agrees
+  //       with IntRate to 1e-5 with 16 panels there; the angles only need
+  //       panels at the bin edges
+  int  panels[NumOfVars] = {parsed_args["q2-panels"].as<int>(), 1, 1, 1};
+  auto points            = parsed_args["points"].as<int>();
+
+  start   = chrono::steady_clock::now();
+  auto gk = GaussKronrod(integrand, dom, marginals, panels, points, nthreads);
+  elapsed = chrono::steady_clock::now() - start;
+  print_result("Gauss-Kronrod, " + to_string(nthreads) + " threads", gk, ref,
+               elapsed.count());
+
+  VegasOptions opts{};
+  opts.nCalls = parsed_args["calls"].as<size_t>();
+  start       = chrono::steady_clock::now();
+  auto vegas  = Vegas(integrand, dom, marginals, opts, nthreads);
+  elapsed     = chrono::steady_clock::now() - start;
+  print_result("VEGAS, " + to_string(nthreads) + " threads", vegas, ref,
+               elapsed.count());
+
+  return 0;
+}
@@ -0,0 +1,235 @@
+// Author: Yipeng Sun
+// License: GPLv2
+// Description: Throughput of the analytic B -> D tau nu ISGW2 -> CLN weights
+//              of BToDtaunu, and their agreement with HAMMER.
+// Last Change: Sun Oct 18, 2026 at 01:24 AM +0200
+//
+// HAMMER weights are ratios of squared matrix elements, without the ratio of
+// the total rates; so they are compared with the analytic weights up to a
+// constant factor, which is reported as well.
+
+#include <Hammer/Hammer.hh>
+
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <cxxopts.hpp>
+#include <ff_dtaunu.hpp>
+
+#include "rdx_hammer.h"
+
+using namespace std;
+
+struct Points {
+  vector<double> q2, ctl, phi;
+};
+
+// Uniform in q2, cos(theta_l) and the azimuth of the tau
+Points gen_points(const BToDtaunu& ff, double ml, size_t n, mt19937_64& rng) {
+  // Keep away from the phase space boundaries, where both rates vanish
+  auto q2_min = ml * ml + 1e-4, q2_max = ff._Dmaxq2 - 1e-4;
+
+  uniform_real_distribution<double> uni(0, 1);
+  Points                            result{};
+  for (auto i = 0ul; i < n; i++) {
+    result.q2.push_back(q2_min + (q2_max - q2_min) * uni(rng));
+    result.ctl.push_back(2 * uni(rng) - 1);
+    result.phi.push_back(2 * M_PI * uni(rng));
+  }
+
+  return result;
+}
+
+////////////////////
+// HAMMER weights //
+////////////////////
+
+// B at rest, D along +z; theta_l is the angle between the tau in the W rest
+// frame and the W direction in the B rest frame, as in BToDtaunu
+Hammer::Process make_process_d(const BToDtaunu& ff, double ml, double q2,
+                               double ctl, double phi) {
+  double mB     = ff._mB, mD = ff._mD;
+  double lambda = pow(mB * mB - mD * mD - q2, 2) - 4 * mD * mD * q2;
+  double pD     = sqrt(max(lambda, 0.)) / (2 * mB);
+  double eD     = sqrt(mD * mD + pD * pD);
+  double eW     = mB - eD;
+
+  // Tau in the W rest frame, then boosted along -z
+  double sqrt_q2 = sqrt(q2), stl = sqrt(1 - ctl * ctl);
+  double p_star  = (q2 - ml * ml) / (2 * sqrt_q2);
+  double e_star  = (q2 + ml * ml) / (2 * sqrt_q2);
+  double pz_star = -p_star * ctl;
+  double gamma = eW / sqrt_q2, beta = -pD / eW;
+
+  double e_tau  = gamma * (e_star + beta * pz_star);
+  double px_tau = p_star * stl * cos(phi);
+  double py_tau = p_star * stl * sin(phi);
+  double pz_tau = gamma * (pz_star + beta * e_star);
+
+  auto b_id = ff._isBm ? -521 : -511;
+  auto d_id = ff._isBm ? 421 : 411;
+
+  Hammer::Process proc;
+  auto b   = proc.addParticle(particle(mB, 0, 0, 0, b_id));
+  auto d   = proc.addParticle(particle(eD, 0, 0, pD, d_id));
+  auto tau = proc.addParticle(particle(e_tau, px_tau, py_tau, pz_tau, 15));
+  auto nu  = proc.addParticle(
+      particle(eW - e_tau, -px_tau, -py_tau, -pD - pz_tau, -16));
+  proc.addVertex(b, {d, tau, nu});
+
+  return proc;
+}
+
+void setup_hammer_d(Hammer::Hammer& ham, double rho2, double V1) {
+  ham.includeDecay(vector<string>{"BDTauNu"});
+  ham.addFFScheme("DFeedDown", {{"BD", "CLN"}});
+  ham.setFFInputScheme({{"BD", "ISGW2"}});
+
+  ostringstream opts;
+  opts << "BtoDCLN: {RhoSq: " << rho2 << ", G1: " << V1 << "}";
+  ham.setOptions(opts.str());
+
+  ham.initRun();
+}
+
+//////////
+// Main //
+//////////
+
+int main(int argc, char** argv) {
+  cxxopts::Options argopts(
+      "validate_ff_dtaunu",
+      "Time BToDtaunu ISGW2 -> CLN weights and compare them with HAMMER.");
+
+  // clang-format off
+  argopts.add_options()
+    ("h,help", "print help")
+    ("n,points", "specify the number of points for the analytic weights",
+     cxxopts::value<size_t>()->default_value("1000000"))
+    ("hammer-points", "specify the number of points to compare with HAMMER",
+     cxxopts::value<size_t>()->default_value("20000"))
+    ("charged", "B- -> D0 instead of B0 -> D+")
+    ("rho2", "specify the CLN slope",
+     cxxopts::value<double>()->default_value("1.186"))
+    ("V1", "specify the CLN normalization V1(1)",
+     cxxopts::value<double>()->default_value("1.0541"))
+    ("seed", "specify the random seed",
+     cxxopts::value<uint64_t>()->default_value("42"))
+  ;
+  // clang-format on
+
+  auto parsed_args = argopts.parse(argc, argv);
+  if (parsed_args.count("help")) {
+    cout << argopts.help() << endl;
+    return 0;
+  }
+
+  auto num_of_pts = parsed_args["points"].as<size_t>();
+  auto num_of_ham = parsed_args["hammer-points"].as<size_t>();
+  auto rho2       = parsed_args["rho2"].as<double>();
+  auto V1         = parsed_args["V1"].as<double>();
+  auto ml         = BToDtaunu::mTau;
+
+  BToDtaunu ff(rho2, V1);
+  ff.SetMasses(parsed_args.count("charged") ? 1 : 0);
+
+  mt19937_64 rng(parsed_args["seed"].as<uint64_t>());
+
+  // Normalization, so that it isn't part of the timing below
+  auto start = chrono::steady_clock::now();
+  auto norm  = ff.Normalization(ml);
+  chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+  cout << "Normalization (CLN / ISGW2 rate): " << norm << ", computed in "
+       << elapsed.count() << " s" << endl;
+
+  // Analytic weights, all at once and one by one
+  auto           pts = gen_points(ff, ml, num_of_pts, rng);
+  vector<double> w(num_of_pts);
+
+  start = chrono::steady_clock::now();
+  ff.FromISGW2ToThisModel(pts.q2.data(), pts.ctl.data(), w.data(), num_of_pts,
+                          ml);
+  elapsed         = chrono::steady_clock::now() - start;
+  auto array_rate = num_of_pts / elapsed.count();
+
+  double max_diff = 0;
+  start           = chrono::steady_clock::now();
+  for (auto i = 0ul; i < num_of_pts; i++) {
+    auto w_scalar = ff.FromISGW2ToThisModel(pts.q2[i], pts.ctl[i], ml);
+    max_diff      = max(max_diff, fabs(w_scalar - w[i]));
+  }
+  elapsed          = chrono::steady_clock::now() - start;
+  auto scalar_rate = num_of_pts / elapsed.count();
+
+  cout << "Analytic weights for " << num_of_pts << " points: "
+       << array_rate / 1e6 << " M/s (arrays), " << scalar_rate / 1e6
+       << " M/s (one by one); max |difference| " << max_diff << endl;
+
+  // HAMMER
+  Hammer::Hammer ham{};
+  setup_hammer_d(ham, rho2, V1);
+
+  auto           ham_pts = gen_points(ff, ml, num_of_ham, rng);
+  vector<double> w_ham(num_of_ham, -1.);
+
+  start = chrono::steady_clock::now();
+  for (auto i = 0ul; i < num_of_ham; i++) {
+    auto proc =
+        make_process_d(ff, ml, ham_pts.q2[i], ham_pts.ctl[i], ham_pts.phi[i]);
+    ham.initEvent();
+    if (ham.addProcess(proc) != 0) {
+      ham.processEvent();
+      w_ham[i] = ham.getWeight("DFeedDown");
+    }
+  }
+  elapsed       = chrono::steady_clock::now() - start;
+  auto ham_rate = num_of_ham / elapsed.count();
+
+  vector<double> w_ana(num_of_ham);
+  ff.FromISGW2ToThisModel(ham_pts.q2.data(), ham_pts.ctl.data(), w_ana.data(),
+                          num_of_ham, ml);
+
+  // Ratio HAMMER / analytic, which should be a constant
+  size_t num_cmp = 0;
+  double sum_k   = 0, sum_k2 = 0;
+  for (auto i = 0ul; i < num_of_ham; i++) {
+    if (w_ham[i] < 0 || w_ana[i] <= 0) continue;
+    auto k = w_ham[i] / w_ana[i];
+    sum_k += k;
+    sum_k2 += k * k;
+    num_cmp++;
+  }
+
+  cout << "HAMMER weights for " << num_of_ham << " points: " << ham_rate / 1e3
+       << " k/s, i.e. " << array_rate / ham_rate
+       << " times slower than the analytic ones" << endl;
+  if (num_cmp == 0) {
+    cerr << "No point was accepted by HAMMER." << endl;
+    return 1;
+  }
+
+  auto   mean_k  = sum_k / num_cmp;
+  auto   rms_k   = sqrt(max(sum_k2 / num_cmp - mean_k * mean_k, 0.));
+  double max_dev = 0, worst_q2 = 0, worst_ctl = 0;
+  for (auto i = 0ul; i < num_of_ham; i++) {
+    if (w_ham[i] < 0 || w_ana[i] <= 0) continue;
+    auto dev = fabs(w_ham[i] / w_ana[i] / mean_k - 1);
+    if (dev > max_dev) {
+      max_dev   = dev;
+      worst_q2  = ham_pts.q2[i];
+      worst_ctl = ham_pts.ctl[i];
+    }
+  }
+
+  cout << "Compared " << num_cmp << " points: HAMMER / analytic = " << mean_k
+       << " (the ratio of total rates not in HAMMER), relative RMS "
+       << rms_k / mean_k << ", max relative deviation " << max_dev
+       << " at q2 = " << worst_q2 << ", cos(theta_l) = " << worst_ctl << endl;
+
+  return 0;
+}